@@ -0,0 +1,416 @@
+#ifndef XMATRIX_BLAS_CPU_H_
+#define XMATRIX_BLAS_CPU_H_
+
+#include "common.h"
+
+#if defined(__AVX512F__) || (defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER)))
+#include <immintrin.h>
+#endif
+
+#include "thread-pool.h"
+
+/**
+* Fully unrolled loops keep the register tiles of the micro-kernels in
+* registers instead of spilling them to the stack
+*/
+#if defined(__clang__)
+#define XMATRIX_UNROLL _Pragma("unroll")
+#elif defined(__GNUC__)
+#define XMATRIX_UNROLL _Pragma("GCC unroll 16")
+#else
+#define XMATRIX_UNROLL
+#endif
+
+namespace xmatrix {
+
+/**
+* Gemm Kernel: register tile of MR x NR elements of C computed from packed
+* micro-panels of A (MR values per k) and B (NR values per k), and the
+* cache blocking of the panels: MC x KC of A stays in L2, KC x NR of B in L1
+* and KC x NC of B in L3
+*/
+template<typename DType>
+struct GemmKernel {
+	static const size_t MR = 4;
+	static const size_t NR = 4;
+	static const size_t MC = 64;
+	static const size_t KC = 256;
+	static const size_t NC = 1024;
+
+	XMATRIX_INLINE static void Run(size_t kc, const DType *a, const DType *b, DType *c, size_t rsc, bool accumulate) {
+		DType ab[MR][NR];
+		for (size_t i = 0; i < MR; i++)
+			for (size_t j = 0; j < NR; j++)
+				ab[i][j] = DType();
+
+		for (size_t p = 0; p < kc; p++, a += MR, b += NR)
+			for (size_t i = 0; i < MR; i++)
+				for (size_t j = 0; j < NR; j++)
+					ab[i][j] += a[i] * b[j];
+
+		for (size_t i = 0; i < MR; i++)
+			for (size_t j = 0; j < NR; j++)
+				c[i * rsc + j] = accumulate? c[i * rsc + j] + ab[i][j] : ab[i][j];
+	}
+};
+
+#if defined(__AVX512F__)
+template<>
+struct GemmKernel<double> {
+	static const size_t MR = 12;
+	static const size_t NR = 16;
+	static const size_t MC = 96;
+	static const size_t KC = 256;
+	static const size_t NC = 2048;
+
+	XMATRIX_INLINE static void Run(size_t kc, const double *a, const double *b, double *c, size_t rsc, bool accumulate) {
+		__m512d ab[MR][2];
+		XMATRIX_UNROLL
+		for (size_t i = 0; i < MR; i++)
+			ab[i][0] = ab[i][1] = _mm512_setzero_pd();
+
+		for (size_t p = 0; p < kc; p++, a += MR, b += NR) {
+			__m512d b0 = _mm512_loadu_pd(b);
+			__m512d b1 = _mm512_loadu_pd(b + 8);
+			XMATRIX_UNROLL
+			for (size_t i = 0; i < MR; i++) {
+				__m512d ai = _mm512_set1_pd(a[i]);
+				ab[i][0] = _mm512_fmadd_pd(ai, b0, ab[i][0]);
+				ab[i][1] = _mm512_fmadd_pd(ai, b1, ab[i][1]);
+			}
+		}
+
+		XMATRIX_UNROLL
+		for (size_t i = 0; i < MR; i++) {
+			if (accumulate) {
+				ab[i][0] = _mm512_add_pd(ab[i][0], _mm512_loadu_pd(c + i * rsc));
+				ab[i][1] = _mm512_add_pd(ab[i][1], _mm512_loadu_pd(c + i * rsc + 8));
+			}
+			_mm512_storeu_pd(c + i * rsc, ab[i][0]);
+			_mm512_storeu_pd(c + i * rsc + 8, ab[i][1]);
+		}
+	}
+};
+
+template<>
+struct GemmKernel<float> {
+	static const size_t MR = 12;
+	static const size_t NR = 32;
+	static const size_t MC = 96;
+	static const size_t KC = 384;
+	static const size_t NC = 2048;
+
+	XMATRIX_INLINE static void Run(size_t kc, const float *a, const float *b, float *c, size_t rsc, bool accumulate) {
+		__m512 ab[MR][2];
+		XMATRIX_UNROLL
+		for (size_t i = 0; i < MR; i++)
+			ab[i][0] = ab[i][1] = _mm512_setzero_ps();
+
+		for (size_t p = 0; p < kc; p++, a += MR, b += NR) {
+			__m512 b0 = _mm512_loadu_ps(b);
+			__m512 b1 = _mm512_loadu_ps(b + 16);
+			XMATRIX_UNROLL
+			for (size_t i = 0; i < MR; i++) {
+				__m512 ai = _mm512_set1_ps(a[i]);
+				ab[i][0] = _mm512_fmadd_ps(ai, b0, ab[i][0]);
+				ab[i][1] = _mm512_fmadd_ps(ai, b1, ab[i][1]);
+			}
+		}
+
+		XMATRIX_UNROLL
+		for (size_t i = 0; i < MR; i++) {
+			if (accumulate) {
+				ab[i][0] = _mm512_add_ps(ab[i][0], _mm512_loadu_ps(c + i * rsc));
+				ab[i][1] = _mm512_add_ps(ab[i][1], _mm512_loadu_ps(c + i * rsc + 16));
+			}
+			_mm512_storeu_ps(c + i * rsc, ab[i][0]);
+			_mm512_storeu_ps(c + i * rsc + 16, ab[i][1]);
+		}
+	}
+};
+#elif defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+template<>
+struct GemmKernel<double> {
+	static const size_t MR = 6;
+	static const size_t NR = 8;
+	static const size_t MC = 96;
+	static const size_t KC = 256;
+	static const size_t NC = 2048;
+
+	XMATRIX_INLINE static void Run(size_t kc, const double *a, const double *b, double *c, size_t rsc, bool accumulate) {
+		__m256d ab[MR][2];
+		XMATRIX_UNROLL
+		for (size_t i = 0; i < MR; i++)
+			ab[i][0] = ab[i][1] = _mm256_setzero_pd();
+
+		for (size_t p = 0; p < kc; p++, a += MR, b += NR) {
+			__m256d b0 = _mm256_loadu_pd(b);
+			__m256d b1 = _mm256_loadu_pd(b + 4);
+			XMATRIX_UNROLL
+			for (size_t i = 0; i < MR; i++) {
+				__m256d ai = _mm256_broadcast_sd(a + i);
+				ab[i][0] = _mm256_fmadd_pd(ai, b0, ab[i][0]);
+				ab[i][1] = _mm256_fmadd_pd(ai, b1, ab[i][1]);
+			}
+		}
+
+		XMATRIX_UNROLL
+		for (size_t i = 0; i < MR; i++) {
+			if (accumulate) {
+				ab[i][0] = _mm256_add_pd(ab[i][0], _mm256_loadu_pd(c + i * rsc));
+				ab[i][1] = _mm256_add_pd(ab[i][1], _mm256_loadu_pd(c + i * rsc + 4));
+			}
+			_mm256_storeu_pd(c + i * rsc, ab[i][0]);
+			_mm256_storeu_pd(c + i * rsc + 4, ab[i][1]);
+		}
+	}
+};
+
+template<>
+struct GemmKernel<float> {
+	static const size_t MR = 6;
+	static const size_t NR = 16;
+	static const size_t MC = 96;
+	static const size_t KC = 384;
+	static const size_t NC = 2048;
+
+	XMATRIX_INLINE static void Run(size_t kc, const float *a, const float *b, float *c, size_t rsc, bool accumulate) {
+		__m256 ab[MR][2];
+		XMATRIX_UNROLL
+		for (size_t i = 0; i < MR; i++)
+			ab[i][0] = ab[i][1] = _mm256_setzero_ps();
+
+		for (size_t p = 0; p < kc; p++, a += MR, b += NR) {
+			__m256 b0 = _mm256_loadu_ps(b);
+			__m256 b1 = _mm256_loadu_ps(b + 8);
+			XMATRIX_UNROLL
+			for (size_t i = 0; i < MR; i++) {
+				__m256 ai = _mm256_broadcast_ss(a + i);
+				ab[i][0] = _mm256_fmadd_ps(ai, b0, ab[i][0]);
+				ab[i][1] = _mm256_fmadd_ps(ai, b1, ab[i][1]);
+			}
+		}
+
+		XMATRIX_UNROLL
+		for (size_t i = 0; i < MR; i++) {
+			if (accumulate) {
+				ab[i][0] = _mm256_add_ps(ab[i][0], _mm256_loadu_ps(c + i * rsc));
+				ab[i][1] = _mm256_add_ps(ab[i][1], _mm256_loadu_ps(c + i * rsc + 8));
+			}
+			_mm256_storeu_ps(c + i * rsc, ab[i][0]);
+			_mm256_storeu_ps(c + i * rsc + 8, ab[i][1]);
+		}
+	}
+};
+#endif
+
+/**
+* Packing: copy an mc x kc block of A into MR-row micro-panels and a
+* kc x nc block of B into NR-column micro-panels, converting to the
+* result type and zero padding the fringes. rs and cs are row and column
+* strides, so transposed and strided operands pack the same way
+*/
+template<typename DType_dest, typename DType_src, size_t MR>
+XMATRIX_INLINE void GemmPackA(size_t mc, size_t kc, const DType_src *a, size_t rsa, size_t csa, DType_dest *pack) {
+	for (size_t i = 0; i < mc; i += MR)
+		for (size_t p = 0; p < kc; p++)
+			for (size_t r = 0; r < MR; r++)
+				*pack++ = (i + r < mc)? (DType_dest)a[(i + r) * rsa + p * csa] : DType_dest();
+}
+
+template<typename DType_dest, typename DType_src, size_t NR>
+XMATRIX_INLINE void GemmPackB(size_t kc, size_t nc, const DType_src *b, size_t rsb, size_t csb, DType_dest *pack) {
+	for (size_t j = 0; j < nc; j += NR)
+		for (size_t p = 0; p < kc; p++)
+			for (size_t r = 0; r < NR; r++)
+				*pack++ = (j + r < nc)? (DType_dest)b[p * rsb + (j + r) * csb] : DType_dest();
+}
+
+/**
+* Buffer grown on demand and kept per thread, so repeated products do not
+* go through the allocator
+*/
+template<typename DType, int tag>
+XMATRIX_INLINE DType *GemmBuffer(size_t size) {
+	static thread_local std::vector<DType> buffer;
+	if (buffer.size() < size)
+		buffer.resize(size);
+	return &buffer[0];
+}
+
+/**
+* Gemm: C[m x n] = A[m x k] * B[k x n], C row-major with row stride rsc.
+* Small products use a direct loop, larger ones the blocked and packed
+* engine, threaded over the MC x NC blocks of C
+*/
+template<typename DType_dest, typename DType_lhs, typename DType_rhs>
+XMATRIX_INLINE void Gemm(size_t m, size_t n, size_t k,
+	const DType_lhs *a, size_t rsa, size_t csa,
+	const DType_rhs *b, size_t rsb, size_t csb,
+	DType_dest *c, size_t rsc) {
+
+	typedef GemmKernel<DType_dest> Kernel;
+	const size_t MR = Kernel::MR, NR = Kernel::NR;
+
+	if (m * n * k <= 32 * 32 * 32 || k == 0) {
+		for (size_t i = 0; i < m; i++) {
+			DType_dest *ci = c + i * rsc;
+			for (size_t j = 0; j < n; j++)
+				ci[j] = DType_dest();
+			for (size_t p = 0; p < k; p++) {
+				DType_dest aip = (DType_dest)a[i * rsa + p * csa];
+				const DType_rhs *bp = b + p * rsb;
+				for (size_t j = 0; j < n; j++)
+					ci[j] += aip * bp[j * csb];
+			}
+		}
+		return;
+	}
+
+	// packed B is owned by the call: a thread waiting in ParallelFor may run
+	// another product meanwhile, which would reuse a per thread buffer
+	std::vector<DType_dest> bufferB(Kernel::KC * (Kernel::NC + NR));
+	for (size_t jc = 0; jc < n; jc += Kernel::NC) {
+		size_t nc = (n - jc < Kernel::NC)? n - jc : Kernel::NC;
+		for (size_t pc = 0; pc < k; pc += Kernel::KC) {
+			size_t kc = (k - pc < Kernel::KC)? k - pc : Kernel::KC;
+			bool accumulate = (pc > 0);
+
+			DType_dest *packB = &bufferB[0];
+			GemmPackB<DType_dest, DType_rhs, NR>(kc, nc, b + pc * rsb + jc * csb, rsb, csb, packB);
+
+			size_t blocks = (m + Kernel::MC - 1) / Kernel::MC;
+			ParallelFor(0, blocks, (m * nc * kc > 64 * 64 * 64)? 1 : blocks, [&](size_t first, size_t last) {
+				for (size_t block = first; block < last; block++) {
+					size_t ic = block * Kernel::MC;
+					size_t mc = (m - ic < Kernel::MC)? m - ic : Kernel::MC;
+					DType_dest *packA = GemmBuffer<DType_dest, 1>(Kernel::KC * (Kernel::MC + MR));
+					GemmPackA<DType_dest, DType_lhs, MR>(mc, kc, a + ic * rsa + pc * csa, rsa, csa, packA);
+
+					for (size_t jr = 0; jr < nc; jr += NR) {
+						for (size_t ir = 0; ir < mc; ir += MR) {
+							DType_dest *cij = c + (ic + ir) * rsc + jc + jr;
+							const DType_dest *pa = packA + ir * kc;
+							const DType_dest *pb = packB + jr * kc;
+
+							if (ir + MR <= mc && jr + NR <= nc) {
+								Kernel::Run(kc, pa, pb, cij, rsc, accumulate);
+							} else {
+								// fringe tile: compute a full tile aside and copy the valid part
+								DType_dest tile[MR * NR];
+								Kernel::Run(kc, pa, pb, tile, NR, false);
+								for (size_t i = 0; i < MR && ir + i < mc; i++)
+									for (size_t j = 0; j < NR && jr + j < nc; j++)
+										cij[i * rsc + j] = accumulate? cij[i * rsc + j] + tile[i * NR + j] : tile[i * NR + j];
+							}
+						}
+					}
+				}
+			});
+		}
+	}
+}
+
+/**
+* Dot: sum of x[i] * y[i] over n strided elements, with eight independent
+* partial sums so the additions pipeline (and vectorize for unit strides)
+*/
+template<typename DType_dest, typename DType_lhs, typename DType_rhs>
+XMATRIX_INLINE DType_dest Dot(size_t n, const DType_lhs *x, size_t incx, const DType_rhs *y, size_t incy) {
+	DType_dest acc[8] = {};
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		XMATRIX_UNROLL
+		for (size_t u = 0; u < 8; u++)
+			acc[u] += (DType_dest)x[(i + u) * incx] * (DType_dest)y[(i + u) * incy];
+	}
+	for (; i < n; i++)
+		acc[0] += (DType_dest)x[i * incx] * (DType_dest)y[i * incy];
+	return ((acc[0] + acc[4]) + (acc[1] + acc[5])) + ((acc[2] + acc[6]) + (acc[3] + acc[7]));
+}
+
+/**
+* Gemv: y[n] = x[k] * B[k x n], B addressed with row stride rsb and column
+* stride csb. A row-major B is streamed row by row, four rows per pass, into
+* a column block of y small enough to stay in L1; column blocks are spread
+* over threads for large matrices. Other layouts fall back to one dot
+* product per output element
+*/
+template<typename DType_dest, typename DType_lhs, typename DType_rhs>
+XMATRIX_INLINE void Gemv(size_t k, size_t n,
+	const DType_lhs *x, size_t incx,
+	const DType_rhs *b, size_t rsb, size_t csb,
+	DType_dest *y) {
+
+	if (csb != 1) {
+		for (size_t j = 0; j < n; j++)
+			y[j] = Dot<DType_dest>(k, x, incx, b + j * csb, rsb);
+		return;
+	}
+
+	const size_t NB = 4096 / sizeof(DType_dest);
+	size_t blocks = (n + NB - 1) / NB;
+	ParallelFor(0, blocks, (k * n > 256 * 1024)? 1 : blocks, [&](size_t first, size_t last) {
+		for (size_t block = first; block < last; block++) {
+			size_t j0 = block * NB;
+			size_t nb = (n - j0 < NB)? n - j0 : NB;
+			DType_dest *yj = y + j0;
+			for (size_t j = 0; j < nb; j++)
+				yj[j] = DType_dest();
+
+			size_t p = 0;
+			for (; p + 4 <= k; p += 4) {
+				const DType_rhs *b0 = b + p * rsb + j0, *b1 = b0 + rsb, *b2 = b1 + rsb, *b3 = b2 + rsb;
+				DType_dest x0 = (DType_dest)x[p * incx], x1 = (DType_dest)x[(p + 1) * incx],
+					x2 = (DType_dest)x[(p + 2) * incx], x3 = (DType_dest)x[(p + 3) * incx];
+				for (size_t j = 0; j < nb; j++)
+					yj[j] += x0 * b0[j] + x1 * b1[j] + x2 * b2[j] + x3 * b3[j];
+			}
+			for (; p < k; p++) {
+				const DType_rhs *b0 = b + p * rsb + j0;
+				DType_dest x0 = (DType_dest)x[p * incx];
+				for (size_t j = 0; j < nb; j++)
+					yj[j] += x0 * b0[j];
+			}
+		}
+	});
+}
+
+/**
+* Sum: sum of n strided elements with eight independent partial sums
+*/
+template<typename DType>
+XMATRIX_INLINE DType Sum(size_t n, const DType *x, size_t incx) {
+	DType acc[8] = {};
+	size_t i = 0;
+	for (; i + 8 <= n; i += 8) {
+		XMATRIX_UNROLL
+		for (size_t u = 0; u < 8; u++)
+			acc[u] += x[(i + u) * incx];
+	}
+	for (; i < n; i++)
+		acc[0] += x[i * incx];
+	return ((acc[0] + acc[4]) + (acc[1] + acc[5])) + ((acc[2] + acc[6]) + (acc[3] + acc[7]));
+}
+
+/**
+* Transpose: B[n x m] = A[m x n]^T, moved in square tiles so that both the
+* rows read from A and the rows written to B stay in L1
+*/
+template<typename DType>
+XMATRIX_INLINE void Transpose(size_t m, size_t n, const DType *a, size_t rsa, DType *b, size_t rsb) {
+	const size_t TB = 32;
+	for (size_t i0 = 0; i0 < m; i0 += TB) {
+		size_t i1 = (m - i0 < TB)? m : i0 + TB;
+		for (size_t j0 = 0; j0 < n; j0 += TB) {
+			size_t j1 = (n - j0 < TB)? n : j0 + TB;
+			for (size_t i = i0; i < i1; i++)
+				for (size_t j = j0; j < j1; j++)
+					b[j * rsb + i] = a[i * rsa + j];
+		}
+	}
+}
+
+} // namespace xmatrix
+
+#endif // XMATRIX_BLAS_CPU_H_
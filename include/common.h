@@ -10,6 +10,11 @@
 #define XMATRIX_INLINE inline __attribute__((always_inline))
 #endif
 
+/**
+* Library version, part of the key of the cached JIT kernels
+*/
+#define XMATRIX_VERSION "0.1"
+
 /**
 * Datatype and constant definition
 */
@@ -19,11 +24,26 @@
 
 #define XMATRIX_DEFAULT_SEED = gsl_rng_default_seed
 
+/**
+* Number of elements streamed per block by fused elementwise kernels
+*/
+#ifndef XMATRIX_FUSION_BLOCK
+#define XMATRIX_FUSION_BLOCK 256
+#endif
+
+/**
+* Threads of the shared thread pool, 0 for one per hardware thread
+*/
+#ifndef XMATRIX_NUM_THREADS
+#define XMATRIX_NUM_THREADS 0
+#endif
+
 /**
 * include system header files
 */
 #include <iostream>
 #include <sstream>
+#include <iomanip>
 #include <string>
 #include <fstream>
 #include <vector>
@@ -0,0 +1,255 @@
+#ifndef XMATRIX_DUAL_H_
+#define XMATRIX_DUAL_H_
+
+#include "common.h"
+
+#include <type_traits>
+
+namespace xmatrix {
+
+/**
+* Dual Number: a value with its derivatives along N directions, used as a
+* DType to get a whole gradient in one forward pass. The tangents of an
+* element are one contiguous array and every operator updates them in a
+* single loop over the directions, which the compiler vectorizes. Casting a
+* dual to its value type drops the tangents
+*/
+template<typename T, size_t N>
+struct Dual {
+	static_assert(is_floating_point<T>::value, "Dual supports float point values only!");
+	static const size_t _kDirections = N;
+
+	T _value;
+	T _tangent[N];
+
+	XMATRIX_INLINE Dual() : _value(0) {
+		for (size_t k = 0; k < N; k++)
+			_tangent[k] = 0;
+	}
+
+	XMATRIX_INLINE Dual(T value) : _value(value) {
+		for (size_t k = 0; k < N; k++)
+			_tangent[k] = 0;
+	}
+
+	/**
+	* Seeded input: the derivative along the given direction is one
+	*/
+	XMATRIX_INLINE Dual(T value, size_t direction) : _value(value) {
+		for (size_t k = 0; k < N; k++)
+			_tangent[k] = 0;
+		_tangent[direction] = 1;
+	}
+
+	XMATRIX_INLINE explicit operator T() const {
+		return _value;
+	}
+
+	/**
+	* Chain rule: f(x) with the value f and the derivative df of f at x
+	*/
+	XMATRIX_INLINE static Dual Chain(const Dual &x, T f, T df) {
+		Dual result(f);
+		for (size_t k = 0; k < N; k++)
+			result._tangent[k] = df * x._tangent[k];
+		return result;
+	}
+
+	XMATRIX_INLINE Dual operator-() const {
+		return Chain(*this, -_value, -1);
+	}
+
+	XMATRIX_INLINE Dual &operator+=(const Dual &rhs) {
+		_value += rhs._value;
+		for (size_t k = 0; k < N; k++)
+			_tangent[k] += rhs._tangent[k];
+		return *this;
+	}
+
+	XMATRIX_INLINE Dual &operator-=(const Dual &rhs) {
+		_value -= rhs._value;
+		for (size_t k = 0; k < N; k++)
+			_tangent[k] -= rhs._tangent[k];
+		return *this;
+	}
+
+	XMATRIX_INLINE Dual &operator*=(const Dual &rhs) {
+		for (size_t k = 0; k < N; k++)
+			_tangent[k] = _tangent[k] * rhs._value + _value * rhs._tangent[k];
+		_value *= rhs._value;
+		return *this;
+	}
+
+	XMATRIX_INLINE Dual &operator/=(const Dual &rhs) {
+		_value /= rhs._value;
+		for (size_t k = 0; k < N; k++)
+			_tangent[k] = (_tangent[k] - _value * rhs._tangent[k]) / rhs._value;
+		return *this;
+	}
+
+	XMATRIX_INLINE Dual &operator+=(T rhs) {
+		_value += rhs;
+		return *this;
+	}
+
+	XMATRIX_INLINE Dual &operator-=(T rhs) {
+		_value -= rhs;
+		return *this;
+	}
+
+	XMATRIX_INLINE Dual &operator*=(T rhs) {
+		_value *= rhs;
+		for (size_t k = 0; k < N; k++)
+			_tangent[k] *= rhs;
+		return *this;
+	}
+
+	XMATRIX_INLINE Dual &operator/=(T rhs) {
+		_value /= rhs;
+		for (size_t k = 0; k < N; k++)
+			_tangent[k] /= rhs;
+		return *this;
+	}
+
+	/**
+	* Arithmetic: the scalar overloads take plain operands without converting
+	* them to duals first
+	*/
+	XMATRIX_INLINE friend Dual operator+(Dual lhs, const Dual &rhs) { return lhs += rhs; }
+	XMATRIX_INLINE friend Dual operator+(Dual lhs, T rhs) { return lhs += rhs; }
+	XMATRIX_INLINE friend Dual operator+(T lhs, Dual rhs) { return rhs += lhs; }
+
+	XMATRIX_INLINE friend Dual operator-(Dual lhs, const Dual &rhs) { return lhs -= rhs; }
+	XMATRIX_INLINE friend Dual operator-(Dual lhs, T rhs) { return lhs -= rhs; }
+	XMATRIX_INLINE friend Dual operator-(T lhs, const Dual &rhs) { return -rhs + lhs; }
+
+	XMATRIX_INLINE friend Dual operator*(Dual lhs, const Dual &rhs) { return lhs *= rhs; }
+	XMATRIX_INLINE friend Dual operator*(Dual lhs, T rhs) { return lhs *= rhs; }
+	XMATRIX_INLINE friend Dual operator*(T lhs, Dual rhs) { return rhs *= lhs; }
+
+	XMATRIX_INLINE friend Dual operator/(Dual lhs, const Dual &rhs) { return lhs /= rhs; }
+	XMATRIX_INLINE friend Dual operator/(Dual lhs, T rhs) { return lhs /= rhs; }
+	XMATRIX_INLINE friend Dual operator/(T lhs, const Dual &rhs) { return Chain(rhs, lhs / rhs._value, -lhs / (rhs._value * rhs._value)); }
+
+	/**
+	* Plain accumulators: an adjoint flowing from a dual back into a plain
+	* operand keeps its value only
+	*/
+	XMATRIX_INLINE friend T &operator+=(T &lhs, const Dual &rhs) { return lhs += rhs._value; }
+	XMATRIX_INLINE friend T &operator-=(T &lhs, const Dual &rhs) { return lhs -= rhs._value; }
+
+	/**
+	* Comparison: by value
+	*/
+	XMATRIX_INLINE friend bool operator==(const Dual &lhs, const Dual &rhs) { return lhs._value == rhs._value; }
+	XMATRIX_INLINE friend bool operator==(const Dual &lhs, T rhs) { return lhs._value == rhs; }
+	XMATRIX_INLINE friend bool operator==(T lhs, const Dual &rhs) { return lhs == rhs._value; }
+	XMATRIX_INLINE friend bool operator!=(const Dual &lhs, const Dual &rhs) { return lhs._value != rhs._value; }
+	XMATRIX_INLINE friend bool operator!=(const Dual &lhs, T rhs) { return lhs._value != rhs; }
+	XMATRIX_INLINE friend bool operator!=(T lhs, const Dual &rhs) { return lhs != rhs._value; }
+	XMATRIX_INLINE friend bool operator<(const Dual &lhs, const Dual &rhs) { return lhs._value < rhs._value; }
+	XMATRIX_INLINE friend bool operator<(const Dual &lhs, T rhs) { return lhs._value < rhs; }
+	XMATRIX_INLINE friend bool operator<(T lhs, const Dual &rhs) { return lhs < rhs._value; }
+	XMATRIX_INLINE friend bool operator>(const Dual &lhs, const Dual &rhs) { return lhs._value > rhs._value; }
+	XMATRIX_INLINE friend bool operator>(const Dual &lhs, T rhs) { return lhs._value > rhs; }
+	XMATRIX_INLINE friend bool operator>(T lhs, const Dual &rhs) { return lhs > rhs._value; }
+	XMATRIX_INLINE friend bool operator<=(const Dual &lhs, const Dual &rhs) { return lhs._value <= rhs._value; }
+	XMATRIX_INLINE friend bool operator<=(const Dual &lhs, T rhs) { return lhs._value <= rhs; }
+	XMATRIX_INLINE friend bool operator<=(T lhs, const Dual &rhs) { return lhs <= rhs._value; }
+	XMATRIX_INLINE friend bool operator>=(const Dual &lhs, const Dual &rhs) { return lhs._value >= rhs._value; }
+	XMATRIX_INLINE friend bool operator>=(const Dual &lhs, T rhs) { return lhs._value >= rhs; }
+	XMATRIX_INLINE friend bool operator>=(T lhs, const Dual &rhs) { return lhs >= rhs._value; }
+
+	/**
+	* Math Functions: found by argument dependent lookup from the kernels, so
+	* they do not hide the ones of <math.h>. Rounding drops the tangents
+	*/
+	XMATRIX_INLINE friend Dual exp(const Dual &x) {
+		T f = ::exp(x._value);
+		return Chain(x, f, f);
+	}
+
+	XMATRIX_INLINE friend Dual log(const Dual &x) {
+		return Chain(x, ::log(x._value), 1 / x._value);
+	}
+
+	XMATRIX_INLINE friend Dual log10(const Dual &x) {
+		return Chain(x, ::log10(x._value), 1 / (x._value * ::log((T)10)));
+	}
+
+	XMATRIX_INLINE friend Dual sqrt(const Dual &x) {
+		T f = ::sqrt(x._value);
+		return Chain(x, f, (T)0.5 / f);
+	}
+
+	XMATRIX_INLINE friend Dual pow(const Dual &x, T exp) {
+		// x^0 is constant, also at x = 0 where x^-1 is not finite
+		return Chain(x, ::pow(x._value, exp), (exp == 0)? (T)0 : exp * ::pow(x._value, exp - 1));
+	}
+
+	XMATRIX_INLINE friend Dual erf(const Dual &x) {
+		return Chain(x, ::erf(x._value), (T)1.1283791670955126 * ::exp(-x._value * x._value));
+	}
+
+	XMATRIX_INLINE friend Dual erfc(const Dual &x) {
+		return Chain(x, ::erfc(x._value), (T)-1.1283791670955126 * ::exp(-x._value * x._value));
+	}
+
+	XMATRIX_INLINE friend Dual fabs(const Dual &x) {
+		return (x._value < 0)? -x : x;
+	}
+
+	XMATRIX_INLINE friend Dual abs(const Dual &x) {
+		return fabs(x);
+	}
+
+	XMATRIX_INLINE friend T floor(const Dual &x) {
+		return ::floor(x._value);
+	}
+
+	XMATRIX_INLINE friend T ceil(const Dual &x) {
+		return ::ceil(x._value);
+	}
+
+	XMATRIX_INLINE friend T round(const Dual &x) {
+		return ::round(x._value);
+	}
+
+	XMATRIX_INLINE friend std::ostream &operator<<(std::ostream &os, const Dual &x) {
+		os << x._value << "{";
+		for (size_t k = 0; k < N; k++)
+			os << ((k > 0)? "," : "") << x._tangent[k];
+		return os << "}";
+	}
+};
+
+/**
+* Element Types: the DTypes a Tensor accepts
+*/
+template<typename DType>
+struct IsElementType {
+	static const bool value = is_integral<DType>::value || is_floating_point<DType>::value;
+};
+
+template<typename T, size_t N>
+struct IsElementType<Dual<T, N> > {
+	static const bool value = true;
+};
+
+/**
+* Float Type: element type of Exp, Log, Sqrt and Pow results, double for
+* plain types while duals stay duals
+*/
+template<typename DType>
+struct FloatType {
+	typedef double type;
+};
+
+template<typename T, size_t N>
+struct FloatType<Dual<T, N> > {
+	typedef Dual<T, N> type;
+};
+
+} // namespace xmatrix
+
+#endif // XMATRIX_DUAL_H_
@@ -0,0 +1,870 @@
+#ifndef XMATRIX_GRAPH_H_
+#define XMATRIX_GRAPH_H_
+
+#include "common.h"
+#include "tensor.h"
+#include "thread-pool.h"
+
+#include <unordered_map>
+#include <algorithm>
+#include <new>
+
+namespace xmatrix {
+
+/**
+* Graph: arena owning the nodes and operator results built while it is
+* alive. They are bump-allocated from large blocks instead of one malloc
+* each, and destroyed with the graph in one shot, so building an expression
+* per request leaks nothing. Graphs nest per thread, threads build into
+* their own; wrappers holding a node of a graph must not outlive it. A
+* fast math graph computes the exp, log and pow of its nodes with the
+* shorter polynomials of VectorMath
+*/
+struct Graph {
+	static const size_t kBlockSize = 64 * 1024;
+
+	std::vector<char *> _blocks;
+	size_t _used; // bytes taken from the last block
+	std::vector<AbstractTensor *> _nodes;
+	Graph *_previous;
+	bool _fastMath;
+
+	XMATRIX_INLINE Graph(bool fastMath = false) : _used(kBlockSize), _previous(Active()), _fastMath(fastMath) {
+		Active() = this;
+	}
+
+	XMATRIX_INLINE ~Graph() {
+		Active() = _previous;
+		for (size_t i = _nodes.size(); i-- > 0; ) {
+			if (_nodes[i]->_owners > 0) {
+				cerr << "Graph destroyed while a wrapper still holds one of its nodes" << endl;
+				assert(false);
+			}
+			_nodes[i]->~AbstractTensor();
+		}
+		for (size_t i = 0; i < _blocks.size(); i++)
+			free(_blocks[i]);
+	}
+
+	XMATRIX_INLINE static Graph *&Active() {
+		static thread_local Graph *active = NULL;
+		return active;
+	}
+
+	XMATRIX_INLINE void *Allocate(size_t size) {
+		const size_t align = alignof(std::max_align_t);
+		size = (size + align - 1) / align * align;
+		if (_used + size > kBlockSize) {
+			_blocks.push_back((char *)malloc((size > kBlockSize)? size : kBlockSize));
+			_used = 0;
+		}
+		void *p = _blocks.back() + _used;
+		_used += size;
+		return p;
+	}
+
+	XMATRIX_INLINE bool Owns(const void *p) const {
+		for (size_t i = 0; i < _blocks.size(); i++)
+			if (p >= _blocks[i] && p < _blocks[i] + kBlockSize)
+				return true;
+		return false;
+	}
+
+	/**
+	* Destroys a node ahead of the graph, its memory is kept until the end
+	*/
+	XMATRIX_INLINE void Destroy(AbstractTensor *node) {
+		for (size_t i = _nodes.size(); i-- > 0; ) {
+			if (_nodes[i] == node) {
+				_nodes.erase(_nodes.begin() + i);
+				break;
+			}
+		}
+		node->~AbstractTensor();
+	}
+};
+
+/**
+* Node Allocation: nodes come from the active Graph, if any, or the heap
+*/
+template<typename Node, typename... Args>
+XMATRIX_INLINE Node *NewTensor(Args &&... args) {
+	Graph *graph = Graph::Active();
+	if (graph == NULL)
+		return new Node(std::forward<Args>(args)...);
+
+	Node *node = new (graph->Allocate(sizeof(Node))) Node(std::forward<Args>(args)...);
+	node->_graph = graph;
+	graph->_nodes.push_back(node);
+	return node;
+}
+
+XMATRIX_INLINE bool AbstractTensor::IsFastMath() const {
+	return _graph != NULL && _graph->_fastMath;
+}
+
+XMATRIX_INLINE void DeleteTensor(AbstractTensor *node) {
+	if (node->_graph != NULL)
+		node->_graph->Destroy(node);
+	else
+		delete node;
+}
+
+/**
+* Topological Sort: the stale nodes the roots depend on, every node after
+* all of its inputs. Nodes already up to date are cut off with their subtrees
+* unless all nodes are asked for
+*/
+XMATRIX_INLINE void TopologicalSort(AbstractTensor * const *roots, size_t count, std::vector<AbstractTensor *> &order, 
+	bool staleOnly = true) {
+	std::unordered_map<AbstractTensor *, bool> visited;
+	std::vector<std::pair<AbstractTensor *, size_t> > stack;
+
+	for (size_t r = 0; r < count; r++) {
+		if ((staleOnly && roots[r]->_isUpdated) || visited.count(roots[r]))
+			continue;
+		visited[roots[r]] = true;
+		stack.push_back(std::make_pair(roots[r], (size_t)0));
+
+		while (!stack.empty()) {
+			AbstractTensor *node = stack.back().first;
+			size_t &next = stack.back().second;
+			if (next < node->_inputs.size()) {
+				AbstractTensor *input = node->_inputs[next++];
+				if (!(staleOnly && input->_isUpdated) && !visited.count(input)) {
+					visited[input] = true;
+					stack.push_back(std::make_pair(input, (size_t)0));
+				}
+			} else {
+				order.push_back(node);
+				stack.pop_back();
+			}
+		}
+	}
+}
+
+/**
+* Scheduler: brings the roots up to date by running their stale nodes on the
+* thread pool as soon as all of their inputs are done, so independent
+* subtrees are computed concurrently. An elementwise node whose single
+* consumer is elementwise too is streamed by that consumer and has nothing
+* to run on its own
+*/
+struct Scheduler {
+	std::vector<AbstractTensor *> _order;
+	std::unordered_map<AbstractTensor *, size_t> _index;
+	std::vector<bool> _skip;
+	std::vector<std::atomic<size_t> > _waiting;
+	std::atomic<size_t> _remaining;
+
+	XMATRIX_INLINE Scheduler(AbstractTensor * const *roots, size_t count)
+		: _remaining(0) {
+		TopologicalSort(roots, count, _order);
+		for (size_t i = 0; i < _order.size(); i++)
+			_order[i]->CheckShape();
+		_waiting = std::vector<std::atomic<size_t> >(_order.size());
+		for (size_t i = 0; i < _order.size(); i++)
+			_index[_order[i]] = i;
+		_skip = std::vector<bool>(_order.size(), false);
+		for (size_t i = 0; i < _order.size(); i++)
+			_skip[i] = IsFused(_order[i]) && _index.count(_order[i]->_consumers[0]);
+		for (size_t r = 0; r < count; r++)
+			if (_index.count(roots[r]))
+				_skip[_index[roots[r]]] = false;
+		for (size_t i = 0; i < _order.size(); i++) {
+			size_t waiting = 0;
+			for (size_t j = 0; j < _order[i]->_inputs.size(); j++)
+				waiting += _index.count(_order[i]->_inputs[j]);
+			_waiting[i] = waiting;
+		}
+	}
+
+	XMATRIX_INLINE static bool IsFused(AbstractTensor *node) {
+		return node->IsElementwise() && node->_consumers.size() == 1 && node->_consumers[0]->StreamsInputs();
+	}
+
+	XMATRIX_INLINE void Run() {
+		ThreadPool &pool = ThreadPool::Instance();
+		if (pool._threads == 1 || _order.size() < 2) {
+			for (size_t i = 0; i < _order.size(); i++)
+				if (!_skip[i])
+					_order[i]->Update();
+			return;
+		}
+
+		// the ready nodes are collected first, running ones release others
+		std::vector<size_t> ready;
+		for (size_t i = 0; i < _order.size(); i++)
+			if (_waiting[i] == 0)
+				ready.push_back(i);
+		_remaining = _order.size();
+		for (size_t i = 0; i < ready.size(); i++)
+			Submit(ready[i]);
+		pool.Wait(_remaining);
+	}
+
+	XMATRIX_INLINE void Submit(size_t i) {
+		ThreadPool::Instance().Submit([this, i] { Execute(i); });
+	}
+
+	XMATRIX_INLINE void Execute(size_t i) {
+		AbstractTensor *node = _order[i];
+		if (!_skip[i])
+			node->Update();
+		for (size_t j = 0; j < node->_consumers.size(); j++) {
+			std::unordered_map<AbstractTensor *, size_t>::const_iterator it = _index.find(node->_consumers[j]);
+			if (it != _index.end() && --_waiting[it->second] == 0)
+				Submit(it->second);
+		}
+		_remaining--;
+	}
+};
+
+/**
+* Tape: reverse-mode differentiation of a root. Its nodes are sorted once and
+* the tape is reused across Load()s of the leaves. Forward() brings every node
+* up to date with its buffer materialized (fused nodes included), Backward()
+* seeds the adjoint of the root with ones and propagates it back, leaving in
+* the _grad of every node the gradient of the sum of the root elements
+*/
+struct Tape {
+	std::vector<AbstractTensor *> _order;
+
+	template<typename Root>
+	XMATRIX_INLINE Tape(Root &root) {
+		AbstractTensor *node = root._tensor;
+		TopologicalSort(&node, 1, _order, false);
+	}
+
+	XMATRIX_INLINE void Forward() {
+		for (size_t i = 0; i < _order.size(); i++)
+			_order[i]->Update();
+	}
+
+	XMATRIX_INLINE void Backward() {
+		if (_order.empty())
+			return;
+		for (size_t i = 0; i < _order.size(); i++)
+			_order[i]->ClearGrad();
+		_order.back()->SeedGrad();
+		for (size_t i = _order.size(); i-- > 0; )
+			_order[i]->Backward();
+	}
+
+	XMATRIX_INLINE void Run() {
+		Forward();
+		Backward();
+	}
+};
+
+/**
+* Graph Key: canonical description of the graph below a root, in topological
+* order: type of every node (with its element type), its operator parameters,
+* the positions of its inputs, its number of consumers and the extents of the
+* leaves. Two graphs built by the same formula on inputs of the same shapes
+* have the same key
+*/
+XMATRIX_INLINE void GraphKey(const std::vector<AbstractTensor *> &order, std::string &key) {
+	std::unordered_map<AbstractTensor *, size_t> index;
+	for (size_t i = 0; i < order.size(); i++)
+		index[order[i]] = i;
+
+	key.clear();
+	for (size_t i = 0; i < order.size(); i++) {
+		AbstractTensor *node = order[i];
+		size_t consumers = node->_consumers.size();
+		key += typeid(*node).name();
+		key += '(';
+		for (size_t j = 0; j < node->_inputs.size(); j++) {
+			size_t input = index[node->_inputs[j]];
+			key.append((const char *)&input, sizeof(input));
+		}
+		key += ')';
+		key.append((const char *)&consumers, sizeof(consumers));
+		key += node->_params;
+		if (node->_inputs.empty())
+			node->ShapeKey(key);
+		key += ';';
+	}
+}
+
+/**
+* Plan Cache: process-wide store of compiled layouts by graph key, shared by
+* all threads, so a formula built again for every request is compiled once
+*/
+template<typename Layout>
+struct PlanCache {
+	XMATRIX_INLINE static std::unordered_map<std::string, Layout> &Layouts() {
+		static std::unordered_map<std::string, Layout> layouts;
+		return layouts;
+	}
+
+	XMATRIX_INLINE static std::mutex &Mutex() {
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	XMATRIX_INLINE static bool Find(const std::string &key, Layout &layout) {
+		std::lock_guard<std::mutex> lock(Mutex());
+		typename std::unordered_map<std::string, Layout>::const_iterator it = Layouts().find(key);
+		if (it == Layouts().end())
+			return false;
+		layout = it->second;
+		return true;
+	}
+
+	XMATRIX_INLINE static void Insert(const std::string &key, const Layout &layout) {
+		std::lock_guard<std::mutex> lock(Mutex());
+		Layouts()[key] = layout;
+	}
+
+	XMATRIX_INLINE static void Clear() {
+		std::lock_guard<std::mutex> lock(Mutex());
+		Layouts().clear();
+	}
+};
+
+/**
+* Plan Layout: what compiling a plan decides, as positions in the
+* topological order so that it applies to every graph of the same key, with
+* the offsets of the intermediate buffers in the block of the plan. Buffers
+* whose lifetimes do not overlap share offsets
+*/
+struct PlanLayout {
+	static const size_t kAlignment = 64;
+
+	std::vector<size_t> _leaves;
+	std::vector<size_t> _fused;
+	std::vector<size_t> _instructions;
+	std::vector<size_t> _buffers;
+	std::vector<size_t> _offsets;
+	size_t _bytes;
+
+	XMATRIX_INLINE PlanLayout() : _bytes(0) {}
+};
+
+/**
+* Plan: a root compiled once into a flat instruction list. Compile() sorts
+* the nodes, resolves their shapes and buffers with one pass and leaves
+* out the fused ones; Run() then executes the list in a loop, one Execute()
+* per node without recursion, staleness or shape checks. Leaves may be
+* reloaded between runs, a leaf loaded with another shape recompiles the plan.
+* Layouts are looked up in the PlanCache by graph key first, so building the
+* plan of a known formula and shapes costs a sort and a hash lookup.
+* Shapes are inferred for the whole graph before anything is computed, and
+* the intermediates, sized upfront, share one block allocated by the plan;
+* they give their buffers back when it is destroyed, the root keeps its own.
+* An intermediate only holds its result until its last reader has run, so
+* once a plan is built its nodes are brought up to date by Run() only
+*/
+struct Plan {
+	AbstractTensor *_root;
+	std::vector<AbstractTensor *> _order;
+	std::vector<AbstractTensor *> _leaves;
+	std::vector<AbstractTensor *> _fused;
+	std::vector<AbstractTensor *> _instructions;
+	std::vector<AbstractTensor *> _bound;
+	char *_block;
+	size_t _bytes; // size of the block
+	std::string _graphKey;
+	std::string _shapes; // extents of the leaves the plan was compiled for
+	std::string _key;
+
+	template<typename Root>
+	XMATRIX_INLINE Plan(Root &root) : _root(root._tensor), _block(NULL), _bytes(0) {
+		Compile();
+	}
+
+	Plan(const Plan &) = delete;
+	Plan &operator=(const Plan &) = delete;
+
+	XMATRIX_INLINE ~Plan() {
+		Release();
+	}
+
+	XMATRIX_INLINE void Compile() {
+		Release();
+		_order.clear();
+		TopologicalSort(&_root, 1, _order, false);
+		for (size_t i = 0; i < _order.size(); i++)
+			_order[i]->CheckShape();
+		GraphKey(_order, _graphKey);
+
+		PlanLayout layout;
+		if (!PlanCache<PlanLayout>::Find(_graphKey, layout)) {
+			Schedule(layout);
+			PlanCache<PlanLayout>::Insert(_graphKey, layout);
+		}
+		Nodes(layout._leaves, _leaves);
+		Nodes(layout._fused, _fused);
+		Nodes(layout._instructions, _instructions);
+		Allocate(layout);
+
+		// in the order of the list, the slots of the block are shared
+		for (size_t i = 0; i < _order.size(); i++)
+			if (!_order[i]->_inputs.empty())
+				_order[i]->_isUpdated = false;
+		for (size_t i = 0; i < _instructions.size(); i++)
+			_instructions[i]->Update();
+		for (size_t i = 0; i < _bound.size(); i++)
+			_bound[i]->_isUpdated = false;
+		LeafShapes(_shapes);
+	}
+
+	XMATRIX_INLINE void Allocate(const PlanLayout &layout) {
+		_bytes = layout._bytes;
+		_block = (_bytes > 0)? (char *)malloc(_bytes) : NULL;
+		Nodes(layout._buffers, _bound);
+		for (size_t i = 0; i < _bound.size(); i++) {
+			_bound[i]->Bind(_block + layout._offsets[i]);
+			_bound[i]->_isUpdated = false;
+		}
+	}
+
+	/**
+	* Unbinds the intermediates from the block, they are stale afterwards
+	*/
+	XMATRIX_INLINE void Release() {
+		for (size_t i = 0; i < _bound.size(); i++) {
+			_bound[i]->Bind(NULL);
+			_bound[i]->_isUpdated = false;
+		}
+		_bound.clear();
+		free(_block);
+		_block = NULL;
+		_bytes = 0;
+	}
+
+	XMATRIX_INLINE void Schedule(PlanLayout &layout) const {
+		std::unordered_map<AbstractTensor *, bool> inPlan;
+		for (size_t i = 0; i < _order.size(); i++)
+			inPlan[_order[i]] = true;
+
+		for (size_t i = 0; i < _order.size(); i++) {
+			AbstractTensor *node = _order[i];
+			if (node->_inputs.empty())
+				layout._leaves.push_back(i);
+			else if (node != _root && Scheduler::IsFused(node) && inPlan.count(node->_consumers[0]))
+				layout._fused.push_back(i);
+			else
+				layout._instructions.push_back(i);
+		}
+
+		PlanMemory(layout);
+	}
+
+	/**
+	* Memory Planning: the offsets of the intermediates in the block, for the
+	* instruction lists of the layout. A buffer is free again once the last
+	* instruction reading it has run, directly, through a view or streamed by
+	* a fused node, and goes to the next intermediate that fits. An
+	* elementwise instruction takes over the buffer of an input with the
+	* same extents read for the last time, and runs in place: element i of
+	* the input is read before element i of the result is written
+	*/
+	XMATRIX_INLINE void PlanMemory(PlanLayout &layout) const {
+		const size_t never = (size_t)-1;
+		size_t count = _order.size();
+		std::unordered_map<AbstractTensor *, size_t> position;
+		for (size_t i = 0; i < count; i++)
+			position[_order[i]] = i;
+
+		// instruction running each node, fused nodes run with their consumer
+		std::vector<size_t> step(count, never);
+		for (size_t k = 0; k < layout._instructions.size(); k++)
+			step[layout._instructions[k]] = k;
+		for (size_t i = count; i-- > 0; )
+			if (step[i] == never && !_order[i]->_inputs.empty())
+				step[i] = step[position[_order[i]->_consumers[0]]];
+
+		// buffer holding the elements of each node, views hold none of their own
+		std::vector<size_t> storage(count, never);
+		for (size_t i = 0; i < count; i++) {
+			AbstractTensor *node = _order[i];
+			if (!node->_inputs.empty())
+				storage[i] = node->IsView()? storage[position[node->_inputs[0]]] : i;
+		}
+
+		std::vector<size_t> lastUse(count, never);
+		std::vector<bool> aligned(count, false); // all last reads in place safe
+		for (size_t i = 0; i < count; i++) {
+			AbstractTensor *node = _order[i];
+			for (size_t j = 0; j < node->_inputs.size(); j++) {
+				size_t input = position[node->_inputs[j]], buffer = storage[input];
+				if (buffer == never || (buffer == input && step[input] == step[i] && input != layout._instructions[step[i]]))
+					continue;
+				bool inPlace = node->IsElementwise() && buffer == input;
+				if (lastUse[buffer] == never || step[i] > lastUse[buffer]) {
+					lastUse[buffer] = step[i];
+					aligned[buffer] = inPlace;
+				} else if (step[i] == lastUse[buffer]) {
+					aligned[buffer] = aligned[buffer] && inPlace;
+				}
+			}
+		}
+
+		std::vector<bool> planned(count, false);
+		for (size_t k = 0; k < layout._instructions.size(); k++) {
+			size_t i = layout._instructions[k];
+			planned[i] = storage[i] == i;
+		}
+		size_t root = position[_root];
+		planned[root] = false;
+		if (storage[root] != never)
+			planned[storage[root]] = false;
+
+		std::vector<size_t> offset(count, never);
+		std::vector<std::pair<size_t, size_t> > free; // offset and size of the free ranges
+		std::vector<std::vector<size_t> > dying(layout._instructions.size());
+		for (size_t i = 0; i < count; i++)
+			if (planned[i])
+				dying[(lastUse[i] == never)? step[i] : lastUse[i]].push_back(i);
+
+		layout._bytes = 0;
+		for (size_t k = 0; k < layout._instructions.size(); k++) {
+			size_t i = layout._instructions[k];
+			AbstractTensor *node = _order[i];
+			if (planned[i]) {
+				size_t size = Aligned(node->MemSize());
+				if (node->IsElementwise()) {
+					std::string key, other;
+					node->ShapeKey(key);
+					for (size_t d = 0; d < dying[k].size() && offset[i] == never; d++) {
+						size_t input = dying[k][d];
+						other.clear();
+						_order[input]->ShapeKey(other);
+						if (input != i && aligned[input] && offset[input] != never 
+							&& Aligned(_order[input]->MemSize()) == size && other == key) {
+							offset[i] = offset[input];
+							offset[input] = never; // handed over
+						}
+					}
+				}
+				if (offset[i] == never)
+					offset[i] = Take(free, layout._bytes, size);
+				layout._buffers.push_back(i);
+				layout._offsets.push_back(offset[i]);
+			}
+			for (size_t d = 0; d < dying[k].size(); d++)
+				if (offset[dying[k][d]] != never)
+					Give(free, offset[dying[k][d]], Aligned(_order[dying[k][d]]->MemSize()));
+		}
+	}
+
+	XMATRIX_INLINE static size_t Aligned(size_t bytes) {
+		return (bytes + PlanLayout::kAlignment - 1) / PlanLayout::kAlignment * PlanLayout::kAlignment;
+	}
+
+	/**
+	* Best fit among the free ranges, the block grows if none fits
+	*/
+	XMATRIX_INLINE static size_t Take(std::vector<std::pair<size_t, size_t> > &free, size_t &bytes, size_t size) {
+		size_t best = free.size();
+		for (size_t f = 0; f < free.size(); f++)
+			if (free[f].second >= size && (best == free.size() || free[f].second < free[best].second))
+				best = f;
+		if (best < free.size()) {
+			size_t offset = free[best].first;
+			free[best].first += size;
+			free[best].second -= size;
+			if (free[best].second == 0)
+				free.erase(free.begin() + best);
+			return offset;
+		}
+		if (!free.empty() && free.back().first + free.back().second == bytes) {
+			size_t offset = free.back().first;
+			bytes = offset + size;
+			free.pop_back();
+			return offset;
+		}
+		bytes += size;
+		return bytes - size;
+	}
+
+	XMATRIX_INLINE static void Give(std::vector<std::pair<size_t, size_t> > &free, size_t offset, size_t size) {
+		size_t f = 0;
+		while (f < free.size() && free[f].first < offset)
+			f++;
+		free.insert(free.begin() + f, std::make_pair(offset, size));
+		if (f + 1 < free.size() && free[f].first + free[f].second == free[f + 1].first) {
+			free[f].second += free[f + 1].second;
+			free.erase(free.begin() + f + 1);
+		}
+		if (f > 0 && free[f - 1].first + free[f - 1].second == free[f].first) {
+			free[f - 1].second += free[f].second;
+			free.erase(free.begin() + f);
+		}
+	}
+
+	XMATRIX_INLINE void Nodes(const std::vector<size_t> &positions, std::vector<AbstractTensor *> &nodes) const {
+		nodes.resize(positions.size());
+		for (size_t i = 0; i < positions.size(); i++)
+			nodes[i] = _order[positions[i]];
+	}
+
+	XMATRIX_INLINE void LeafShapes(std::string &key) const {
+		key.clear();
+		for (size_t i = 0; i < _leaves.size(); i++)
+			_leaves[i]->ShapeKey(key);
+	}
+
+	XMATRIX_INLINE void Run() {
+		LeafShapes(_key);
+		if (_key != _shapes) {
+			Compile();
+			return;
+		}
+
+		for (size_t i = 0; i < _leaves.size(); i++)
+			_leaves[i]->_isUpdated = true;
+		for (size_t i = 0; i < _fused.size(); i++)
+			_fused[i]->_isUpdated = false;
+		for (size_t i = 0; i < _instructions.size(); i++) {
+			_instructions[i]->Execute();
+			_instructions[i]->_isUpdated = true;
+		}
+		for (size_t i = 0; i < _bound.size(); i++)
+			_bound[i]->_isUpdated = false;
+	}
+};
+
+/**
+* Budgeted Evaluation: brings a root up to date with at most _budget bytes
+* of the buffers it computes resident at once. Nodes run one by one in
+* topological order; an intermediate is freed as soon as the last node
+* reading it has run, and when the next one does not fit, intermediates
+* read later are dropped too, elementwise ones first as they are the
+* cheapest to compute again, then those read last. A dropped node is left
+* stale and computed again, from its inputs if they were dropped as well,
+* when a node reads it. A node larger than what can be freed still runs,
+* _peak tells the resident bytes reached. Intermediates are stale
+* afterwards, their next Update() computes them again
+*/
+struct BudgetedEvaluation {
+	AbstractTensor *_root;
+	size_t _budget;
+	std::vector<AbstractTensor *> _order;
+	std::unordered_map<AbstractTensor *, size_t> _index;
+	std::vector<bool> _skip; // fused, streamed by their consumer
+	std::vector<std::vector<size_t> > _reads; // buffers read by each node, through fused nodes
+	std::vector<std::vector<size_t> > _views; // views into the buffer of each node
+	std::vector<std::vector<size_t> > _uses; // nodes reading each node, in order
+	std::vector<size_t> _next; // first use not run yet
+	std::vector<bool> _resident;
+	std::vector<bool> _pinned; // read by the node running
+	std::vector<size_t> _touched; // computed for the node running
+	size_t _bytes; // resident
+	size_t _peak;
+	size_t _recomputed; // nodes computed again after they were dropped
+
+	template<typename Root>
+	XMATRIX_INLINE BudgetedEvaluation(Root &root, size_t budget) 
+		: _root(root._tensor), _budget(budget), _bytes(0), _peak(0), _recomputed(0) {
+		TopologicalSort(&_root, 1, _order);
+		size_t count = _order.size();
+		for (size_t i = 0; i < count; i++) {
+			_order[i]->CheckShape();
+			_index[_order[i]] = i;
+		}
+		_skip = std::vector<bool>(count, false);
+		for (size_t i = 0; i < count; i++)
+			_skip[i] = _order[i] != _root && Scheduler::IsFused(_order[i]) && _index.count(_order[i]->_consumers[0]);
+
+		_reads.resize(count);
+		_views.resize(count);
+		_uses.resize(count);
+		for (size_t i = 0; i < count; i++) {
+			AbstractTensor *node = _order[i];
+			if (_skip[i] || node->_inputs.empty())
+				continue;
+			std::vector<AbstractTensor *> stack(node->_inputs);
+			while (!stack.empty()) {
+				AbstractTensor *input = stack.back();
+				stack.pop_back();
+				std::unordered_map<AbstractTensor *, size_t>::const_iterator it = _index.find(input);
+				if (it == _index.end())
+					continue;
+				if (_skip[it->second])
+					stack.insert(stack.end(), input->_inputs.begin(), input->_inputs.end());
+				else if (std::find(_reads[i].begin(), _reads[i].end(), it->second) == _reads[i].end())
+					_reads[i].push_back(it->second);
+			}
+			for (size_t j = 0; j < _reads[i].size(); j++)
+				_uses[_reads[i][j]].push_back(i);
+			if (node->IsView() && _index.count(node->_inputs[0]))
+				_views[_index[node->_inputs[0]]].push_back(i);
+		}
+		_next = std::vector<size_t>(count, 0);
+		_resident = std::vector<bool>(count, false);
+		_pinned = std::vector<bool>(count, false);
+	}
+
+	XMATRIX_INLINE void Run() {
+		for (size_t i = 0; i < _order.size(); i++) {
+			if (_skip[i] || _order[i]->_inputs.empty())
+				continue;
+			Pin(i, _touched);
+			for (size_t j = 0; j < _reads[i].size(); j++)
+				Pin(_reads[i][j], _touched);
+			Materialize(i);
+			for (size_t j = 0; j < _reads[i].size(); j++)
+				_next[_reads[i][j]]++;
+
+			for (size_t j = 0; j < _touched.size(); j++)
+				_pinned[_touched[j]] = false;
+			for (size_t j = 0; j < _touched.size(); j++)
+				if (_resident[_touched[j]] && !IsLive(_touched[j]))
+					Drop(_touched[j]);
+			_touched.clear();
+		}
+	}
+
+	/**
+	* Keeps a node from being dropped, with the buffer a view reads from;
+	* the nodes pinned by this call are appended to pinned
+	*/
+	XMATRIX_INLINE void Pin(size_t i, std::vector<size_t> &pinned) {
+		while (true) {
+			if (!_pinned[i]) {
+				_pinned[i] = true;
+				pinned.push_back(i);
+			}
+			AbstractTensor *node = _order[i];
+			if (!node->IsView() || node->_inputs.empty() || !_index.count(node->_inputs[0]))
+				return;
+			i = _index[node->_inputs[0]];
+		}
+	}
+
+	/**
+	* Computes a node whose inputs may have been dropped, they are computed
+	* first, inputs before consumers. The inputs of a node computed again
+	* are pinned only while it runs, those of the node running until it is
+	* done
+	*/
+	XMATRIX_INLINE void Materialize(size_t i) {
+		if (_order[i]->_isUpdated)
+			return;
+		std::vector<std::pair<size_t, size_t> > stack(1, std::make_pair(i, (size_t)0));
+		std::vector<std::vector<size_t> > pinned(1);
+		while (!stack.empty()) {
+			size_t node = stack.back().first;
+			size_t &next = stack.back().second;
+			if (next < _reads[node].size()) {
+				size_t input = _reads[node][next++];
+				if (stack.size() > 1)
+					Pin(input, pinned.back());
+				if (!_order[input]->_isUpdated) {
+					stack.push_back(std::make_pair(input, (size_t)0));
+					pinned.push_back(std::vector<size_t>());
+				}
+			} else {
+				Compute(node);
+				for (size_t j = 0; j < pinned.back().size(); j++) {
+					_pinned[pinned.back()[j]] = false;
+					_touched.push_back(pinned.back()[j]);
+				}
+				stack.pop_back();
+				pinned.pop_back();
+			}
+		}
+	}
+
+	XMATRIX_INLINE void Compute(size_t i) {
+		AbstractTensor *node = _order[i];
+		size_t size = node->_inputs.empty()? 0 : node->MemSize(); // leaves are never dropped
+		if (_next[i] > 0)
+			_recomputed++;
+		Reserve(size);
+		node->Update();
+		if (size > 0) {
+			_resident[i] = true;
+			_bytes += size;
+			_peak = (_bytes > _peak)? _bytes : _peak;
+		}
+	}
+
+	/**
+	* Drops unpinned intermediates until size more bytes fit in the budget
+	*/
+	XMATRIX_INLINE void Reserve(size_t size) {
+		while (_bytes + size > _budget) {
+			size_t victim = _order.size();
+			for (size_t i = 0; i < _order.size(); i++) {
+				if (!_resident[i] || _pinned[i] || _order[i] == _root)
+					continue;
+				if (victim == _order.size() || IsCheaper(i, victim))
+					victim = i;
+			}
+			if (victim == _order.size())
+				return;
+			Drop(victim);
+		}
+	}
+
+	XMATRIX_INLINE bool IsCheaper(size_t i, size_t j) const {
+		bool elementwise = _order[i]->IsElementwise();
+		if (elementwise != _order[j]->IsElementwise())
+			return elementwise;
+		return NextUse(i) > NextUse(j);
+	}
+
+	/**
+	* Position of the next node reading the buffer, directly or through a view
+	*/
+	XMATRIX_INLINE size_t NextUse(size_t i) const {
+		size_t next = _order.size();
+		std::vector<size_t> stack(1, i);
+		while (!stack.empty()) {
+			size_t node = stack.back();
+			stack.pop_back();
+			if (_next[node] < _uses[node].size() && _uses[node][_next[node]] < next)
+				next = _uses[node][_next[node]];
+			stack.insert(stack.end(), _views[node].begin(), _views[node].end());
+		}
+		return next;
+	}
+
+	XMATRIX_INLINE bool IsLive(size_t i) const {
+		return _order[i] == _root || NextUse(i) < _order.size();
+	}
+
+	/**
+	* Frees the buffer of a node, it and the views into it are stale
+	*/
+	XMATRIX_INLINE void Drop(size_t i) {
+		_order[i]->FreeMem();
+		_resident[i] = false;
+		_bytes -= _order[i]->MemSize();
+		std::vector<size_t> stack(1, i);
+		while (!stack.empty()) {
+			size_t node = stack.back();
+			stack.pop_back();
+			_order[node]->_isUpdated = false;
+			stack.insert(stack.end(), _views[node].begin(), _views[node].end());
+		}
+	}
+};
+
+/**
+* Budgeted Update: brings the root up to date within budget bytes of
+* intermediates, computing some of them more than once if they do not fit
+*/
+template<typename Root>
+XMATRIX_INLINE void BudgetedUpdate(Root &root, size_t budget) {
+	BudgetedEvaluation(root, budget).Run();
+}
+
+/**
+* Parallel Update: brings several roots up to date in one schedule, so the
+* inputs they share are computed once and their own nodes run concurrently
+*/
+template<typename... Tensors>
+XMATRIX_INLINE void ParallelUpdate(Tensors &... tensors) {
+	AbstractTensor *roots[] = { tensors._tensor... };
+	Scheduler(roots, sizeof...(tensors)).Run();
+}
+
+} // namespace xmatrix
+
+#endif // XMATRIX_GRAPH_H_
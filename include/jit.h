@@ -0,0 +1,347 @@
+#ifndef XMATRIX_JIT_H_
+#define XMATRIX_JIT_H_
+
+#include "common.h"
+#include "tensor.h"
+#include "graph.h"
+
+#include <unordered_map>
+#include <cstdlib>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+/**
+* Compiler and flags the generated kernels are built with
+*/
+#ifndef XMATRIX_JIT_CXX
+#define XMATRIX_JIT_CXX "c++"
+#endif
+#ifndef XMATRIX_JIT_FLAGS
+#define XMATRIX_JIT_FLAGS "-O3 -march=native -shared -fPIC"
+#endif
+
+/**
+* Directory of the compiled kernels, overridden by the XMATRIX_JIT_CACHE
+* environment variable
+*/
+#ifndef XMATRIX_JIT_CACHE
+#define XMATRIX_JIT_CACHE "/tmp/xmatrix-jit"
+#endif
+
+namespace xmatrix {
+
+/**
+* JIT Source: C++ source of one kernel. The inlined nodes are expanded into
+* the expressions of their consumers, every other node is read from its
+* buffer, passed in args
+*/
+struct JitSource : public JitCode {
+	std::unordered_map<AbstractTensor *, bool> _inlined;
+	std::unordered_map<AbstractTensor *, size_t> _index;
+	std::vector<AbstractTensor *> _arguments;
+	std::string _declarations;
+
+	XMATRIX_INLINE virtual bool Operand(AbstractTensor &node, const std::string &index, std::string &expr) {
+		const char *type = node.TypeName();
+		if (type == NULL)
+			return false;
+		if (!_inlined.count(&node))
+			return node.EmitLoad(*this, index, expr);
+
+		std::string inlined;
+		if (!node.Emit(*this, index, inlined))
+			return false;
+		expr = std::string("((") + type + ")(" + inlined + "))";
+		return true;
+	}
+
+	XMATRIX_INLINE virtual std::string Argument(AbstractTensor &node, const char *type) {
+		std::ostringstream name;
+		std::unordered_map<AbstractTensor *, size_t>::const_iterator it = _index.find(&node);
+		if (it != _index.end()) {
+			name << "a" << it->second;
+			return name.str();
+		}
+
+		size_t index = _arguments.size();
+		_index[&node] = index;
+		_arguments.push_back(&node);
+		name << "a" << index;
+		std::ostringstream declaration;
+		declaration << "\t" << type << " *" << name.str() << " = (" << type << " *)args[" << index << "];\n";
+		_declarations += declaration.str();
+		return name.str();
+	}
+};
+
+/**
+* JIT Library: the generated kernels of a source compiled to a shared library
+* by the system compiler. Libraries are cached on disk by a hash of their
+* source, the compiler, its flags and the library version, so a warm start
+* reuses them without compiling, and stay loaded for the lifetime of the
+* process
+*/
+struct JitLibrary {
+	typedef void (*Function)(void *const *args);
+
+	XMATRIX_INLINE static std::string Hash(const std::string &source) {
+		unsigned long long hash = 14695981039346656037ULL; // FNV-1a
+		for (size_t i = 0; i < source.size(); i++) {
+			hash ^= (unsigned char)source[i];
+			hash *= 1099511628211ULL;
+		}
+		std::ostringstream os;
+		os << std::hex << std::setw(16) << std::setfill('0') << hash;
+		return os.str();
+	}
+
+	XMATRIX_INLINE static std::string Key(const std::string &source) {
+		return Hash(std::string(XMATRIX_JIT_CXX) + "\n" + XMATRIX_JIT_FLAGS + "\n" + XMATRIX_VERSION + "\n" + source);
+	}
+
+	XMATRIX_INLINE static std::string Directory() {
+		const char *dir = getenv("XMATRIX_JIT_CACHE");
+		return (dir != NULL && dir[0] != 0)? dir : XMATRIX_JIT_CACHE;
+	}
+
+	/**
+	* mkdir -p without a shell, one component at a time
+	*/
+	XMATRIX_INLINE static bool MakeDirectory(const std::string &dir) {
+		for (size_t end = 1; end <= dir.size(); end++) {
+			if (end < dir.size() && dir[end] != '/')
+				continue;
+			std::string path = dir.substr(0, end);
+			struct stat info;
+			if (mkdir(path.c_str(), 0755) != 0 && (errno != EEXIST || stat(path.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)))
+				return false;
+		}
+		return true;
+	}
+
+	/**
+	* path as a single word of a shell command
+	*/
+	XMATRIX_INLINE static std::string Quote(const std::string &path) {
+		std::string quoted = "'";
+		for (size_t i = 0; i < path.size(); i++) {
+			if (path[i] == '\'')
+				quoted += "'\\''";
+			else
+				quoted += path[i];
+		}
+		return quoted + "'";
+	}
+
+	XMATRIX_INLINE static bool ReadFile(const std::string &path, std::string &content) {
+		std::ifstream in(path.c_str(), std::ios::binary);
+		if (!in)
+			return false;
+		std::ostringstream os;
+		os << in.rdbuf();
+		content = os.str();
+		return true;
+	}
+
+	/**
+	* Handle of the library built from source, NULL if it does not compile
+	*/
+	XMATRIX_INLINE static void *Load(const std::string &source) {
+		static std::unordered_map<std::string, void *> loaded;
+		static std::mutex mutex;
+		std::lock_guard<std::mutex> lock(mutex);
+
+		std::string hash = Key(source);
+		std::unordered_map<std::string, void *>::const_iterator it = loaded.find(hash);
+		if (it != loaded.end())
+			return it->second;
+
+		std::string dir = Directory();
+		std::string sourcePath = dir + "/" + hash + ".cpp";
+		std::string libraryPath = dir + "/" + hash + ".so";
+		std::string cached;
+		if (!ReadFile(sourcePath, cached) || cached != source || access(libraryPath.c_str(), R_OK) != 0) {
+			if (!MakeDirectory(dir)) {
+				cerr << "JIT cache directory " << dir << " cannot be created" << endl;
+				return loaded[hash] = NULL;
+			}
+
+			// built under a private name and renamed, so concurrent processes
+			// never load a partial library
+			std::ostringstream temp;
+			temp << dir << "/" << hash << "." << getpid();
+			std::ofstream out((temp.str() + ".cpp").c_str(), std::ios::binary);
+			out << source;
+			out.close();
+			std::string command = std::string(XMATRIX_JIT_CXX) + " " + XMATRIX_JIT_FLAGS + " -o " + Quote(temp.str() + ".so") + " " + Quote(temp.str() + ".cpp");
+			if (!out || system(command.c_str()) != 0) {
+				cerr << "JIT compilation failed: " << command << endl;
+				remove((temp.str() + ".cpp").c_str());
+				return loaded[hash] = NULL;
+			}
+			rename((temp.str() + ".so").c_str(), libraryPath.c_str());
+			rename((temp.str() + ".cpp").c_str(), sourcePath.c_str());
+		}
+
+		void *handle = dlopen(libraryPath.c_str(), RTLD_NOW | RTLD_LOCAL);
+		if (handle == NULL)
+			cerr << "JIT library cannot be loaded: " << dlerror() << endl;
+		return loaded[hash] = handle;
+	}
+};
+
+/**
+* JIT Layout: the kernels generated for a graph key, with the positions of
+* their arguments in the topological order. Inlined nodes no longer hold
+* buffers, so the memory of the plan is laid out again
+*/
+struct JitLayout : public PlanLayout {
+	std::vector<JitLibrary::Function> _kernels; // per instruction, NULL to Execute()
+	std::vector<std::vector<size_t> > _arguments;
+	std::string _source;
+};
+
+/**
+* JIT Plan: a Plan whose instructions run generated code. Every elementwise
+* node with a single consumer is inlined into the kernel of its consumer, so
+* a whole fused group, or a reduction of one, becomes a single loop compiled
+* for the shapes of the plan. Nodes the JIT cannot generate (matrix products,
+* strided views, duals) keep their Execute(), and so does the whole plan if
+* the system compiler is missing. Kernels are looked up in the PlanCache by
+* graph key before any code is generated. POSIX only
+*/
+struct JitPlan : public Plan {
+	std::vector<JitLibrary::Function> _kernels;
+	std::vector<std::vector<AbstractTensor *> > _arguments;
+	std::vector<void *> _args;
+	std::string _source;
+
+	template<typename Root>
+	XMATRIX_INLINE JitPlan(Root &root) : Plan(root) {
+		Specialize();
+	}
+
+	XMATRIX_INLINE void Specialize() {
+		JitLayout layout;
+		if (!PlanCache<JitLayout>::Find(_graphKey, layout)) {
+			Generate(layout);
+			PlanCache<JitLayout>::Insert(_graphKey, layout);
+		}
+		Nodes(layout._fused, _fused);
+		Nodes(layout._instructions, _instructions);
+		Release();
+		Allocate(layout);
+		_kernels = layout._kernels;
+		_arguments.resize(layout._arguments.size());
+		for (size_t i = 0; i < layout._arguments.size(); i++)
+			Nodes(layout._arguments[i], _arguments[i]);
+		_source = layout._source;
+	}
+
+	/**
+	* Generates the kernels of the compiled plan. Instructions are visited
+	* consumers first, so each kernel takes all the inlinable nodes below it
+	* and an instruction left without a kernel gives its own inputs a chance
+	*/
+	XMATRIX_INLINE void Generate(JitLayout &layout) const {
+		std::unordered_map<AbstractTensor *, size_t> position;
+		for (size_t i = 0; i < _order.size(); i++)
+			position[_order[i]] = i;
+		std::unordered_map<AbstractTensor *, bool> candidates;
+		for (size_t i = 0; i < _order.size(); i++) {
+			AbstractTensor *node = _order[i];
+			if (node != _root && node->IsElementwise() && node->_consumers.size() == 1 && position.count(node->_consumers[0]))
+				candidates[node] = true;
+		}
+
+		std::vector<std::string> bodies(_instructions.size());
+		std::vector<std::vector<size_t> > arguments(_instructions.size());
+		std::unordered_map<AbstractTensor *, bool> absorbed;
+		std::ostringstream source;
+		source << "#include <cmath>\n#include <cstddef>\nusing namespace std;\n";
+		size_t count = 0;
+		for (size_t i = _instructions.size(); i-- > 0; ) {
+			AbstractTensor *node = _instructions[i];
+			if (absorbed.count(node))
+				continue;
+
+			JitSource code;
+			std::vector<AbstractTensor *> stack(1, node);
+			while (!stack.empty()) {
+				AbstractTensor *top = stack.back();
+				stack.pop_back();
+				for (size_t j = 0; j < top->_inputs.size(); j++) {
+					if (candidates.count(top->_inputs[j]) && !code._inlined.count(top->_inputs[j])) {
+						code._inlined[top->_inputs[j]] = true;
+						stack.push_back(top->_inputs[j]);
+					}
+				}
+			}
+			if (!node->EmitKernel(code, bodies[i]))
+				continue;
+
+			for (std::unordered_map<AbstractTensor *, bool>::const_iterator it = code._inlined.begin(); it != code._inlined.end(); ++it)
+				absorbed[it->first] = true;
+			for (size_t j = 0; j < code._arguments.size(); j++)
+				arguments[i].push_back(position[code._arguments[j]]);
+			source << "\nextern \"C\" void xmatrix_jit_" << i << "(void *const *args) {\n"
+				<< code._declarations << bodies[i] << "}\n";
+			count++;
+		}
+
+		for (size_t i = 0; i < _fused.size(); i++)
+			layout._fused.push_back(position[_fused[i]]);
+		layout._source = source.str();
+		void *library = (count > 0)? JitLibrary::Load(layout._source) : NULL;
+		for (size_t i = 0; i < _instructions.size(); i++) {
+			if (library != NULL && absorbed.count(_instructions[i])) {
+				layout._fused.push_back(position[_instructions[i]]);
+				continue;
+			}
+			JitLibrary::Function kernel = NULL;
+			if (library != NULL && !bodies[i].empty()) {
+				std::ostringstream name;
+				name << "xmatrix_jit_" << i;
+				kernel = (JitLibrary::Function)dlsym(library, name.str().c_str());
+			}
+			layout._instructions.push_back(position[_instructions[i]]);
+			layout._kernels.push_back(kernel);
+			layout._arguments.push_back((kernel != NULL)? arguments[i] : std::vector<size_t>());
+		}
+		PlanMemory(layout);
+	}
+
+	XMATRIX_INLINE void Run() {
+		LeafShapes(_key);
+		if (_key != _shapes) {
+			Compile();
+			Specialize();
+			return;
+		}
+
+		for (size_t i = 0; i < _leaves.size(); i++)
+			_leaves[i]->_isUpdated = true;
+		for (size_t i = 0; i < _fused.size(); i++)
+			_fused[i]->_isUpdated = false;
+		for (size_t i = 0; i < _instructions.size(); i++) {
+			if (_kernels[i] != NULL) {
+				const std::vector<AbstractTensor *> &arguments = _arguments[i];
+				_args.resize(arguments.size());
+				for (size_t j = 0; j < arguments.size(); j++)
+					_args[j] = arguments[j]->Buffer();
+				_kernels[i](&_args[0]);
+			} else {
+				_instructions[i]->Execute();
+			}
+			_instructions[i]->_isUpdated = true;
+		}
+		for (size_t i = 0; i < _bound.size(); i++)
+			_bound[i]->_isUpdated = false;
+	}
+};
+
+} // namespace xmatrix
+
+#endif // XMATRIX_JIT_H_
@@ -0,0 +1,973 @@
+#ifndef XMATRIX_MATH_CPU_H_
+#define XMATRIX_MATH_CPU_H_
+
+#include "common.h"
+#include "dual.h"
+
+#include <float.h>
+
+#if defined(__AVX512F__) || (defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER)))
+#include <immintrin.h>
+#define XMATRIX_SIMD_MATH 1
+#else
+#define XMATRIX_SIMD_MATH 0
+#endif
+
+namespace xmatrix {
+
+/**
+* Vector Math: exp, log, log10, sqrt, pow and the normal distribution over
+* arrays of elements, the kernels of the elementwise math tensors. The
+* generic version calls libm element by element (integers, duals, and every
+* type without AVX2 or AVX-512); float and double are computed a register
+* of elements at a time. Arguments outside the range of the vector code
+* (non-positive logs, results overflowing or subnormal, NaNs and infinities)
+* send their register to libm, so special values behave as in libm.
+* The fast mode trades accuracy for shorter polynomials. Errors, measured
+* against a higher precision reference:
+*
+*             double           double fast    float        float fast
+*   exp       < 1 ulp          < 1e-8 rel     < 1.1 ulp    < 4e-6 rel
+*   log       < 1 ulp          < 3e-9 rel     < 1 ulp      < 4e-6 rel
+*   log10     < 1 ulp          < 3e-9 rel     < 2 ulp      < 4e-6 rel
+*   sqrt      correctly rounded in all modes
+*   pow       < 1.2 + |e| / 8 ulp             < 1 ulp (computed in double)
+*             fast: < 6e-9 (1 + |e ln x|) relative in double,
+*             < 3e-6 (1 + |e ln x|) in float
+*   x^1 and x^2 are exact or correctly rounded in all modes
+*
+* The normal distribution and error functions follow the rational
+* approximations of fdlibm (erf, erfc) and of Wichura's AS241 (inverse
+* normal), with the argument of the normal CDF scaled in two parts so that
+* its tails keep their relative accuracy:
+*
+*             double                      double fast
+*   erf       < 1 ulp                     < 1e-9 rel
+*   erfc      < 3 ulp                     < 1e-8 rel
+*   normcdf   < 4 ulp                     < 1e-8 rel
+*   normpdf   < 2.5 ulp                   < 1e-8 rel
+*   norminv   < 8e-16 (1 + |x|) absolute  < 1e-9 (1 + |x|)
+*
+* float has no vector version of them
+*/
+template<typename DType>
+struct ScalarMath;
+
+/**
+* Inverse Normal: the x with Phi(x) = p, by AS241
+*/
+XMATRIX_INLINE double InverseNormal(double p) {
+	if (!(p > 0 && p < 1))
+		return (p == 0)? -HUGE_VAL : (p == 1)? HUGE_VAL : NAN;
+
+	double q = p - 0.5;
+	if (fabs(q) <= 0.425) {
+		double r = 0.180625 - q * q;
+		return q * (((((((2.5090809287301226727e+3 * r + 3.3430575583588128105e+4) * r + 6.7265770927008700853e+4) * r 
+			+ 4.5921953931549871457e+4) * r + 1.3731693765509461125e+4) * r + 1.9715909503065514427e+3) * r 
+			+ 1.3314166789178437745e+2) * r + 3.3871328727963666080e0) 
+			/ (((((((5.2264952788528545610e+3 * r + 2.8729085735721942674e+4) * r + 3.9307895800092710610e+4) * r 
+			+ 2.1213794301586595867e+4) * r + 5.3941960214247511077e+3) * r + 6.8718700749205790830e+2) * r 
+			+ 4.2313330701600911252e+1) * r + 1);
+	}
+
+	double r = sqrt(-log((q < 0)? p : 1 - p));
+	double x;
+	if (r <= 5) {
+		r -= 1.6;
+		x = (((((((7.74545014278341407640e-4 * r + 2.27238449892691845833e-2) * r + 2.41780725177450611770e-1) * r 
+			+ 1.27045825245236838258e0) * r + 3.64784832476320460504e0) * r + 5.76949722146069140550e0) * r 
+			+ 4.63033784615654529590e0) * r + 1.42343711074968357734e0) 
+			/ (((((((1.05075007164441684324e-9 * r + 5.47593808499534494600e-4) * r + 1.51986665636164571966e-2) * r 
+			+ 1.48103976427480074590e-1) * r + 6.89767334985100004550e-1) * r + 1.67638483018380384940e0) * r 
+			+ 2.05319162663775882187e0) * r + 1);
+	} else {
+		r -= 5;
+		x = (((((((2.01033439929228813265e-7 * r + 2.71155556874348757815e-5) * r + 1.24266094738807843860e-3) * r 
+			+ 2.65321895265761230930e-2) * r + 2.96560571828504891230e-1) * r + 1.78482653991729133580e0) * r 
+			+ 5.46378491116411436990e0) * r + 6.65790464350110377720e0) 
+			/ (((((((2.04426310338993978564e-15 * r + 1.42151175831644588870e-7) * r + 1.84631831751005468180e-5) * r 
+			+ 7.86869131145613259100e-4) * r + 1.48753612908506148525e-2) * r + 1.36929880922735805310e-1) * r 
+			+ 5.99832206555887937690e-1) * r + 1);
+	}
+	return (q < 0)? -x : x;
+}
+
+/**
+* The derivative of a dual is 1 / phi(x) = sqrt(2 pi) e^(x^2 / 2)
+*/
+template<typename T, size_t N>
+XMATRIX_INLINE Dual<T, N> InverseNormal(const Dual<T, N> &p) {
+	T x = (T)InverseNormal((double)p._value);
+	return Dual<T, N>::Chain(p, x, (T)(2.5066282746310007 * exp(0.5 * (double)x * x)));
+}
+
+template<typename DType>
+struct ScalarMath {
+	XMATRIX_INLINE static void Exp(const DType *src, DType *dest, size_t length, bool /*fast*/) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = exp(src[i]);
+	}
+
+	XMATRIX_INLINE static void Log(const DType *src, DType *dest, size_t length, bool /*fast*/) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = log(src[i]);
+	}
+
+	XMATRIX_INLINE static void Log10(const DType *src, DType *dest, size_t length, bool /*fast*/) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = log10(src[i]);
+	}
+
+	XMATRIX_INLINE static void Sqrt(const DType *src, DType *dest, size_t length, bool /*fast*/) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = sqrt(src[i]);
+	}
+
+	XMATRIX_INLINE static void Pow(const DType *src, double exp, DType *dest, size_t length, bool /*fast*/) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = pow(src[i], exp);
+	}
+
+	XMATRIX_INLINE static void Erf(const DType *src, DType *dest, size_t length, bool /*fast*/) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = erf(src[i]);
+	}
+
+	XMATRIX_INLINE static void Erfc(const DType *src, DType *dest, size_t length, bool /*fast*/) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = erfc(src[i]);
+	}
+
+	XMATRIX_INLINE static void NormCdf(const DType *src, DType *dest, size_t length, bool /*fast*/) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = 0.5 * erfc(src[i] * -0.70710678118654752);
+	}
+
+	XMATRIX_INLINE static void NormPdf(const DType *src, DType *dest, size_t length, bool /*fast*/) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = 0.3989422804014327 * exp(src[i] * src[i] * -0.5);
+	}
+
+	XMATRIX_INLINE static void NormInv(const DType *src, DType *dest, size_t length, bool fast) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = InverseNormal(src[i]);
+	}
+};
+
+template<typename DType>
+struct VectorMath : public ScalarMath<DType> {};
+
+/**
+* Elements of src converted to the element type of dest, in dest, or src
+* itself if it has that type already
+*/
+template<typename DType>
+XMATRIX_INLINE const DType *Promote(const DType *src, DType *dest, size_t length) {
+	return src;
+}
+
+template<typename DType_src, typename DType_dest>
+XMATRIX_INLINE const DType_dest *Promote(const DType_src *src, DType_dest *dest, size_t length) {
+	for (size_t i = 0; i < length; i++)
+		dest[i] = (DType_dest)src[i];
+	return dest;
+}
+
+#if XMATRIX_SIMD_MATH
+
+/**
+* SIMD Pack: one register of elements and the operations the vector math
+* is written with. Exponent() and Mantissa() split a positive normal x into
+* 2^Exponent(x) * Mantissa(x) with the mantissa in [1, 2); Pow2(t) is 2^n for
+* t = n + kShifter, n an integer within the normal exponents
+*/
+template<typename DType>
+struct SimdPack;
+
+#if defined(__AVX512F__)
+template<>
+struct SimdPack<double> {
+	typedef __m512d type;
+	typedef __mmask8 mask;
+	static const size_t kWidth = 8;
+
+	XMATRIX_INLINE static type Load(const double *p) { return _mm512_loadu_pd(p); }
+	XMATRIX_INLINE static void Store(double *p, type a) { _mm512_storeu_pd(p, a); }
+	XMATRIX_INLINE static type Set(double a) { return _mm512_set1_pd(a); }
+	XMATRIX_INLINE static type Add(type a, type b) { return _mm512_add_pd(a, b); }
+	XMATRIX_INLINE static type Sub(type a, type b) { return _mm512_sub_pd(a, b); }
+	XMATRIX_INLINE static type Mul(type a, type b) { return _mm512_mul_pd(a, b); }
+	XMATRIX_INLINE static type Div(type a, type b) { return _mm512_div_pd(a, b); }
+	XMATRIX_INLINE static type Fma(type a, type b, type c) { return _mm512_fmadd_pd(a, b, c); }
+	XMATRIX_INLINE static type Sqrt(type a) { return _mm512_sqrt_pd(a); }
+	XMATRIX_INLINE static mask Greater(type a, type b) { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+	XMATRIX_INLINE static type Select(mask m, type a, type b) { return _mm512_mask_blend_pd(m, b, a); }
+	XMATRIX_INLINE static type Abs(type a) { return _mm512_abs_pd(a); }
+	XMATRIX_INLINE static bool Any(mask m) { return m != 0; }
+	XMATRIX_INLINE static bool All(mask m) { return m == 0xFF; }
+
+	XMATRIX_INLINE static type CopySign(type a, type b) {
+		__m512i sign = _mm512_and_si512(_mm512_castpd_si512(b), _mm512_set1_epi64(0x8000000000000000LL));
+		return _mm512_castsi512_pd(_mm512_or_si512(_mm512_castpd_si512(Abs(a)), sign));
+	}
+
+	XMATRIX_INLINE static bool InRange(type a, double lower, double upper) {
+		return (_mm512_cmp_pd_mask(a, Set(lower), _CMP_GE_OQ) & _mm512_cmp_pd_mask(a, Set(upper), _CMP_LE_OQ)) == 0xFF;
+	}
+
+	XMATRIX_INLINE static type Pow2(type t) {
+		__m512i bits = _mm512_add_epi64(_mm512_castpd_si512(t), _mm512_set1_epi64(1023));
+		return _mm512_castsi512_pd(_mm512_slli_epi64(bits, 52));
+	}
+
+	XMATRIX_INLINE static type Exponent(type x) {
+		__m512i bits = _mm512_or_si512(_mm512_srli_epi64(_mm512_castpd_si512(x), 52), _mm512_set1_epi64(0x4330000000000000LL));
+		return Sub(_mm512_castsi512_pd(bits), Set(4503599627370496.0 + 1023));
+	}
+
+	XMATRIX_INLINE static type Mantissa(type x) {
+		__m512i bits = _mm512_and_si512(_mm512_castpd_si512(x), _mm512_set1_epi64(0x000FFFFFFFFFFFFFLL));
+		return _mm512_castsi512_pd(_mm512_or_si512(bits, _mm512_set1_epi64(0x3FF0000000000000LL)));
+	}
+};
+
+template<>
+struct SimdPack<float> {
+	typedef __m512 type;
+	typedef __mmask16 mask;
+	static const size_t kWidth = 16;
+
+	XMATRIX_INLINE static type Load(const float *p) { return _mm512_loadu_ps(p); }
+	XMATRIX_INLINE static void Store(float *p, type a) { _mm512_storeu_ps(p, a); }
+	XMATRIX_INLINE static type Set(float a) { return _mm512_set1_ps(a); }
+	XMATRIX_INLINE static type Add(type a, type b) { return _mm512_add_ps(a, b); }
+	XMATRIX_INLINE static type Sub(type a, type b) { return _mm512_sub_ps(a, b); }
+	XMATRIX_INLINE static type Mul(type a, type b) { return _mm512_mul_ps(a, b); }
+	XMATRIX_INLINE static type Div(type a, type b) { return _mm512_div_ps(a, b); }
+	XMATRIX_INLINE static type Fma(type a, type b, type c) { return _mm512_fmadd_ps(a, b, c); }
+	XMATRIX_INLINE static type Sqrt(type a) { return _mm512_sqrt_ps(a); }
+	XMATRIX_INLINE static mask Greater(type a, type b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+	XMATRIX_INLINE static type Select(mask m, type a, type b) { return _mm512_mask_blend_ps(m, b, a); }
+
+	XMATRIX_INLINE static bool InRange(type a, float lower, float upper) {
+		return (_mm512_cmp_ps_mask(a, Set(lower), _CMP_GE_OQ) & _mm512_cmp_ps_mask(a, Set(upper), _CMP_LE_OQ)) == 0xFFFF;
+	}
+
+	XMATRIX_INLINE static type Pow2(type t) {
+		__m512i bits = _mm512_add_epi32(_mm512_castps_si512(t), _mm512_set1_epi32(127));
+		return _mm512_castsi512_ps(_mm512_slli_epi32(bits, 23));
+	}
+
+	XMATRIX_INLINE static type Exponent(type x) {
+		__m512i bits = _mm512_or_si512(_mm512_srli_epi32(_mm512_castps_si512(x), 23), _mm512_set1_epi32(0x4B000000));
+		return Sub(_mm512_castsi512_ps(bits), Set(8388608.0f + 127));
+	}
+
+	XMATRIX_INLINE static type Mantissa(type x) {
+		__m512i bits = _mm512_and_si512(_mm512_castps_si512(x), _mm512_set1_epi32(0x007FFFFF));
+		return _mm512_castsi512_ps(_mm512_or_si512(bits, _mm512_set1_epi32(0x3F800000)));
+	}
+};
+#else
+template<>
+struct SimdPack<double> {
+	typedef __m256d type;
+	typedef __m256d mask;
+	static const size_t kWidth = 4;
+
+	XMATRIX_INLINE static type Load(const double *p) { return _mm256_loadu_pd(p); }
+	XMATRIX_INLINE static void Store(double *p, type a) { _mm256_storeu_pd(p, a); }
+	XMATRIX_INLINE static type Set(double a) { return _mm256_set1_pd(a); }
+	XMATRIX_INLINE static type Add(type a, type b) { return _mm256_add_pd(a, b); }
+	XMATRIX_INLINE static type Sub(type a, type b) { return _mm256_sub_pd(a, b); }
+	XMATRIX_INLINE static type Mul(type a, type b) { return _mm256_mul_pd(a, b); }
+	XMATRIX_INLINE static type Div(type a, type b) { return _mm256_div_pd(a, b); }
+	XMATRIX_INLINE static type Fma(type a, type b, type c) { return _mm256_fmadd_pd(a, b, c); }
+	XMATRIX_INLINE static type Sqrt(type a) { return _mm256_sqrt_pd(a); }
+	XMATRIX_INLINE static mask Greater(type a, type b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+	XMATRIX_INLINE static type Select(mask m, type a, type b) { return _mm256_blendv_pd(b, a, m); }
+	XMATRIX_INLINE static type Abs(type a) { return _mm256_andnot_pd(Set(-0.0), a); }
+	XMATRIX_INLINE static bool Any(mask m) { return _mm256_movemask_pd(m) != 0; }
+	XMATRIX_INLINE static bool All(mask m) { return _mm256_movemask_pd(m) == 0xF; }
+	XMATRIX_INLINE static type CopySign(type a, type b) { return _mm256_or_pd(Abs(a), _mm256_and_pd(Set(-0.0), b)); }
+
+	XMATRIX_INLINE static bool InRange(type a, double lower, double upper) {
+		mask m = _mm256_and_pd(_mm256_cmp_pd(a, Set(lower), _CMP_GE_OQ), _mm256_cmp_pd(a, Set(upper), _CMP_LE_OQ));
+		return _mm256_movemask_pd(m) == 0xF;
+	}
+
+	XMATRIX_INLINE static type Pow2(type t) {
+		__m256i bits = _mm256_add_epi64(_mm256_castpd_si256(t), _mm256_set1_epi64x(1023));
+		return _mm256_castsi256_pd(_mm256_slli_epi64(bits, 52));
+	}
+
+	XMATRIX_INLINE static type Exponent(type x) {
+		__m256i bits = _mm256_or_si256(_mm256_srli_epi64(_mm256_castpd_si256(x), 52), _mm256_set1_epi64x(0x4330000000000000LL));
+		return Sub(_mm256_castsi256_pd(bits), Set(4503599627370496.0 + 1023));
+	}
+
+	XMATRIX_INLINE static type Mantissa(type x) {
+		__m256i bits = _mm256_and_si256(_mm256_castpd_si256(x), _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL));
+		return _mm256_castsi256_pd(_mm256_or_si256(bits, _mm256_set1_epi64x(0x3FF0000000000000LL)));
+	}
+};
+
+template<>
+struct SimdPack<float> {
+	typedef __m256 type;
+	typedef __m256 mask;
+	static const size_t kWidth = 8;
+
+	XMATRIX_INLINE static type Load(const float *p) { return _mm256_loadu_ps(p); }
+	XMATRIX_INLINE static void Store(float *p, type a) { _mm256_storeu_ps(p, a); }
+	XMATRIX_INLINE static type Set(float a) { return _mm256_set1_ps(a); }
+	XMATRIX_INLINE static type Add(type a, type b) { return _mm256_add_ps(a, b); }
+	XMATRIX_INLINE static type Sub(type a, type b) { return _mm256_sub_ps(a, b); }
+	XMATRIX_INLINE static type Mul(type a, type b) { return _mm256_mul_ps(a, b); }
+	XMATRIX_INLINE static type Div(type a, type b) { return _mm256_div_ps(a, b); }
+	XMATRIX_INLINE static type Fma(type a, type b, type c) { return _mm256_fmadd_ps(a, b, c); }
+	XMATRIX_INLINE static type Sqrt(type a) { return _mm256_sqrt_ps(a); }
+	XMATRIX_INLINE static mask Greater(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	XMATRIX_INLINE static type Select(mask m, type a, type b) { return _mm256_blendv_ps(b, a, m); }
+
+	XMATRIX_INLINE static bool InRange(type a, float lower, float upper) {
+		mask m = _mm256_and_ps(_mm256_cmp_ps(a, Set(lower), _CMP_GE_OQ), _mm256_cmp_ps(a, Set(upper), _CMP_LE_OQ));
+		return _mm256_movemask_ps(m) == 0xFF;
+	}
+
+	XMATRIX_INLINE static type Pow2(type t) {
+		__m256i bits = _mm256_add_epi32(_mm256_castps_si256(t), _mm256_set1_epi32(127));
+		return _mm256_castsi256_ps(_mm256_slli_epi32(bits, 23));
+	}
+
+	XMATRIX_INLINE static type Exponent(type x) {
+		__m256i bits = _mm256_or_si256(_mm256_srli_epi32(_mm256_castps_si256(x), 23), _mm256_set1_epi32(0x4B000000));
+		return Sub(_mm256_castsi256_ps(bits), Set(8388608.0f + 127));
+	}
+
+	XMATRIX_INLINE static type Mantissa(type x) {
+		__m256i bits = _mm256_and_si256(_mm256_castps_si256(x), _mm256_set1_epi32(0x007FFFFF));
+		return _mm256_castsi256_ps(_mm256_or_si256(bits, _mm256_set1_epi32(0x3F800000)));
+	}
+};
+#endif
+
+/**
+* Applies function to every register of src, the last one padded with an
+* argument in the range of the function
+*/
+template<typename DType, typename Function>
+XMATRIX_INLINE void SimdMap(const DType *src, DType *dest, size_t length, Function function, DType padding = 1) {
+	const size_t width = SimdPack<DType>::kWidth;
+	size_t i = 0;
+	for (; i + width <= length; i += width)
+		function(src + i, dest + i);
+	if (i < length) {
+		DType in[width], out[width];
+		for (size_t j = 0; j < width; j++)
+			in[j] = (i + j < length)? src[i + j] : padding;
+		function(in, out);
+		for (size_t j = 0; i + j < length; j++)
+			dest[i + j] = out[j];
+	}
+}
+
+template<>
+struct VectorMath<double> : public ScalarMath<double> {
+	typedef SimdPack<double> P;
+	typedef P::type V;
+
+	/**
+	* e^(x + xLow): x + xLow = n ln2 + r with |r| <= ln2 / 2, ln2 split in two
+	* so that n ln2High is exact, and a Taylor polynomial of e^r. xLow is
+	* ignored in the fast mode
+	*/
+	XMATRIX_INLINE static V ExpCore(V x, V xLow, bool fast) {
+		const double shifter = 6755399441055744.0; // 1.5 * 2^52
+		V t = P::Fma(fast? x : P::Add(x, xLow), P::Set(1.4426950408889634), P::Set(shifter));
+		V n = P::Sub(t, P::Set(shifter));
+		V r, q;
+		if (fast) {
+			r = P::Fma(n, P::Set(-0.6931471805599453), x);
+			q = P::Fma(P::Set(1.0 / 5040), r, P::Set(1.0 / 720));
+			q = P::Fma(q, r, P::Set(1.0 / 120));
+			q = P::Fma(q, r, P::Set(1.0 / 24));
+		} else {
+			r = P::Fma(n, P::Set(-6.93147180369123816490e-01), x);
+			r = P::Fma(n, P::Set(-1.90821492927058770002e-10), r);
+			r = P::Add(r, xLow);
+			q = P::Fma(P::Set(1.0 / 6227020800.0), r, P::Set(1.0 / 479001600.0));
+			q = P::Fma(q, r, P::Set(1.0 / 39916800.0));
+			q = P::Fma(q, r, P::Set(1.0 / 3628800.0));
+			q = P::Fma(q, r, P::Set(1.0 / 362880.0));
+			q = P::Fma(q, r, P::Set(1.0 / 40320.0));
+			q = P::Fma(q, r, P::Set(1.0 / 5040.0));
+			q = P::Fma(q, r, P::Set(1.0 / 720.0));
+			q = P::Fma(q, r, P::Set(1.0 / 120.0));
+			q = P::Fma(q, r, P::Set(1.0 / 24.0));
+		}
+		q = P::Fma(q, r, P::Set(1.0 / 6));
+		q = P::Fma(q, r, P::Set(0.5));
+		V p = P::Add(P::Set(1), P::Fma(P::Mul(r, r), q, r));
+		return P::Mul(p, P::Pow2(t));
+	}
+
+	/**
+	* ln x as high + low, x = 2^k m with m in [sqrt(2) / 2, sqrt(2)) and
+	* ln m = f - f^2 / 2 + s (f^2 / 2 + R(s^2)), f = m - 1 and s = f / (2 + f).
+	* The sums are carried with their rounding errors
+	*/
+	XMATRIX_INLINE static void LogCore(V x, V &high, V &low) {
+		V m = P::Mantissa(x);
+		V k = P::Exponent(x);
+		typename P::mask above = P::Greater(m, P::Set(1.4142135623730951));
+		m = P::Select(above, P::Mul(m, P::Set(0.5)), m);
+		k = P::Select(above, P::Add(k, P::Set(1)), k);
+
+		V f = P::Sub(m, P::Set(1));
+		V s = P::Div(f, P::Add(P::Set(2), f));
+		V z = P::Mul(s, s);
+		V w = P::Mul(z, z);
+		V odd = P::Fma(w, P::Set(1.479819860511658591e-01), P::Set(1.818357216161805012e-01));
+		odd = P::Fma(w, odd, P::Set(2.857142874366239149e-01));
+		odd = P::Fma(w, odd, P::Set(6.666666666666735130e-01));
+		V even = P::Fma(w, P::Set(1.531383769920937332e-01), P::Set(2.222219843214978396e-01));
+		even = P::Fma(w, even, P::Set(3.999999999940941908e-01));
+		V R = P::Fma(z, odd, P::Mul(w, even));
+
+		V halfF = P::Mul(P::Set(0.5), f);
+		V hfsq = P::Mul(halfF, f);
+		V hfsqError = P::Fma(halfF, f, P::Sub(P::Set(0), hfsq));
+		V t = P::Mul(s, P::Add(hfsq, R));
+		V a = P::Sub(f, hfsq);
+		V aError = P::Sub(P::Sub(f, a), hfsq);
+		V log1p = P::Add(P::Sub(aError, hfsqError), t);
+
+		V kHigh = P::Mul(k, P::Set(6.93147180369123816490e-01));
+		high = P::Add(kHigh, a);
+		V b = P::Sub(high, kHigh);
+		V error = P::Add(P::Sub(kHigh, P::Sub(high, b)), P::Sub(a, b));
+		low = P::Add(P::Add(error, log1p), P::Mul(k, P::Set(1.90821492927058770002e-10)));
+		V sum = P::Add(high, low);
+		low = P::Sub(low, P::Sub(sum, high));
+		high = sum;
+	}
+
+	/**
+	* ln x from an odd series of s in the fast mode
+	*/
+	XMATRIX_INLINE static V LogFast(V x) {
+		V m = P::Mantissa(x);
+		V k = P::Exponent(x);
+		typename P::mask above = P::Greater(m, P::Set(1.4142135623730951));
+		m = P::Select(above, P::Mul(m, P::Set(0.5)), m);
+		k = P::Select(above, P::Add(k, P::Set(1)), k);
+
+		V f = P::Sub(m, P::Set(1));
+		V s = P::Div(f, P::Add(P::Set(2), f));
+		V z = P::Mul(s, s);
+		V q = P::Fma(z, P::Set(2.0 / 9), P::Set(2.0 / 7));
+		q = P::Fma(z, q, P::Set(2.0 / 5));
+		q = P::Fma(z, q, P::Set(2.0 / 3));
+		V log1p = P::Fma(P::Mul(s, z), q, P::Add(s, s));
+		return P::Fma(k, P::Set(0.6931471805599453), log1p);
+	}
+
+	XMATRIX_INLINE static void Exp(const double *src, double *dest, size_t length, bool fast) {
+		SimdMap(src, dest, length, [fast](const double *in, double *out) {
+			V x = P::Load(in);
+			if (!P::InRange(x, -708, 709)) {
+				for (size_t j = 0; j < P::kWidth; j++)
+					out[j] = exp(in[j]);
+				return;
+			}
+			P::Store(out, ExpCore(x, P::Set(0), fast));
+		});
+	}
+
+	XMATRIX_INLINE static void Log(const double *src, double *dest, size_t length, bool fast) {
+		SimdMap(src, dest, length, [fast](const double *in, double *out) {
+			V x = P::Load(in);
+			if (!P::InRange(x, DBL_MIN, DBL_MAX)) {
+				for (size_t j = 0; j < P::kWidth; j++)
+					out[j] = log(in[j]);
+				return;
+			}
+			if (fast) {
+				P::Store(out, LogFast(x));
+				return;
+			}
+			V high, low;
+			LogCore(x, high, low);
+			P::Store(out, P::Add(high, low));
+		});
+	}
+
+	XMATRIX_INLINE static void Log10(const double *src, double *dest, size_t length, bool fast) {
+		SimdMap(src, dest, length, [fast](const double *in, double *out) {
+			V x = P::Load(in);
+			if (!P::InRange(x, DBL_MIN, DBL_MAX)) {
+				for (size_t j = 0; j < P::kWidth; j++)
+					out[j] = log10(in[j]);
+				return;
+			}
+			if (fast) {
+				P::Store(out, P::Mul(LogFast(x), P::Set(0.43429448190325182)));
+				return;
+			}
+			// 1 / ln10 split in two as well
+			V high, low;
+			LogCore(x, high, low);
+			V c = P::Set(0.43429448190325182);
+			V lower = P::Fma(high, P::Set(1.0983196502167651e-17), P::Mul(low, c));
+			P::Store(out, P::Fma(high, c, lower));
+		});
+	}
+
+	XMATRIX_INLINE static void Sqrt(const double *src, double *dest, size_t length, bool /*fast*/) {
+		SimdMap(src, dest, length, [](const double *in, double *out) {
+			P::Store(out, P::Sqrt(P::Load(in)));
+		});
+	}
+
+	/**
+	* x^e = e^(e ln x), with e ln x carried in two parts in the accurate mode
+	*/
+	XMATRIX_INLINE static void Pow(const double *src, double exp, double *dest, size_t length, bool fast) {
+		if (!(fabs(exp) <= DBL_MAX)) {
+			ScalarMath<double>::Pow(src, exp, dest, length, fast);
+			return;
+		}
+		SimdMap(src, dest, length, [exp, fast](const double *in, double *out) {
+			V x = P::Load(in);
+			if (exp == 1 || exp == 2) {
+				P::Store(out, (exp == 1)? x : P::Mul(x, x));
+				return;
+			}
+			if (P::InRange(x, DBL_MIN, DBL_MAX)) {
+				V y = P::Set(exp);
+				if (fast) {
+					V product = P::Mul(y, LogFast(x));
+					if (P::InRange(product, -708, 709)) {
+						P::Store(out, ExpCore(product, P::Set(0), true));
+						return;
+					}
+				} else {
+					V high, low;
+					LogCore(x, high, low);
+					V product = P::Mul(y, high);
+					V productLow = P::Fma(y, low, P::Fma(y, high, P::Sub(P::Set(0), product)));
+					if (P::InRange(product, -708, 709)) {
+						P::Store(out, ExpCore(product, productLow, false));
+						return;
+					}
+				}
+			}
+			for (size_t j = 0; j < P::kWidth; j++)
+				out[j] = pow(in[j], exp);
+		});
+	}
+
+	/**
+	* num(x) / den(x), coefficients from the highest degree down
+	*/
+	template<size_t n, size_t m>
+	XMATRIX_INLINE static V Rational(V x, const double (&num)[n], const double (&den)[m]) {
+		V p = P::Set(num[0]);
+		for (size_t i = 1; i < n; i++)
+			p = P::Fma(p, x, P::Set(num[i]));
+		V q = P::Set(den[0]);
+		for (size_t i = 1; i < m; i++)
+			q = P::Fma(q, x, P::Set(den[i]));
+		return P::Div(p, q);
+	}
+
+	/**
+	* erfc(a + aLow) = e^(-a^2 - 0.5625 + R(1 / a^2)) / a for 1.25 <= a <= 26.5,
+	* with a^2 carried in two parts
+	*/
+	XMATRIX_INLINE static V ErfcTail(V a, V aLow, bool fast) {
+		static const double ra[] = {-9.81432934416914548592e+00, -8.12874355063065934246e+01, -1.84605092906711035994e+02, 
+			-1.62396669462573470355e+02, -6.23753324503260060396e+01, -1.05586262253232909814e+01, 
+			-6.93858572707181764372e-01, -9.86494403484714822705e-03};
+		static const double sa[] = {-6.04244152148580987438e-02, 6.57024977031928170135e+00, 1.08635005541779435134e+02, 
+			4.29008140027567833386e+02, 6.45387271733267880336e+02, 4.34565877475229228821e+02, 
+			1.37657754143519042600e+02, 1.96512716674392571292e+01, 1};
+		static const double rb[] = {-4.83519191608651397019e+02, -1.02509513161107724954e+03, -6.37566443368389627722e+02, 
+			-1.60636384855821916062e+02, -1.77579549177547519889e+01, -7.99283237680523006574e-01, 
+			-9.86494292470009928597e-03};
+		static const double sb[] = {-2.24409524465858183362e+01, 4.74528541206955367215e+02, 2.55305040643316442583e+03, 
+			3.19985821950859553908e+03, 1.53672958608443695994e+03, 3.25792512996573918826e+02, 
+			3.03380607434824582924e+01, 1};
+
+		V s = P::Div(P::Set(1), P::Mul(a, a));
+		typename P::mask near = P::Greater(P::Set(1 / 0.35), a);
+		V ratio;
+		if (P::All(near))
+			ratio = Rational(s, ra, sa);
+		else if (!P::Any(near))
+			ratio = Rational(s, rb, sb);
+		else
+			ratio = P::Select(near, Rational(s, ra, sa), Rational(s, rb, sb));
+
+		V square = P::Mul(a, a);
+		V squareLow = P::Fma(P::Add(a, a), aLow, P::Fma(a, a, P::Sub(P::Set(0), square)));
+		V high = P::Sub(P::Set(-0.5625), square);
+		V low = P::Add(P::Sub(P::Sub(P::Sub(P::Sub(P::Set(0), square), high), P::Set(0.5625)), squareLow), ratio);
+		V e = fast? ExpCore(P::Add(high, low), P::Set(0), true) : ExpCore(high, low, false);
+		V q = P::Div(e, a);
+		return P::Fma(P::Sub(P::Set(0), q), P::Div(aLow, a), q);
+	}
+
+	/**
+	* erfc(x + xLow) for x <= 26.5, by the intervals of fdlibm: |x| < 0.84375,
+	* |x| < 1.25 and the tail. Only the intervals holding an element of the
+	* register are computed
+	*/
+	XMATRIX_INLINE static V ErfcPair(V x, V xLow, bool fast) {
+		static const double pp[] = {-2.37630166566501626084e-05, -5.77027029648944159157e-03, -2.84817495755985104766e-02, 
+			-3.25042107247001499370e-01, 1.28379167095512558561e-01};
+		static const double qq[] = {-3.96022827877536812320e-06, 1.32494738004321644526e-04, 5.08130628187576562776e-03, 
+			6.50222499887672944485e-02, 3.97917223959155352819e-01, 1};
+		static const double pa[] = {-2.16637559486879084300e-03, 3.54783043256182359371e-02, -1.10894694282396677476e-01, 
+			3.18346619901161753674e-01, -3.72207876035701323847e-01, 4.14856118683748331666e-01, 
+			-2.36211856075265944077e-03};
+		static const double qa[] = {1.19844998467991074170e-02, 1.36370839120290507362e-02, 1.26171219808761642112e-01, 
+			7.18286544141962662868e-02, 5.40397917702171048937e-01, 1.06420880400844228286e-01, 1};
+		const double erx = 8.45062911510467529297e-01;
+
+		V a = P::Abs(x);
+		typename P::mask negative = P::Greater(P::Set(0), x);
+		typename P::mask small = P::Greater(P::Set(0.84375), a);
+		typename P::mask middle = P::Greater(P::Set(1.25), a);
+		V result = P::Set(0);
+		if (!P::All(middle)) {
+			V aLow = P::Select(negative, P::Sub(P::Set(0), xLow), xLow);
+			V clamped = P::Select(P::Greater(a, P::Set(26.5)), P::Set(26.5), a);
+			V tail = ErfcTail(clamped, aLow, fast);
+			result = P::Select(negative, P::Sub(P::Set(2), tail), tail);
+		}
+		if (P::Any(middle) && !P::All(small)) {
+			V s = P::Add(P::Sub(a, P::Set(1)), P::Select(negative, P::Sub(P::Set(0), xLow), xLow));
+			V ratio = Rational(s, pa, qa);
+			V inner = P::Select(negative, P::Add(P::Set(1 + erx), ratio), P::Sub(P::Set(1 - erx), ratio));
+			result = P::Select(middle, inner, result);
+		}
+		if (P::Any(small)) {
+			V y = Rational(P::Mul(x, x), pp, qq);
+			V r = P::Fma(xLow, P::Add(P::Set(1), y), P::Mul(x, y));
+			V near = P::Sub(P::Set(1), P::Add(x, r));
+			V far = P::Sub(P::Set(0.5), P::Add(r, P::Sub(x, P::Set(0.5))));
+			result = P::Select(small, P::Select(P::Greater(P::Set(0.25), x), near, far), result);
+		}
+		return result;
+	}
+
+	XMATRIX_INLINE static void Erf(const double *src, double *dest, size_t length, bool fast) {
+		static const double pp[] = {-2.37630166566501626084e-05, -5.77027029648944159157e-03, -2.84817495755985104766e-02, 
+			-3.25042107247001499370e-01, 1.28379167095512558561e-01};
+		static const double qq[] = {-3.96022827877536812320e-06, 1.32494738004321644526e-04, 5.08130628187576562776e-03, 
+			6.50222499887672944485e-02, 3.97917223959155352819e-01, 1};
+		static const double pa[] = {-2.16637559486879084300e-03, 3.54783043256182359371e-02, -1.10894694282396677476e-01, 
+			3.18346619901161753674e-01, -3.72207876035701323847e-01, 4.14856118683748331666e-01, 
+			-2.36211856075265944077e-03};
+		static const double qa[] = {1.19844998467991074170e-02, 1.36370839120290507362e-02, 1.26171219808761642112e-01, 
+			7.18286544141962662868e-02, 5.40397917702171048937e-01, 1.06420880400844228286e-01, 1};
+		SimdMap(src, dest, length, [fast](const double *in, double *out) {
+			V x = P::Load(in);
+			if (!P::InRange(x, -DBL_MAX, DBL_MAX)) {
+				for (size_t j = 0; j < P::kWidth; j++)
+					out[j] = erf(in[j]);
+				return;
+			}
+			// erf(6) rounds to one
+			V a = P::Abs(x);
+			typename P::mask small = P::Greater(P::Set(0.84375), a);
+			typename P::mask middle = P::Greater(P::Set(1.25), a);
+			V result = P::Set(1);
+			if (!P::All(middle)) {
+				V clamped = P::Select(P::Greater(a, P::Set(6)), P::Set(6), a);
+				result = P::Sub(P::Set(1), ErfcTail(clamped, P::Set(0), fast));
+			}
+			if (P::Any(middle) && !P::All(small))
+				result = P::Select(middle, P::Add(P::Set(8.45062911510467529297e-01), Rational(P::Sub(a, P::Set(1)), pa, qa)), result);
+			if (P::Any(small))
+				result = P::Select(small, P::Fma(a, Rational(P::Mul(a, a), pp, qq), a), result);
+			P::Store(out, P::CopySign(result, x));
+		});
+	}
+
+	XMATRIX_INLINE static void Erfc(const double *src, double *dest, size_t length, bool fast) {
+		SimdMap(src, dest, length, [fast](const double *in, double *out) {
+			V x = P::Load(in);
+			if (!P::InRange(x, -DBL_MAX, 26.5)) {
+				for (size_t j = 0; j < P::kWidth; j++)
+					out[j] = erfc(in[j]);
+				return;
+			}
+			P::Store(out, ErfcPair(x, P::Set(0), fast));
+		});
+	}
+
+	/**
+	* Phi(x) = erfc(-x / sqrt(2)) / 2, -x / sqrt(2) in two parts
+	*/
+	XMATRIX_INLINE static void NormCdf(const double *src, double *dest, size_t length, bool fast) {
+		SimdMap(src, dest, length, [fast](const double *in, double *out) {
+			V x = P::Load(in);
+			if (!P::InRange(x, -37.45, DBL_MAX)) {
+				for (size_t j = 0; j < P::kWidth; j++) {
+					// corrected to first order in tLow, not finite for infinite x
+					double t = in[j] * -0.70710678118654757;
+					double tLow = fma(in[j], -0.70710678118654757, -t) + in[j] * 4.833646656726457e-17;
+					double r = erfc(t);
+					out[j] = 0.5 * ((fabs(t) <= DBL_MAX)? r - tLow * 1.1283791670955126 * exp(-t * t) : r);
+				}
+				return;
+			}
+			V t = P::Mul(x, P::Set(-0.70710678118654757));
+			V tLow = P::Fma(x, P::Set(4.833646656726457e-17), P::Fma(x, P::Set(-0.70710678118654757), P::Sub(P::Set(0), t)));
+			P::Store(out, P::Mul(P::Set(0.5), ErfcPair(t, tLow, fast)));
+		});
+	}
+
+	/**
+	* phi(x) = e^(-x^2 / 2) / sqrt(2 pi), x^2 in two parts
+	*/
+	XMATRIX_INLINE static void NormPdf(const double *src, double *dest, size_t length, bool fast) {
+		SimdMap(src, dest, length, [fast](const double *in, double *out) {
+			V x = P::Load(in);
+			if (!P::InRange(x, -37.5, 37.5)) {
+				for (size_t j = 0; j < P::kWidth; j++) {
+					double half = in[j] * -0.5;
+					double square = half * in[j];
+					double r = 0.3989422804014327 * exp(square);
+					out[j] = (fabs(in[j]) <= DBL_MAX)? r + r * fma(half, in[j], -square) : r;
+				}
+				return;
+			}
+			V half = P::Mul(x, P::Set(-0.5));
+			V square = P::Mul(half, x);
+			V squareLow = fast? P::Set(0) : P::Fma(half, x, P::Sub(P::Set(0), square));
+			P::Store(out, P::Mul(P::Set(0.3989422804014327), ExpCore(square, squareLow, fast)));
+		});
+	}
+
+	/**
+	* Phi^-1(p) by AS241: a rational function of p around 1/2, of
+	* sqrt(-ln min(p, 1 - p)) in the tails
+	*/
+	XMATRIX_INLINE static void NormInv(const double *src, double *dest, size_t length, bool fast) {
+		static const double a[] = {2.5090809287301226727e+3, 3.3430575583588128105e+4, 6.7265770927008700853e+4, 
+			4.5921953931549871457e+4, 1.3731693765509461125e+4, 1.9715909503065514427e+3, 
+			1.3314166789178437745e+2, 3.3871328727963666080e0};
+		static const double b[] = {5.2264952788528545610e+3, 2.8729085735721942674e+4, 3.9307895800092710610e+4, 
+			2.1213794301586595867e+4, 5.3941960214247511077e+3, 6.8718700749205790830e+2, 
+			4.2313330701600911252e+1, 1};
+		static const double c[] = {7.74545014278341407640e-4, 2.27238449892691845833e-2, 2.41780725177450611770e-1, 
+			1.27045825245236838258e0, 3.64784832476320460504e0, 5.76949722146069140550e0, 
+			4.63033784615654529590e0, 1.42343711074968357734e0};
+		static const double d[] = {1.05075007164441684324e-9, 5.47593808499534494600e-4, 1.51986665636164571966e-2, 
+			1.48103976427480074590e-1, 6.89767334985100004550e-1, 1.67638483018380384940e0, 
+			2.05319162663775882187e0, 1};
+		static const double e[] = {2.01033439929228813265e-7, 2.71155556874348757815e-5, 1.24266094738807843860e-3, 
+			2.65321895265761230930e-2, 2.96560571828504891230e-1, 1.78482653991729133580e0, 
+			5.46378491116411436990e0, 6.65790464350110377720e0};
+		static const double f[] = {2.04426310338993978564e-15, 1.42151175831644588870e-7, 1.84631831751005468180e-5, 
+			7.86869131145613259100e-4, 1.48753612908506148525e-2, 1.36929880922735805310e-1, 
+			5.99832206555887937690e-1, 1};
+		SimdMap(src, dest, length, [fast](const double *in, double *out) {
+			V p = P::Load(in);
+			if (!P::InRange(p, DBL_MIN, 1 - DBL_EPSILON / 2)) {
+				for (size_t j = 0; j < P::kWidth; j++)
+					out[j] = InverseNormal(in[j]);
+				return;
+			}
+			V q = P::Sub(p, P::Set(0.5));
+			typename P::mask tails = P::Greater(P::Abs(q), P::Set(0.425));
+			V result = P::Set(0);
+			if (!P::All(tails)) {
+				V r = P::Sub(P::Set(0.180625), P::Mul(q, q));
+				result = P::Mul(q, Rational(r, a, b));
+			}
+			if (P::Any(tails)) {
+				V r = P::Select(P::Greater(q, P::Set(0)), P::Sub(P::Set(1), p), p);
+				V ln;
+				if (fast) {
+					ln = LogFast(r);
+				} else {
+					V high, low;
+					LogCore(r, high, low);
+					ln = P::Add(high, low);
+				}
+				r = P::Sqrt(P::Sub(P::Set(0), ln));
+				typename P::mask far = P::Greater(r, P::Set(5));
+				V x;
+				if (!P::Any(far))
+					x = Rational(P::Sub(r, P::Set(1.6)), c, d);
+				else if (P::All(far))
+					x = Rational(P::Sub(r, P::Set(5)), e, f);
+				else
+					x = P::Select(far, Rational(P::Sub(r, P::Set(5)), e, f), Rational(P::Sub(r, P::Set(1.6)), c, d));
+				x = P::Select(P::Greater(P::Set(0), q), P::Sub(P::Set(0), x), x);
+				result = P::Select(tails, x, result);
+			}
+			P::Store(out, result);
+		}, 0.5);
+	}
+};
+
+template<>
+struct VectorMath<float> : public ScalarMath<float> {
+	typedef SimdPack<float> P;
+	typedef P::type V;
+
+	/**
+	* e^x: x = n ln2 + r with |r| <= ln2 / 2 and a polynomial of e^r, the
+	* minimax one of Cephes in the accurate mode
+	*/
+	XMATRIX_INLINE static V ExpCore(V x, bool fast) {
+		const float shifter = 12582912.0f; // 1.5 * 2^23
+		V t = P::Fma(x, P::Set(1.44269504f), P::Set(shifter));
+		V n = P::Sub(t, P::Set(shifter));
+		V r, q;
+		if (fast) {
+			r = P::Fma(n, P::Set(-0.693147181f), x);
+			q = P::Fma(P::Set(1.0f / 120), r, P::Set(1.0f / 24));
+			q = P::Fma(q, r, P::Set(1.0f / 6));
+			q = P::Fma(q, r, P::Set(0.5f));
+		} else {
+			r = P::Fma(n, P::Set(-0.693359375f), x);
+			r = P::Fma(n, P::Set(2.12194440e-4f), r);
+			q = P::Fma(P::Set(1.9875691500e-4f), r, P::Set(1.3981999507e-3f));
+			q = P::Fma(q, r, P::Set(8.3334519073e-3f));
+			q = P::Fma(q, r, P::Set(4.1665795894e-2f));
+			q = P::Fma(q, r, P::Set(1.6666665459e-1f));
+			q = P::Fma(q, r, P::Set(5.0000001201e-1f));
+		}
+		V p = P::Add(P::Set(1), P::Fma(P::Mul(r, r), q, r));
+		return P::Mul(p, P::Pow2(t));
+	}
+
+	/**
+	* ln x, x = 2^k m with m in [sqrt(2) / 2, sqrt(2)): the minimax
+	* polynomial of Cephes in f = m - 1, or an odd series of f / (2 + f) in
+	* the fast mode
+	*/
+	XMATRIX_INLINE static V LogCore(V x, bool fast) {
+		V m = P::Mantissa(x);
+		V k = P::Exponent(x);
+		typename P::mask above = P::Greater(m, P::Set(1.41421356f));
+		m = P::Select(above, P::Mul(m, P::Set(0.5f)), m);
+		k = P::Select(above, P::Add(k, P::Set(1)), k);
+		V f = P::Sub(m, P::Set(1));
+
+		if (fast) {
+			V s = P::Div(f, P::Add(P::Set(2), f));
+			V z = P::Mul(s, s);
+			V q = P::Fma(z, P::Set(2.0f / 5), P::Set(2.0f / 3));
+			V log1p = P::Fma(P::Mul(s, z), q, P::Add(s, s));
+			return P::Fma(k, P::Set(0.693147181f), log1p);
+		}
+
+		V z = P::Mul(f, f);
+		V q = P::Fma(P::Set(7.0376836292e-2f), f, P::Set(-1.1514610310e-1f));
+		q = P::Fma(q, f, P::Set(1.1676998740e-1f));
+		q = P::Fma(q, f, P::Set(-1.2420140846e-1f));
+		q = P::Fma(q, f, P::Set(1.4249322787e-1f));
+		q = P::Fma(q, f, P::Set(-1.6668057665e-1f));
+		q = P::Fma(q, f, P::Set(2.0000714765e-1f));
+		q = P::Fma(q, f, P::Set(-2.4999993993e-1f));
+		q = P::Fma(q, f, P::Set(3.3333331174e-1f));
+		V y = P::Mul(P::Mul(q, f), z);
+		y = P::Fma(k, P::Set(-2.12194440e-4f), y);
+		y = P::Fma(z, P::Set(-0.5f), y);
+		return P::Fma(k, P::Set(0.693359375f), P::Add(f, y));
+	}
+
+	XMATRIX_INLINE static void Exp(const float *src, float *dest, size_t length, bool fast) {
+		SimdMap(src, dest, length, [fast](const float *in, float *out) {
+			V x = P::Load(in);
+			if (!P::InRange(x, -87, 88)) {
+				for (size_t j = 0; j < P::kWidth; j++)
+					out[j] = exp(in[j]);
+				return;
+			}
+			P::Store(out, ExpCore(x, fast));
+		});
+	}
+
+	XMATRIX_INLINE static void Log(const float *src, float *dest, size_t length, bool fast) {
+		SimdMap(src, dest, length, [fast](const float *in, float *out) {
+			V x = P::Load(in);
+			if (!P::InRange(x, FLT_MIN, FLT_MAX)) {
+				for (size_t j = 0; j < P::kWidth; j++)
+					out[j] = log(in[j]);
+				return;
+			}
+			P::Store(out, LogCore(x, fast));
+		});
+	}
+
+	XMATRIX_INLINE static void Log10(const float *src, float *dest, size_t length, bool fast) {
+		SimdMap(src, dest, length, [fast](const float *in, float *out) {
+			V x = P::Load(in);
+			if (!P::InRange(x, FLT_MIN, FLT_MAX)) {
+				for (size_t j = 0; j < P::kWidth; j++)
+					out[j] = log10(in[j]);
+				return;
+			}
+			P::Store(out, P::Mul(LogCore(x, fast), P::Set(0.434294482f)));
+		});
+	}
+
+	XMATRIX_INLINE static void Sqrt(const float *src, float *dest, size_t length, bool /*fast*/) {
+		SimdMap(src, dest, length, [](const float *in, float *out) {
+			P::Store(out, P::Sqrt(P::Load(in)));
+		});
+	}
+
+	/**
+	* x^e in double in the accurate mode, e^(e ln x) in float in the fast one
+	*/
+	XMATRIX_INLINE static void Pow(const float *src, double exp, float *dest, size_t length, bool fast) {
+		if (!fast) {
+			const size_t block = 64;
+			double buffer[block];
+			for (size_t i = 0; i < length; i += block) {
+				size_t count = (length - i < block)? length - i : block;
+				Promote(src + i, buffer, count);
+				VectorMath<double>::Pow(buffer, exp, buffer, count, false);
+				Promote(buffer, dest + i, count);
+			}
+			return;
+		}
+		if (!(fabs(exp) <= DBL_MAX)) {
+			ScalarMath<float>::Pow(src, exp, dest, length, fast);
+			return;
+		}
+		SimdMap(src, dest, length, [exp](const float *in, float *out) {
+			V x = P::Load(in);
+			if (exp == 1 || exp == 2) {
+				P::Store(out, (exp == 1)? x : P::Mul(x, x));
+				return;
+			}
+			if (P::InRange(x, FLT_MIN, FLT_MAX)) {
+				V product = P::Mul(P::Set((float)exp), LogCore(x, true));
+				if (P::InRange(product, -87, 88)) {
+					P::Store(out, ExpCore(product, true));
+					return;
+				}
+			}
+			for (size_t j = 0; j < P::kWidth; j++)
+				out[j] = (float)pow((double)in[j], exp);
+		});
+	}
+};
+
+#endif // XMATRIX_SIMD_MATH
+
+} // namespace xmatrix
+
+#endif // XMATRIX_MATH_CPU_H_
@@ -3,6 +3,9 @@
 
 #include "common.h"
 #include "tensor.h"
+#include "blas-cpu.h"
+#include "math-cpu.h"
+#include "graph.h"
 
 namespace xmatrix {
 
@@ -13,22 +16,32 @@ template<size_t dimension_dest, typename DType_dest,
 	size_t dimension_lhs, typename DType_lhs,
 	size_t dimension_rhs, typename DType_rhs>
 struct AddTensor<cpu, dimension_dest, DType_dest, cpu, dimension_lhs, DType_lhs, cpu, dimension_rhs, DType_rhs> 
-	: public BinaryDeducedTensor<cpu, dimension_dest, DType_dest, cpu, dimension_lhs, DType_lhs, cpu, dimension_rhs, DType_rhs> {
+	: public BinaryElementwiseTensor<cpu, dimension_dest, DType_dest, cpu, dimension_lhs, DType_lhs, cpu, dimension_rhs, DType_rhs> {
 
 	XMATRIX_INLINE AddTensor(
 		Tensor<cpu, dimension_lhs, DType_lhs> &lhs, 
 		Tensor<cpu, dimension_rhs, DType_rhs> &rhs)
-	: BinaryDeducedTensor<cpu, dimension_dest, DType_dest, cpu, dimension_lhs, DType_lhs, cpu, dimension_rhs, DType_rhs>
+	: BinaryElementwiseTensor<cpu, dimension_dest, DType_dest, cpu, dimension_lhs, DType_lhs, cpu, dimension_rhs, DType_rhs>
 		(lhs, rhs) { }
 
-	XMATRIX_INLINE virtual void Update() {
-		if (!_isUpdated) {
-			BinaryDeducedTensor::Update();
-			assert(_lhs._shape == _rhs._shape);
-			AllocMem(_lhs._shape);
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string lhs, rhs;
+		if (!EmitOperands(code, index, lhs, rhs))
+			return false;
+		expr = lhs + " + " + rhs;
+		return true;
+	}
 
-			for (size_t i = 0; i < _shape.getSize(); i++)
-				_ptr[i] = _lhs._ptr[i] + _rhs._ptr[i];
+	XMATRIX_INLINE virtual void Kernel(const DType_lhs *lhs, const DType_rhs *rhs, DType_dest *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = lhs[i] + rhs[i];
+	}
+
+	XMATRIX_INLINE virtual void Adjoint(const DType_lhs *lhs, const DType_rhs *rhs, const DType_dest *dest, 
+		const DType_dest *grad, DType_lhs *gradLhs, DType_rhs *gradRhs, size_t length) {
+		for (size_t i = 0; i < length; i++) {
+			gradLhs[i] += grad[i];
+			gradRhs[i] += grad[i];
 		}
 	}
 };
@@ -38,20 +51,32 @@ struct AddTensor<cpu, dimension_dest, DType_dest, cpu, dimension_lhs, DType_lhs,
 */
 template<size_t dimension, typename DType_dest, typename DType_lhs, typename DType_rhs>
 struct AddTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, 0, DType_rhs> 
-	: public BinaryDeducedTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, 0, DType_rhs> {
+	: public BinaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, 0, DType_rhs> {
 
 	XMATRIX_INLINE AddTensor(
 		Tensor<cpu, dimension, DType_lhs> &lhs, 
 		Tensor<cpu, 0, DType_rhs> &rhs)
-	: BinaryDeducedTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, 0, DType_rhs>
+	: BinaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, 0, DType_rhs>
 		(lhs, rhs) {}
 
-	XMATRIX_INLINE void virtual Update() {
-		if (!_isUpdated) {
-			BinaryDeducedTensor::Update();
-			AllocMem(_lhs._shape);
-			for (size_t i=0; i<_lhs._shape.getSize(); i++)
-				_ptr[i] = _lhs._ptr[i] + _rhs._ptr[0];
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string lhs, rhs;
+		if (!EmitOperands(code, index, lhs, rhs))
+			return false;
+		expr = lhs + " + " + rhs;
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Kernel(const DType_lhs *lhs, const DType_rhs *rhs, DType_dest *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = lhs[i] + rhs[0];
+	}
+
+	XMATRIX_INLINE virtual void Adjoint(const DType_lhs *lhs, const DType_rhs *rhs, const DType_dest *dest, 
+		const DType_dest *grad, DType_lhs *gradLhs, DType_rhs *gradRhs, size_t length) {
+		for (size_t i = 0; i < length; i++) {
+			gradLhs[i] += grad[i];
+			gradRhs[i] += grad[i];
 		}
 	}
 };
@@ -63,22 +88,32 @@ template<size_t dimension_dest, typename DType_dest,
 	size_t dimension_lhs, typename DType_lhs,
 	size_t dimension_rhs, typename DType_rhs>
 struct MinusTensor<cpu, dimension_dest, DType_dest, cpu, dimension_lhs, DType_lhs, cpu, dimension_rhs, DType_rhs> 
-	: public BinaryDeducedTensor<cpu, dimension_dest, DType_dest, cpu, dimension_lhs, DType_lhs, cpu, dimension_rhs, DType_rhs> {
+	: public BinaryElementwiseTensor<cpu, dimension_dest, DType_dest, cpu, dimension_lhs, DType_lhs, cpu, dimension_rhs, DType_rhs> {
 
 	XMATRIX_INLINE MinusTensor(
 		Tensor<cpu, dimension_lhs, DType_lhs> &lhs, 
 		Tensor<cpu, dimension_rhs, DType_rhs> &rhs)
-	: BinaryDeducedTensor<cpu, dimension_dest, DType_dest, cpu, dimension_lhs, DType_lhs, cpu, dimension_rhs, DType_rhs>
+	: BinaryElementwiseTensor<cpu, dimension_dest, DType_dest, cpu, dimension_lhs, DType_lhs, cpu, dimension_rhs, DType_rhs>
 		(lhs, rhs) {}
 
-	XMATRIX_INLINE virtual void Update() {
-		if (!_isUpdated) {
-			BinaryDeducedTensor::Update();
-			assert(_lhs._shape == _rhs._shape);
-			AllocMem(_lhs._shape);
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string lhs, rhs;
+		if (!EmitOperands(code, index, lhs, rhs))
+			return false;
+		expr = lhs + " - " + rhs;
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Kernel(const DType_lhs *lhs, const DType_rhs *rhs, DType_dest *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = lhs[i] - rhs[i];
+	}
 
-			for (size_t i = 0; i < _shape.getSize(); i++)
-				_ptr[i] = _lhs._ptr[i] - _rhs._ptr[i];
+	XMATRIX_INLINE virtual void Adjoint(const DType_lhs *lhs, const DType_rhs *rhs, const DType_dest *dest, 
+		const DType_dest *grad, DType_lhs *gradLhs, DType_rhs *gradRhs, size_t length) {
+		for (size_t i = 0; i < length; i++) {
+			gradLhs[i] += grad[i];
+			gradRhs[i] -= grad[i];
 		}
 	}
 };
@@ -88,20 +123,32 @@ struct MinusTensor<cpu, dimension_dest, DType_dest, cpu, dimension_lhs, DType_lh
 */
 template<size_t dimension, typename DType_dest, typename DType_lhs, typename DType_rhs>
 struct MinusTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, 0, DType_rhs> 
-	: public BinaryDeducedTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, 0, DType_rhs> {
+	: public BinaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, 0, DType_rhs> {
 
 	XMATRIX_INLINE MinusTensor(
 		Tensor<cpu, dimension, DType_lhs> &lhs, 
 		Tensor<cpu, 0, DType_rhs> &rhs)
-	: BinaryDeducedTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, 0, DType_rhs>
+	: BinaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, 0, DType_rhs>
 		(lhs, rhs) {}
 
-	XMATRIX_INLINE void virtual Update() {
-		if (!_isUpdated) {
-			BinaryDeducedTensor::Update();
-			AllocMem(_lhs._shape);
-			for (size_t i=0; i<_lhs._shape.getSize(); i++)
-				_ptr[i] = _lhs._ptr[i] - _rhs._ptr[0];
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string lhs, rhs;
+		if (!EmitOperands(code, index, lhs, rhs))
+			return false;
+		expr = lhs + " - " + rhs;
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Kernel(const DType_lhs *lhs, const DType_rhs *rhs, DType_dest *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = lhs[i] - rhs[0];
+	}
+
+	XMATRIX_INLINE virtual void Adjoint(const DType_lhs *lhs, const DType_rhs *rhs, const DType_dest *dest, 
+		const DType_dest *grad, DType_lhs *gradLhs, DType_rhs *gradRhs, size_t length) {
+		for (size_t i = 0; i < length; i++) {
+			gradLhs[i] += grad[i];
+			gradRhs[i] -= grad[i];
 		}
 	}
 };
@@ -122,16 +169,34 @@ struct MultipleTensor<cpu, 1, DType_dest, cpu, 1, DType_lhs, cpu, 2, DType_rhs>
 	XMATRIX_INLINE void virtual Update() {
 		if (!_isUpdated) {
 			BinaryDeducedTensor::Update();
-			assert(_lhs._shape[0] == _rhs._shape[0]);
-			AllocMem(Shape1(_rhs._shape[1]));
-
-			for (size_t i = 0; i < _shape[0]; i++) {
-				_ptr[i] = 0;
-				for (size_t j = 0; j < _lhs._shape[0]; j++)
-					_ptr[i] += _lhs._ptr[j] * _rhs._ptr[j * _rhs._stride + i];
-			}
+			CheckShape();
+			AllocMem(_shape);
+			Execute();
 		}
 	}
+
+	XMATRIX_INLINE virtual bool InferShape() {
+		_shape = Shape1(_rhs._shape[1]);
+		return _lhs._shape[0] == _rhs._shape[0];
+	}
+
+	XMATRIX_INLINE virtual void Execute() {
+		Gemv(_lhs._shape[0], _shape[0], _lhs._ptr, _lhs._stride, _rhs._ptr, _rhs._stride, _rhs._innerStride, _ptr);
+	}
+
+	/**
+	* d lhs = rhs d dest^T, d rhs = lhs^T d dest
+	*/
+	XMATRIX_INLINE virtual void Backward() {
+		size_t k = _lhs._shape[0], n = _shape[0];
+		std::vector<DType_dest> gradLhs(k);
+		Gemv(n, k, &_grad[0], 1, _rhs._ptr, _rhs._innerStride, _rhs._stride, &gradLhs[0]);
+		for (size_t i = 0; i < k; i++)
+			_lhs._grad[i] += gradLhs[i];
+		for (size_t i = 0; i < k; i++)
+			for (size_t j = 0; j < n; j++)
+				_rhs._grad[i * n + j] += _lhs._ptr[i * _lhs._stride] * _grad[j];
+	}
 };
 
 /**
@@ -150,14 +215,74 @@ struct MultipleTensor<cpu, 0, DType_dest, cpu, 1, DType_lhs, cpu, 1, DType_rhs>
 	XMATRIX_INLINE void virtual Update() {
 		if (!_isUpdated) {
 			BinaryDeducedTensor::Update();
-			assert(_lhs._shape[0] == _rhs._shape[0]);
-			AllocMem(Shape0());
+			CheckShape();
+			AllocMem(_shape);
+			Execute();
+		}
+	}
+
+	XMATRIX_INLINE virtual bool InferShape() {
+		_shape = Shape0();
+		return _lhs._shape[0] == _rhs._shape[0];
+	}
+
+	XMATRIX_INLINE virtual void Execute() {
+		_ptr[0] = Dot<DType_dest>(_lhs._shape[0], _lhs._ptr, _lhs._stride, _rhs._ptr, _rhs._stride);
+	}
+
+	XMATRIX_INLINE virtual void Backward() {
+		for (size_t i = 0; i < _lhs._shape[0]; i++) {
+			_lhs._grad[i] += _grad[0] * _rhs._ptr[i * _rhs._stride];
+			_rhs._grad[i] += _grad[0] * _lhs._ptr[i * _lhs._stride];
+		}
+	}
+};
+
+/**
+* Multiple Operator: Vector = Matrix x Vector, the dot products of a batch of
+* vectors (the rows) with one vector
+*/
+template<typename DType_dest, typename DType_lhs, typename DType_rhs>
+struct MultipleTensor<cpu, 1, DType_dest, cpu, 2, DType_lhs, cpu, 1, DType_rhs> 
+	: public BinaryDeducedTensor<cpu, 1, DType_dest, cpu, 2, DType_lhs, cpu, 1, DType_rhs> {
 
-			_ptr[0] = 0;
-			for (size_t i = 0; i < _lhs._shape[0]; i++) 
-				_ptr[0] += _lhs._ptr[i] * _rhs._ptr[i];
+	XMATRIX_INLINE MultipleTensor(
+		Tensor<cpu, 2, DType_lhs> &lhs, 
+		Tensor<cpu, 1, DType_rhs> &rhs)
+	: BinaryDeducedTensor<cpu, 1, DType_dest, cpu, 2, DType_lhs, cpu, 1, DType_rhs>
+		(lhs, rhs) {}
+
+	XMATRIX_INLINE void virtual Update() {
+		if (!_isUpdated) {
+			BinaryDeducedTensor::Update();
+			CheckShape();
+			AllocMem(_shape);
+			Execute();
 		}
 	}
+
+	XMATRIX_INLINE virtual bool InferShape() {
+		_shape = Shape1(_lhs._shape[0]);
+		return _lhs._shape[1] == _rhs._shape[0];
+	}
+
+	XMATRIX_INLINE virtual void Execute() {
+		Gemv(_rhs._shape[0], _shape[0], _rhs._ptr, _rhs._stride, _lhs._ptr, _lhs._innerStride, _lhs._stride, _ptr);
+	}
+
+	/**
+	* d lhs = d dest rhs^T, d rhs = lhs^T d dest
+	*/
+	XMATRIX_INLINE virtual void Backward() {
+		size_t m = _shape[0], k = _rhs._shape[0];
+		std::vector<DType_dest> gradRhs(k);
+		Gemv(m, k, &_grad[0], 1, _lhs._ptr, _lhs._stride, _lhs._innerStride, &gradRhs[0]);
+		for (size_t j = 0; j < k; j++)
+			_rhs._grad[j] += gradRhs[j];
+		for (size_t i = 0; i < m; i++)
+			for (size_t j = 0; j < k; j++)
+				_lhs._grad[i * k + j] += _grad[i] * _rhs._ptr[j * _rhs._stride];
+	}
 };
 
 /**
@@ -176,17 +301,37 @@ struct MultipleTensor<cpu, 2, DType_dest, cpu, 2, DType_lhs, cpu, 2, DType_rhs>
 	XMATRIX_INLINE void virtual Update() {
 		if (!_isUpdated) {
 			BinaryDeducedTensor::Update();
-			assert(_lhs._shape[1] == _rhs._shape[0]);
-			AllocMem(Shape2(_lhs._shape[0], _rhs._shape[1]));
-
-			for (size_t i = 0; i < _shape[0]; i++) 
-				for (size_t j = 0; j < _shape[1]; j++) {
-					_ptr[i * _stride + j] = 0;
-					for (size_t k = 0; k < _lhs._shape[1]; k++)
-						_ptr[i * _stride + j] += _lhs._ptr[i * _lhs._stride + k] * _rhs._ptr[k * _rhs._stride + j];
-				}
+			CheckShape();
+			AllocMem(_shape);
+			Execute();
 		}
 	}
+
+	XMATRIX_INLINE virtual bool InferShape() {
+		_shape = Shape2(_lhs._shape[0], _rhs._shape[1]);
+		return _lhs._shape[1] == _rhs._shape[0];
+	}
+
+	XMATRIX_INLINE virtual void Execute() {
+		Gemm(_shape[0], _shape[1], _lhs._shape[1],
+			_lhs._ptr, _lhs._stride, _lhs._innerStride,
+			_rhs._ptr, _rhs._stride, _rhs._innerStride,
+			_ptr, _stride);
+	}
+
+	/**
+	* d lhs = d dest rhs^T, d rhs = lhs^T d dest
+	*/
+	XMATRIX_INLINE virtual void Backward() {
+		size_t m = _shape[0], n = _shape[1], k = _lhs._shape[1];
+		std::vector<DType_dest> gradLhs(m * k), gradRhs(k * n);
+		Gemm(m, k, n, &_grad[0], n, 1, _rhs._ptr, _rhs._innerStride, _rhs._stride, &gradLhs[0], k);
+		Gemm(k, n, m, _lhs._ptr, _lhs._innerStride, _lhs._stride, &_grad[0], n, 1, &gradRhs[0], n);
+		for (size_t i = 0; i < m * k; i++)
+			_lhs._grad[i] += gradLhs[i];
+		for (size_t i = 0; i < k * n; i++)
+			_rhs._grad[i] += gradRhs[i];
+	}
 };
 
 /**
@@ -194,20 +339,32 @@ struct MultipleTensor<cpu, 2, DType_dest, cpu, 2, DType_lhs, cpu, 2, DType_rhs>
 */
 template<size_t dimension, typename DType_dest, typename DType_lhs, typename DType_rhs>
 struct MultipleTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, 0, DType_rhs> 
-	: public BinaryDeducedTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, 0, DType_rhs> {
+	: public BinaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, 0, DType_rhs> {
 
 	XMATRIX_INLINE MultipleTensor(
 		Tensor<cpu, dimension, DType_lhs> &lhs, 
 		Tensor<cpu, 0, DType_rhs> &rhs)
-	: BinaryDeducedTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, 0, DType_rhs>
+	: BinaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, 0, DType_rhs>
 		(lhs, rhs) {}
 
-	XMATRIX_INLINE void virtual Update() {
-		if (!_isUpdated) {
-			BinaryDeducedTensor::Update();
-			AllocMem(_lhs._shape);
-			for (size_t i=0; i<_lhs._shape.getSize(); i++)
-				_ptr[i] = _lhs._ptr[i] * _rhs._ptr[0];
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string lhs, rhs;
+		if (!EmitOperands(code, index, lhs, rhs))
+			return false;
+		expr = lhs + " * " + rhs;
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Kernel(const DType_lhs *lhs, const DType_rhs *rhs, DType_dest *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = lhs[i] * rhs[0];
+	}
+
+	XMATRIX_INLINE virtual void Adjoint(const DType_lhs *lhs, const DType_rhs *rhs, const DType_dest *dest, 
+		const DType_dest *grad, DType_lhs *gradLhs, DType_rhs *gradRhs, size_t length) {
+		for (size_t i = 0; i < length; i++) {
+			gradLhs[i] += grad[i] * rhs[i];
+			gradRhs[i] += grad[i] * lhs[i];
 		}
 	}
 };
@@ -215,24 +372,73 @@ struct MultipleTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu
 /**
 * Dot Operator
 */
-template<size_t dimension, typename DType_dest, typename DType_lhs, typename DType_rhs>
-struct DotTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, dimension, DType_rhs> 
-	: public BinaryDeducedTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, dimension, DType_rhs> {
+template<size_t dimension_dest, typename DType_dest,
+	size_t dimension_lhs, typename DType_lhs,
+	size_t dimension_rhs, typename DType_rhs>
+struct DotTensor<cpu, dimension_dest, DType_dest, cpu, dimension_lhs, DType_lhs, cpu, dimension_rhs, DType_rhs> 
+	: public BinaryElementwiseTensor<cpu, dimension_dest, DType_dest, cpu, dimension_lhs, DType_lhs, cpu, dimension_rhs, DType_rhs> {
 
 	XMATRIX_INLINE DotTensor(
-		Tensor<cpu, dimension, DType_lhs> &lhs, 
-		Tensor<cpu, dimension, DType_rhs> &rhs)
-	: BinaryDeducedTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, dimension, DType_rhs>
+		Tensor<cpu, dimension_lhs, DType_lhs> &lhs, 
+		Tensor<cpu, dimension_rhs, DType_rhs> &rhs)
+	: BinaryElementwiseTensor<cpu, dimension_dest, DType_dest, cpu, dimension_lhs, DType_lhs, cpu, dimension_rhs, DType_rhs>
 		(lhs, rhs) { }
 
-	XMATRIX_INLINE virtual void Update() {
-		if (!_isUpdated) {
-			BinaryDeducedTensor::Update();
-			assert(_lhs._shape == _rhs._shape);
-			AllocMem(_lhs._shape);
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string lhs, rhs;
+		if (!EmitOperands(code, index, lhs, rhs))
+			return false;
+		expr = lhs + " * " + rhs;
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Kernel(const DType_lhs *lhs, const DType_rhs *rhs, DType_dest *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = lhs[i] * rhs[i];
+	}
+
+	XMATRIX_INLINE virtual void Adjoint(const DType_lhs *lhs, const DType_rhs *rhs, const DType_dest *dest, 
+		const DType_dest *grad, DType_lhs *gradLhs, DType_rhs *gradRhs, size_t length) {
+		for (size_t i = 0; i < length; i++) {
+			gradLhs[i] += grad[i] * rhs[i];
+			gradRhs[i] += grad[i] * lhs[i];
+		}
+	}
+};
+
+/**
+* Divide Operator
+*/
+template<size_t dimension_dest, typename DType_dest,
+	size_t dimension_lhs, typename DType_lhs,
+	size_t dimension_rhs, typename DType_rhs>
+struct DivideTensor<cpu, dimension_dest, DType_dest, cpu, dimension_lhs, DType_lhs, cpu, dimension_rhs, DType_rhs> 
+	: public BinaryElementwiseTensor<cpu, dimension_dest, DType_dest, cpu, dimension_lhs, DType_lhs, cpu, dimension_rhs, DType_rhs> {
+
+	XMATRIX_INLINE DivideTensor(
+		Tensor<cpu, dimension_lhs, DType_lhs> &lhs, 
+		Tensor<cpu, dimension_rhs, DType_rhs> &rhs)
+	: BinaryElementwiseTensor<cpu, dimension_dest, DType_dest, cpu, dimension_lhs, DType_lhs, cpu, dimension_rhs, DType_rhs>
+		(lhs, rhs) { }
+
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string lhs, rhs;
+		if (!EmitOperands(code, index, lhs, rhs))
+			return false;
+		expr = lhs + " / " + rhs;
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Kernel(const DType_lhs *lhs, const DType_rhs *rhs, DType_dest *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = lhs[i] / rhs[i];
+	}
 
-			for (size_t i = 0; i < _shape.getSize(); i++)
-				_ptr[i] = _lhs._ptr[i] *   _rhs._ptr[i];
+	XMATRIX_INLINE virtual void Adjoint(const DType_lhs *lhs, const DType_rhs *rhs, const DType_dest *dest, 
+		const DType_dest *grad, DType_lhs *gradLhs, DType_rhs *gradRhs, size_t length) {
+		for (size_t i = 0; i < length; i++) {
+			gradLhs[i] += grad[i] / rhs[i];
+			gradRhs[i] -= grad[i] * dest[i] / rhs[i];
 		}
 	}
 };
@@ -242,20 +448,32 @@ struct DotTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, dim
 */
 template<size_t dimension, typename DType_dest, typename DType_lhs, typename DType_rhs>
 struct DivideTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, 0, DType_rhs> 
-	: public BinaryDeducedTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, 0, DType_rhs> {
+	: public BinaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, 0, DType_rhs> {
 
 	XMATRIX_INLINE DivideTensor(
 		Tensor<cpu, dimension, DType_lhs> &lhs, 
 		Tensor<cpu, 0, DType_rhs> &rhs)
-	: BinaryDeducedTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, 0, DType_rhs>
+	: BinaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu, 0, DType_rhs>
 		(lhs, rhs) {}
 
-	XMATRIX_INLINE void virtual Update() {
-		if (!_isUpdated) {
-			BinaryDeducedTensor::Update();
-			AllocMem(_lhs._shape);
-			for (size_t i=0; i<_lhs._shape.getSize(); i++)
-				_ptr[i] = _lhs._ptr[i] / _rhs._ptr[0];
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string lhs, rhs;
+		if (!EmitOperands(code, index, lhs, rhs))
+			return false;
+		expr = lhs + " / " + rhs;
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Kernel(const DType_lhs *lhs, const DType_rhs *rhs, DType_dest *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = lhs[i] / rhs[0];
+	}
+
+	XMATRIX_INLINE virtual void Adjoint(const DType_lhs *lhs, const DType_rhs *rhs, const DType_dest *dest, 
+		const DType_dest *grad, DType_lhs *gradLhs, DType_rhs *gradRhs, size_t length) {
+		for (size_t i = 0; i < length; i++) {
+			gradLhs[i] += grad[i] / rhs[i];
+			gradRhs[i] -= grad[i] * dest[i] / rhs[i];
 		}
 	}
 };
@@ -265,20 +483,32 @@ struct DivideTensor<cpu, dimension, DType_dest, cpu, dimension, DType_lhs, cpu,
 */
 template<size_t dimension, typename DType_dest, typename DType_lhs, typename DType_rhs>
 struct DivideTensor<cpu, dimension, DType_dest, cpu, 0, DType_lhs, cpu, dimension, DType_rhs> 
-	: public BinaryDeducedTensor<cpu, dimension, DType_dest, cpu, 0, DType_lhs, cpu, dimension, DType_rhs> {
+	: public BinaryElementwiseTensor<cpu, dimension, DType_dest, cpu, 0, DType_lhs, cpu, dimension, DType_rhs> {
 
 	XMATRIX_INLINE DivideTensor(
 		Tensor<cpu, 0, DType_lhs> &lhs, 
 		Tensor<cpu, dimension, DType_rhs> &rhs)
-	: BinaryDeducedTensor<cpu, dimension, DType_dest, cpu, 0, DType_lhs, cpu, dimension, DType_rhs>
+	: BinaryElementwiseTensor<cpu, dimension, DType_dest, cpu, 0, DType_lhs, cpu, dimension, DType_rhs>
 		(lhs, rhs) {}
 
-	XMATRIX_INLINE void virtual Update() {
-		if (!_isUpdated) {
-			BinaryDeducedTensor::Update();
-			AllocMem(_rhs._shape);
-			for (size_t i=0; i<_rhs._shape.getSize(); i++)
-				_ptr[i] = _lhs._ptr[0] / _rhs._ptr[i];
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string lhs, rhs;
+		if (!EmitOperands(code, index, lhs, rhs))
+			return false;
+		expr = lhs + " / " + rhs;
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Kernel(const DType_lhs *lhs, const DType_rhs *rhs, DType_dest *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = lhs[0] / rhs[i];
+	}
+
+	XMATRIX_INLINE virtual void Adjoint(const DType_lhs *lhs, const DType_rhs *rhs, const DType_dest *dest, 
+		const DType_dest *grad, DType_lhs *gradLhs, DType_rhs *gradRhs, size_t length) {
+		for (size_t i = 0; i < length; i++) {
+			gradLhs[i] += grad[i] / rhs[i];
+			gradRhs[i] -= grad[i] * dest[i] / rhs[i];
 		}
 	}
 };
@@ -288,19 +518,31 @@ struct DivideTensor<cpu, dimension, DType_dest, cpu, 0, DType_lhs, cpu, dimensio
 */
 template<typename DType_dest, typename DType_lhs, typename DType_rhs>
 struct DivideTensor<cpu, 0, DType_dest, cpu, 0, DType_lhs, cpu, 0, DType_rhs> 
-	: public BinaryDeducedTensor<cpu, 0, DType_dest, cpu, 0, DType_lhs, cpu, 0, DType_rhs> {
+	: public BinaryElementwiseTensor<cpu, 0, DType_dest, cpu, 0, DType_lhs, cpu, 0, DType_rhs> {
 
 	XMATRIX_INLINE DivideTensor(
 		Tensor<cpu, 0, DType_lhs> &lhs, 
 		Tensor<cpu, 0, DType_rhs> &rhs)
-	: BinaryDeducedTensor<cpu, 0, DType_dest, cpu, 0, DType_lhs, cpu, 0, DType_rhs>
+	: BinaryElementwiseTensor<cpu, 0, DType_dest, cpu, 0, DType_lhs, cpu, 0, DType_rhs>
 		(lhs, rhs) {}
 
-	XMATRIX_INLINE void virtual Update() {
-		if (!_isUpdated) {
-			BinaryDeducedTensor::Update();
-			AllocMem(_rhs._shape);
-			_ptr[0] = _lhs._ptr[0] / _rhs._ptr[0];
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string lhs, rhs;
+		if (!EmitOperands(code, index, lhs, rhs))
+			return false;
+		expr = lhs + " / " + rhs;
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Kernel(const DType_lhs *lhs, const DType_rhs *rhs, DType_dest *dest, size_t length) {
+		dest[0] = lhs[0] / rhs[0];
+	}
+
+	XMATRIX_INLINE virtual void Adjoint(const DType_lhs *lhs, const DType_rhs *rhs, const DType_dest *dest, 
+		const DType_dest *grad, DType_lhs *gradLhs, DType_rhs *gradRhs, size_t length) {
+		for (size_t i = 0; i < length; i++) {
+			gradLhs[i] += grad[i] / rhs[i];
+			gradRhs[i] -= grad[i] * dest[i] / rhs[i];
 		}
 	}
 };
@@ -318,12 +560,31 @@ struct TransposeTensor<cpu, 2, DType, cpu, 2, DType>
 	XMATRIX_INLINE void virtual Update() {
 		if (!_isUpdated) {
 			UnaryDeducedTensor::Update();
-			AllocMem(Shape2(_src._shape[1], _src._shape[0]));
-			for (size_t i = 0; i < _shape[0]; i++)
-				for (size_t j = 0; j < _shape[1]; j++)
-					_ptr[i * _stride + j] = _src._ptr[j * _src._stride + i];
+			CheckShape();
+			AllocMem(_shape);
+			Execute();
 		}
 	}
+
+	XMATRIX_INLINE virtual bool InferShape() {
+		_shape = Shape2(_src._shape[1], _src._shape[0]);
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Execute() {
+		if (_src._innerStride == 1)
+			Transpose(_src._shape[0], _src._shape[1], _src._ptr, _src._stride, _ptr, _stride);
+		else
+			for (size_t i = 0; i < _src._shape[0]; i++)
+				for (size_t j = 0; j < _src._shape[1]; j++)
+					_ptr[j * _stride + i] = _src._ptr[i * _src._stride + j * _src._innerStride];
+	}
+
+	XMATRIX_INLINE virtual void Backward() {
+		for (size_t i = 0; i < _src._shape[0]; i++)
+			for (size_t j = 0; j < _src._shape[1]; j++)
+				_src._grad[i * _src._shape[1] + j] += _grad[j * _shape[1] + i];
+	}
 };
 
 /**
@@ -339,11 +600,26 @@ struct TransposeTensor<cpu, 2, DType, cpu, 1, DType>
 	XMATRIX_INLINE void virtual Update() {
 		if (!_isUpdated) {
 			UnaryDeducedTensor::Update();
-			AllocMem(Shape2(_src._shape[0]), 1);
-			for (size_t i = 0; i < _shape.getSize(); i++)
-					_ptr[i] = _src._ptr[i];
+			CheckShape();
+			AllocMem(_shape);
+			Execute();
 		}
 	}
+
+	XMATRIX_INLINE virtual bool InferShape() {
+		_shape = Shape2(1, _src._shape[0]);
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Execute() {
+		for (size_t i = 0; i < _shape.getSize(); i++)
+			_ptr[i] = _src._ptr[i * _src._stride];
+	}
+
+	XMATRIX_INLINE virtual void Backward() {
+		for (size_t i = 0; i < _shape.getSize(); i++)
+			_src._grad[i] += _grad[i];
+	}
 };
 
 /**
@@ -363,149 +639,1385 @@ struct SubscriptTensor<cpu, dimension_dest, DType, cpu, dimension_src, DType>
 	XMATRIX_INLINE void virtual Update() {
 		if (!_isUpdated) {
 			UnaryDeducedTensor::Update();
-			_shape = _src._shape.SubShape();
-			_stride = _shape.SubShape().getSize();
+			CheckShape();
+			_innerStride = _src._innerStride;
+			_stride = (dimension_dest > 1)? _shape.SubShape().getSize() * _innerStride : _innerStride;
 			_ptr = _src._ptr + _index * _src._stride;
 		}
 	}
+
+	XMATRIX_INLINE virtual bool InferShape() {
+		_shape = _src._shape.SubShape();
+		return _index < _src._shape[0];
+	}
+
+	XMATRIX_INLINE virtual size_t MemSize() const {
+		return 0;
+	}
+
+	XMATRIX_INLINE virtual bool IsView() const {
+		return true;
+	}
+
+	XMATRIX_INLINE virtual bool IsDense() const {
+		return _src.IsDense();
+	}
+
+	XMATRIX_INLINE virtual void Backward() {
+		size_t size = _shape.getSize();
+		for (size_t i = 0; i < size; i++)
+			_src._grad[_index * size + i] += _grad[i];
+	}
 };
 
 /**
-* Exponential Tensor
+* Slice Tensor: view of the elements begin, begin + step, ... before end of
+* every dimension, sharing the buffer of the source. Ends past the extent
+* of the source are clamped to it
 */
 template<size_t dimension, typename DType>
-struct ExponentialTensor<cpu, dimension, double, cpu, dimension, DType>
-	: public UnaryDeducedTensor<cpu, dimension, double, cpu, dimension, DType> {
-	
-	XMATRIX_INLINE ExponentialTensor(Tensor<cpu, dimension, DType> &src) 
-		: UnaryDeducedTensor<cpu, dimension, double, cpu, dimension, DType>(src) {}
+struct SliceTensor<cpu, dimension, DType, cpu, dimension, DType>
+	: public UnaryDeducedTensor<cpu, dimension, DType, cpu, dimension, DType> {
+
+	static_assert(dimension == 1 || dimension == 2, "Error: slices of vectors and matrices only");
+
+	const Shape<dimension> _begin;
+	const Shape<dimension> _end;
+	const Shape<dimension> _step;
+
+	XMATRIX_INLINE SliceTensor(Tensor<cpu, dimension, DType> &src, 
+		Shape<dimension> begin, Shape<dimension> end, Shape<dimension> step) 
+		: UnaryDeducedTensor<cpu, dimension, DType, cpu, dimension, DType>(src), _begin(begin), _end(end), _step(step) {}
 
 	XMATRIX_INLINE void virtual Update() {
 		if (!_isUpdated) {
 			UnaryDeducedTensor::Update();
-			AllocMem(_src._shape);
-			for (size_t i = 0; i < _shape.getSize(); i++)
-					_ptr[i] = exp(_src._ptr[i]);
+			CheckShape();
+			_stride = _src._stride * _step[0];
+			_innerStride = (dimension > 1)? _src._innerStride * _step[dimension - 1] : _stride;
+			_ptr = _src._ptr + _begin[0] * _src._stride;
+			if (dimension > 1)
+				_ptr += _begin[dimension - 1] * _src._innerStride;
+		}
+	}
+
+	XMATRIX_INLINE virtual bool InferShape() {
+		for (size_t i = 0; i < dimension; i++) {
+			size_t end = (_end[i] < _src._shape[i])? _end[i] : _src._shape[i];
+			if (_step[i] == 0 || _begin[i] > end)
+				return false;
+			_shape[i] = (end - _begin[i] + _step[i] - 1) / _step[i];
 		}
+		return true;
+	}
+
+	XMATRIX_INLINE virtual size_t MemSize() const {
+		return 0;
+	}
+
+	XMATRIX_INLINE virtual bool IsView() const {
+		return true;
+	}
+
+	/**
+	* Whole rows of a dense matrix, or a step 1 range of a dense vector
+	*/
+	XMATRIX_INLINE virtual bool IsDense() const {
+		if (dimension == 1)
+			return _src.IsDense() && _step[0] == 1;
+		return _src.IsDense() && _step[dimension - 1] == 1 && _src._shape[dimension - 1] * _step[0] == _shape[dimension - 1];
+	}
+
+	XMATRIX_INLINE virtual void Backward() {
+		size_t rows = _shape[0], cols = (dimension > 1)? _shape[dimension - 1] : 1;
+		size_t srcCols = (dimension > 1)? _src._shape[dimension - 1] : 1;
+		size_t colBegin = (dimension > 1)? _begin[dimension - 1] : 0, colStep = (dimension > 1)? _step[dimension - 1] : 1;
+		for (size_t i = 0; i < rows; i++)
+			for (size_t j = 0; j < cols; j++)
+				_src._grad[(_begin[0] + i * _step[0]) * srcCols + colBegin + j * colStep] += _grad[i * cols + j];
 	}
 };
 
 /**
-* Log Tensor
+* Reshape Tensor: the elements of the source in row-major order under a new
+* shape, in which an extent of 0 is deduced from the size of the source. A
+* dense source (see IsDense) is shared, a strided one is gathered into a
+* buffer of its own
 */
-template<size_t dimension, typename DType>
-struct LogTensor<cpu, dimension, double, cpu, dimension, DType>
-	: public UnaryDeducedTensor<cpu, dimension, double, cpu, dimension, DType> {
-	
-	XMATRIX_INLINE LogTensor(Tensor<cpu, dimension, DType> &src) 
-		: UnaryDeducedTensor<cpu, dimension, double, cpu, dimension, DType>(src) {}
+template<size_t dimension_dest, size_t dimension_src, typename DType>
+struct ReshapeTensor<cpu, dimension_dest, DType, cpu, dimension_src, DType>
+	: public UnaryDeducedTensor<cpu, dimension_dest, DType, cpu, dimension_src, DType> {
+
+	const Shape<dimension_dest> _target;
+
+	XMATRIX_INLINE ReshapeTensor(Tensor<cpu, dimension_src, DType> &src, Shape<dimension_dest> shape) 
+		: UnaryDeducedTensor<cpu, dimension_dest, DType, cpu, dimension_src, DType>(src), _target(shape) {}
 
 	XMATRIX_INLINE void virtual Update() {
 		if (!_isUpdated) {
 			UnaryDeducedTensor::Update();
-			AllocMem(_src._shape);
-			for (size_t i = 0; i < _shape.getSize(); i++)
-					_ptr[i] = log(_src._ptr[i]);
+			CheckShape();
+			size_t size = _shape.getSize();
+			if (_src.IsDense()) {
+				FreeMem();
+				_stride = _shape.SubShape().getSize();
+				_innerStride = 1;
+				_ptr = _src._ptr;
+			} else {
+				AllocMem(_shape);
+				const DType *src = _src.Fetch(0, size, _ptr);
+				if (src != _ptr)
+					memcpy(_ptr, src, size * sizeof(DType));
+			}
+		}
+	}
+
+	/**
+	* One extent given as 0 is deduced from the others
+	*/
+	XMATRIX_INLINE virtual bool InferShape() {
+		size_t size = _src._shape.getSize(), known = 1, deduced = dimension_dest;
+		_shape = _target;
+		for (size_t i = 0; i < dimension_dest; i++) {
+			if (_shape[i] == 0)
+				deduced = i;
+			else
+				known *= _shape[i];
 		}
+		if (deduced < dimension_dest)
+			_shape[deduced] = (known > 0)? size / known : 0;
+		return _shape.getSize() == size;
+	}
+
+	/**
+	* A view of a dense source, a gathered copy of a strided one; planned
+	* from the extents like every buffer (see IsDense)
+	*/
+	XMATRIX_INLINE virtual size_t MemSize() const {
+		return _src.IsDense()? 0 : _shape.getSize() * sizeof(DType);
+	}
+
+	XMATRIX_INLINE virtual bool IsView() const {
+		return _src.IsDense();
+	}
+
+	XMATRIX_INLINE virtual void Backward() {
+		for (size_t i = 0; i < _shape.getSize(); i++)
+			_src._grad[i] += _grad[i];
+	}
+};
+
+/**
+* Exponential Tensor
+*/
+template<size_t dimension, typename DType_dest, typename DType>
+struct ExponentialTensor<cpu, dimension, DType_dest, cpu, dimension, DType>
+	: public UnaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType> {
+	
+	XMATRIX_INLINE ExponentialTensor(Tensor<cpu, dimension, DType> &src) 
+		: UnaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType>(src) {}
+
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string src;
+		if (!EmitOperand(code, index, src))
+			return false;
+		expr = "exp(" + src + ")";
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Kernel(const DType *src, DType_dest *dest, size_t length) {
+		VectorMath<DType_dest>::Exp(Promote(src, dest, length), dest, length, IsFastMath());
+	}
+
+	XMATRIX_INLINE virtual void Adjoint(const DType *src, const DType_dest *dest, const DType_dest *grad, 
+		DType *gradSrc, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			gradSrc[i] += grad[i] * dest[i];
+	}
+};
+
+/**
+* Log Tensor
+*/
+template<size_t dimension, typename DType_dest, typename DType>
+struct LogTensor<cpu, dimension, DType_dest, cpu, dimension, DType>
+	: public UnaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType> {
+	
+	XMATRIX_INLINE LogTensor(Tensor<cpu, dimension, DType> &src) 
+		: UnaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType>(src) {}
+
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string src;
+		if (!EmitOperand(code, index, src))
+			return false;
+		expr = "log(" + src + ")";
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Kernel(const DType *src, DType_dest *dest, size_t length) {
+		VectorMath<DType_dest>::Log(Promote(src, dest, length), dest, length, IsFastMath());
+	}
+
+	XMATRIX_INLINE virtual void Adjoint(const DType *src, const DType_dest *dest, const DType_dest *grad, 
+		DType *gradSrc, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			gradSrc[i] += grad[i] / src[i];
 	}
 };
 
 /**
 * Log10 Tensor
 */
-template<size_t dimension, typename DType>
-struct Log10Tensor<cpu, dimension, double, cpu, dimension, DType>
-	: public UnaryDeducedTensor<cpu, dimension, double, cpu, dimension, DType> {
+template<size_t dimension, typename DType_dest, typename DType>
+struct Log10Tensor<cpu, dimension, DType_dest, cpu, dimension, DType>
+	: public UnaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType> {
 	
 	XMATRIX_INLINE Log10Tensor(Tensor<cpu, dimension, DType> &src) 
-		: UnaryDeducedTensor<cpu, dimension, double, cpu, dimension, DType>(src) {}
+		: UnaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType>(src) {}
+
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string src;
+		if (!EmitOperand(code, index, src))
+			return false;
+		expr = "log10(" + src + ")";
+		return true;
+	}
 
-	XMATRIX_INLINE void virtual Update() {
-		if (!_isUpdated) {
-			UnaryDeducedTensor::Update();
-			AllocMem(_src._shape);
-			for (size_t i = 0; i < _shape.getSize(); i++)
-					_ptr[i] = log10(_src._ptr[i]);
-		}
+	XMATRIX_INLINE virtual void Kernel(const DType *src, DType_dest *dest, size_t length) {
+		VectorMath<DType_dest>::Log10(Promote(src, dest, length), dest, length, IsFastMath());
+	}
+
+	XMATRIX_INLINE virtual void Adjoint(const DType *src, const DType_dest *dest, const DType_dest *grad, 
+		DType *gradSrc, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			gradSrc[i] += grad[i] / (src[i] * log(10.0));
 	}
 };
 
 /**
 * Sqrt Tensor
 */
-template<size_t dimension, typename DType>
-struct SqrtTensor<cpu, dimension, double, cpu, dimension, DType>
-	: public UnaryDeducedTensor<cpu, dimension, double, cpu, dimension, DType> {
+template<size_t dimension, typename DType_dest, typename DType>
+struct SqrtTensor<cpu, dimension, DType_dest, cpu, dimension, DType>
+	: public UnaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType> {
 	
 	XMATRIX_INLINE SqrtTensor(Tensor<cpu, dimension, DType> &src) 
-		: UnaryDeducedTensor<cpu, dimension, double, cpu, dimension, DType>(src) {}
+		: UnaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType>(src) {}
+
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string src;
+		if (!EmitOperand(code, index, src))
+			return false;
+		expr = "sqrt(" + src + ")";
+		return true;
+	}
 
-	XMATRIX_INLINE void virtual Update() {
-		if (!_isUpdated) {
-			UnaryDeducedTensor::Update();
-			AllocMem(_src._shape);
-			for (size_t i = 0; i < _shape.getSize(); i++)
-					_ptr[i] = sqrt(_src._ptr[i]);
-		}
+	XMATRIX_INLINE virtual void Kernel(const DType *src, DType_dest *dest, size_t length) {
+		VectorMath<DType_dest>::Sqrt(Promote(src, dest, length), dest, length, IsFastMath());
+	}
+
+	XMATRIX_INLINE virtual void Adjoint(const DType *src, const DType_dest *dest, const DType_dest *grad, 
+		DType *gradSrc, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			gradSrc[i] += grad[i] * 0.5 / dest[i];
 	}
 };
 
 /**
 * Power Tensor
 */
-template<size_t dimension, typename DType>
-struct PowerTensor<cpu, dimension, double, cpu, dimension, DType>
-	: public UnaryDeducedTensor<cpu, dimension, double, cpu, dimension, DType> {
+template<size_t dimension, typename DType_dest, typename DType>
+struct PowerTensor<cpu, dimension, DType_dest, cpu, dimension, DType>
+	: public UnaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType> {
 
 	const double _exp;
 	
 	XMATRIX_INLINE PowerTensor(Tensor<cpu, dimension, DType> &src, double exp) 
-		: UnaryDeducedTensor<cpu, dimension, double, cpu, dimension, DType>(src), _exp(exp) {}
+		: UnaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType>(src), _exp(exp) {}
+
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string src;
+		if (!EmitOperand(code, index, src))
+			return false;
+		std::ostringstream os;
+		os << std::setprecision(17) << "pow(" << src << ", " << _exp << ")";
+		expr = os.str();
+		return true;
+	}
 
-	XMATRIX_INLINE void virtual Update() {
-		if (!_isUpdated) {
-			UnaryDeducedTensor::Update();
-			AllocMem(_src._shape);
-			for (size_t i = 0; i < _shape.getSize(); i++)
-					_ptr[i] = pow(_src._ptr[i], _exp);
-		}
+	XMATRIX_INLINE virtual void Kernel(const DType *src, DType_dest *dest, size_t length) {
+		VectorMath<DType_dest>::Pow(Promote(src, dest, length), _exp, dest, length, IsFastMath());
+	}
+
+	XMATRIX_INLINE virtual void Adjoint(const DType *src, const DType_dest *dest, const DType_dest *grad, 
+		DType *gradSrc, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			gradSrc[i] += grad[i] * _exp * pow(src[i], _exp - 1);
 	}
 };
 
 /**
-* Abs Tensor
+* Fill Tensor: src only gives the shape, it is neither computed by Fetch()
+* nor differentiated
 */
-template<size_t dimension, typename DType>
-struct AbsTensor<cpu, dimension, DType, cpu, dimension, DType>
-	: public UnaryDeducedTensor<cpu, dimension, DType, cpu, dimension, DType> {
-	
-	XMATRIX_INLINE AbsTensor(Tensor<cpu, dimension, DType> &src) 
-		: UnaryDeducedTensor<cpu, dimension, DType, cpu, dimension, DType>(src) {}
+template<size_t dimension, typename DType_dest, typename DType>
+struct FillTensor<cpu, dimension, DType_dest, cpu, dimension, DType>
+	: public UnaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType> {
 
-	XMATRIX_INLINE void virtual Update() {
-		if (!_isUpdated) {
-			UnaryDeducedTensor::Update();
-			AllocMem(_src._shape);
-			for (size_t i = 0; i < _shape.getSize(); i++)
-					_ptr[i] = fabs(_src._ptr[i]);
-		}
-	}
-};
+	const double _value;
 
-template<size_t dimension>
-struct AbsTensor<cpu, dimension, int, cpu, dimension, int>
-	: public UnaryDeducedTensor<cpu, dimension, int, cpu, dimension, int> {
-	
-	XMATRIX_INLINE AbsTensor(Tensor<cpu, dimension, int> &src) 
-		: UnaryDeducedTensor<cpu, dimension, int, cpu, dimension, int>(src) {}
+	XMATRIX_INLINE FillTensor(Tensor<cpu, dimension, DType> &src, double value)
+		: UnaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType>(src), _value(value) {}
 
-	XMATRIX_INLINE void virtual Update() {
-		if (!_isUpdated) {
-			UnaryDeducedTensor::Update();
-			AllocMem(_src._shape);
-			for (size_t i = 0; i < _shape.getSize(); i++)
-					_ptr[i] = abs(_src._ptr[i]);
-		}
+	XMATRIX_INLINE virtual const DType_dest *Fetch(size_t offset, size_t length, DType_dest *buffer) {
+		if (_isUpdated)
+			return _ptr + offset;
+		std::fill(buffer, buffer + length, (DType_dest)_value);
+		return buffer;
+	}
+
+	XMATRIX_INLINE virtual void Execute() {
+		std::fill(_ptr, _ptr + _shape.getSize(), (DType_dest)_value);
+	}
+
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::ostringstream os;
+		os << std::setprecision(17) << _value;
+		expr = os.str();
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Kernel(const DType *src, DType_dest *dest, size_t length) {
+		std::fill(dest, dest + length, (DType_dest)_value);
+	}
+
+	XMATRIX_INLINE virtual void Backward() {}
+};
+
+/**
+* Erf Tensor
+*/
+template<size_t dimension, typename DType_dest, typename DType>
+struct ErfTensor<cpu, dimension, DType_dest, cpu, dimension, DType>
+	: public UnaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType> {
+	
+	XMATRIX_INLINE ErfTensor(Tensor<cpu, dimension, DType> &src) 
+		: UnaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType>(src) {}
+
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string src;
+		if (!EmitOperand(code, index, src))
+			return false;
+		expr = "erf(" + src + ")";
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Kernel(const DType *src, DType_dest *dest, size_t length) {
+		VectorMath<DType_dest>::Erf(Promote(src, dest, length), dest, length, IsFastMath());
+	}
+
+	XMATRIX_INLINE virtual void Adjoint(const DType *src, const DType_dest *dest, const DType_dest *grad, 
+		DType *gradSrc, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			gradSrc[i] += grad[i] * 1.1283791670955126 * exp(-src[i] * src[i]);
+	}
+};
+
+/**
+* Erfc Tensor
+*/
+template<size_t dimension, typename DType_dest, typename DType>
+struct ErfcTensor<cpu, dimension, DType_dest, cpu, dimension, DType>
+	: public UnaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType> {
+	
+	XMATRIX_INLINE ErfcTensor(Tensor<cpu, dimension, DType> &src) 
+		: UnaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType>(src) {}
+
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string src;
+		if (!EmitOperand(code, index, src))
+			return false;
+		expr = "erfc(" + src + ")";
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Kernel(const DType *src, DType_dest *dest, size_t length) {
+		VectorMath<DType_dest>::Erfc(Promote(src, dest, length), dest, length, IsFastMath());
+	}
+
+	XMATRIX_INLINE virtual void Adjoint(const DType *src, const DType_dest *dest, const DType_dest *grad, 
+		DType *gradSrc, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			gradSrc[i] -= grad[i] * 1.1283791670955126 * exp(-src[i] * src[i]);
+	}
+};
+
+/**
+* Normal CDF Tensor
+*/
+template<size_t dimension, typename DType_dest, typename DType>
+struct NormCdfTensor<cpu, dimension, DType_dest, cpu, dimension, DType>
+	: public UnaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType> {
+	
+	XMATRIX_INLINE NormCdfTensor(Tensor<cpu, dimension, DType> &src) 
+		: UnaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType>(src) {}
+
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string src;
+		if (!EmitOperand(code, index, src))
+			return false;
+		expr = "(0.5 * erfc(" + src + " * -0.70710678118654752))";
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Kernel(const DType *src, DType_dest *dest, size_t length) {
+		VectorMath<DType_dest>::NormCdf(Promote(src, dest, length), dest, length, IsFastMath());
+	}
+
+	XMATRIX_INLINE virtual void Adjoint(const DType *src, const DType_dest *dest, const DType_dest *grad, 
+		DType *gradSrc, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			gradSrc[i] += grad[i] * 0.3989422804014327 * exp(src[i] * src[i] * -0.5);
+	}
+};
+
+/**
+* Normal PDF Tensor
+*/
+template<size_t dimension, typename DType_dest, typename DType>
+struct NormPdfTensor<cpu, dimension, DType_dest, cpu, dimension, DType>
+	: public UnaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType> {
+	
+	XMATRIX_INLINE NormPdfTensor(Tensor<cpu, dimension, DType> &src) 
+		: UnaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType>(src) {}
+
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string src;
+		if (!EmitOperand(code, index, src))
+			return false;
+		expr = "(0.3989422804014327 * exp(" + src + " * " + src + " * -0.5))";
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Kernel(const DType *src, DType_dest *dest, size_t length) {
+		VectorMath<DType_dest>::NormPdf(Promote(src, dest, length), dest, length, IsFastMath());
+	}
+
+	XMATRIX_INLINE virtual void Adjoint(const DType *src, const DType_dest *dest, const DType_dest *grad, 
+		DType *gradSrc, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			gradSrc[i] -= grad[i] * src[i] * dest[i];
+	}
+};
+
+/**
+* Inverse Normal CDF Tensor
+*/
+template<size_t dimension, typename DType_dest, typename DType>
+struct NormInvTensor<cpu, dimension, DType_dest, cpu, dimension, DType>
+	: public UnaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType> {
+	
+	XMATRIX_INLINE NormInvTensor(Tensor<cpu, dimension, DType> &src) 
+		: UnaryElementwiseTensor<cpu, dimension, DType_dest, cpu, dimension, DType>(src) {}
+
+	XMATRIX_INLINE virtual void Kernel(const DType *src, DType_dest *dest, size_t length) {
+		VectorMath<DType_dest>::NormInv(Promote(src, dest, length), dest, length, IsFastMath());
+	}
+
+	XMATRIX_INLINE virtual void Adjoint(const DType *src, const DType_dest *dest, const DType_dest *grad, 
+		DType *gradSrc, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			gradSrc[i] += grad[i] * 2.5066282746310007 * exp(dest[i] * dest[i] * 0.5);
+	}
+};
+
+/**
+* Elements [offset, offset + length) of an operand broadcast over the
+* result, in the element type of the result: scalars are filled in, other
+* operands repeated along the batch axes. The result may point into buffer,
+* operands read together need a buffer each
+*/
+template<size_t dimension, typename DType, typename DType_dest>
+XMATRIX_INLINE const DType_dest *FetchBroadcast(Tensor<cpu, dimension, DType> &operand, size_t offset, size_t length,
+	DType *buffer, DType_dest *promoted) {
+	if (operand._shape.getSize() == 1) {
+		std::fill(promoted, promoted + length, (DType_dest)operand.Fetch(0, 1, buffer)[0]);
+		return promoted;
+	}
+	return Promote(FetchRepeated(operand, offset, length, buffer), promoted, length);
+}
+
+/**
+* Black-Scholes Tensor: price, delta, gamma, vega, theta and rho of European
+* options in rows 0 to 5 of the result, over the broadcast shape of spot,
+* strike, vol, rate and tenor (scalars, or extents matching the trailing
+* ones). The operands are streamed in XMATRIX_FUSION_BLOCK sized blocks, and
+* d1, d2, the discount factor and the normal terms of a block are computed
+* once for all six rows. Vega and rho are per unit of vol and rate, theta
+* per year of calendar time. Backward() differentiates all six rows
+*/
+template<size_t dimension_dest, typename DType_dest, size_t dimension_spot, size_t dimension_strike,
+	size_t dimension_vol, size_t dimension_rate, size_t dimension_tenor, typename DType>
+struct BlackScholesTensor<cpu, dimension_dest, DType_dest,
+	cpu, dimension_spot, dimension_strike, dimension_vol, dimension_rate, dimension_tenor, DType>
+	: public Tensor<cpu, dimension_dest, DType_dest> {
+	Tensor<cpu, dimension_spot, DType> &_spot;
+	Tensor<cpu, dimension_strike, DType> &_strike;
+	Tensor<cpu, dimension_vol, DType> &_vol;
+	Tensor<cpu, dimension_rate, DType> &_rate;
+	Tensor<cpu, dimension_tenor, DType> &_tenor;
+	int _isCall;
+
+	XMATRIX_INLINE BlackScholesTensor(Tensor<cpu, dimension_spot, DType> &spot,
+		Tensor<cpu, dimension_strike, DType> &strike, Tensor<cpu, dimension_vol, DType> &vol,
+		Tensor<cpu, dimension_rate, DType> &rate, Tensor<cpu, dimension_tenor, DType> &tenor, int isCall)
+		: Tensor<cpu, dimension_dest, DType_dest>(false), _spot(spot), _strike(strike), _vol(vol), _rate(rate),
+		_tenor(tenor), _isCall(isCall) {
+		AddInput(spot);
+		AddInput(strike);
+		AddInput(vol);
+		AddInput(rate);
+		AddInput(tenor);
+	}
+
+	XMATRIX_INLINE virtual bool InferShape() {
+		Shape<dimension_dest - 1> inner;
+		bool isSet = false;
+		SeedShape(inner, isSet, _spot._shape);
+		SeedShape(inner, isSet, _strike._shape);
+		SeedShape(inner, isSet, _vol._shape);
+		SeedShape(inner, isSet, _rate._shape);
+		SeedShape(inner, isSet, _tenor._shape);
+		bool fits = BroadcastShape(inner, inner, _spot._shape) && BroadcastShape(inner, inner, _strike._shape)
+			&& BroadcastShape(inner, inner, _vol._shape) && BroadcastShape(inner, inner, _rate._shape)
+			&& BroadcastShape(inner, inner, _tenor._shape);
+		_shape[0] = 6;
+		for (size_t i = 0; i + 1 < dimension_dest; i++)
+			_shape[i + 1] = inner[i];
+		return fits;
+	}
+
+	XMATRIX_INLINE virtual bool StreamsInputs() const {
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Update() {
+		if (!_isUpdated) {
+			// elementwise operands are not materialized, Compute() streams them
+			_spot.Prepare();
+			_strike.Prepare();
+			_vol.Prepare();
+			_rate.Prepare();
+			_tenor.Prepare();
+			CheckShape();
+			AllocMem(_shape);
+			Execute();
+			_isUpdated = true;
+		}
+	}
+
+	XMATRIX_INLINE virtual void Execute() {
+		size_t size = _shape.SubShape().getSize();
+		ParallelFor(0, (size + XMATRIX_FUSION_BLOCK - 1) / XMATRIX_FUSION_BLOCK, 8, [this, size](size_t first, size_t last) {
+			for (size_t i = first * XMATRIX_FUSION_BLOCK; i < size && i < last * XMATRIX_FUSION_BLOCK; i += XMATRIX_FUSION_BLOCK)
+				Compute(i, (size - i < XMATRIX_FUSION_BLOCK)? size - i : XMATRIX_FUSION_BLOCK);
+		});
+	}
+
+	XMATRIX_INLINE void Compute(size_t offset, size_t length) {
+		DType buffer[5][XMATRIX_FUSION_BLOCK];
+		DType_dest spot[XMATRIX_FUSION_BLOCK], strike[XMATRIX_FUSION_BLOCK], vol[XMATRIX_FUSION_BLOCK],
+			rate[XMATRIX_FUSION_BLOCK], tenor[XMATRIX_FUSION_BLOCK];
+		size_t size = _shape.SubShape().getSize();
+		DType_dest *dest = _ptr + offset;
+		Kernel(FetchBroadcast(_spot, offset, length, buffer[0], spot), FetchBroadcast(_strike, offset, length, buffer[1], strike),
+			FetchBroadcast(_vol, offset, length, buffer[2], vol), FetchBroadcast(_rate, offset, length, buffer[3], rate),
+			FetchBroadcast(_tenor, offset, length, buffer[4], tenor),
+			dest, dest + size, dest + 2 * size, dest + 3 * size, dest + 4 * size, dest + 5 * size, length);
+	}
+
+	/**
+	* With s = 1 for calls and -1 for puts: price = s (S N(s d1) - K D N(s d2)),
+	* delta = s N(s d1), gamma = phi(d1) / (S vol sqrt(T)), vega = S phi(d1)
+	* sqrt(T), theta = -S phi(d1) vol / (2 sqrt(T)) - s r K D N(s d2) and
+	* rho = s T K D N(s d2), where D = e^(-r T)
+	*/
+	XMATRIX_INLINE void Kernel(const DType_dest *spot, const DType_dest *strike, const DType_dest *vol,
+		const DType_dest *rate, const DType_dest *tenor, DType_dest *price, DType_dest *delta, DType_dest *gamma,
+		DType_dest *vega, DType_dest *theta, DType_dest *rho, size_t length) {
+		bool fast = IsFastMath();
+		DType_dest sign = _isCall? 1 : -1;
+		DType_dest root[XMATRIX_FUSION_BLOCK], d1[XMATRIX_FUSION_BLOCK], d2[XMATRIX_FUSION_BLOCK],
+			discount[XMATRIX_FUSION_BLOCK], pdf[XMATRIX_FUSION_BLOCK];
+
+		VectorMath<DType_dest>::Sqrt(tenor, root, length, fast);
+		for (size_t i = 0; i < length; i++)
+			d1[i] = spot[i] / strike[i];
+		VectorMath<DType_dest>::Log(d1, d1, length, fast);
+		for (size_t i = 0; i < length; i++) {
+			DType_dest deviation = vol[i] * root[i];
+			d1[i] = (d1[i] + (rate[i] + vol[i] * vol[i] * 0.5) * tenor[i]) / deviation;
+			d2[i] = d1[i] - deviation;
+			discount[i] = -rate[i] * tenor[i];
+		}
+		VectorMath<DType_dest>::Exp(discount, discount, length, fast);
+		VectorMath<DType_dest>::NormPdf(d1, pdf, length, fast);
+		// N(s d1) and N(s d2) in place of d1 and d2
+		for (size_t i = 0; i < length; i++) {
+			d1[i] = d1[i] * sign;
+			d2[i] = d2[i] * sign;
+		}
+		VectorMath<DType_dest>::NormCdf(d1, d1, length, fast);
+		VectorMath<DType_dest>::NormCdf(d2, d2, length, fast);
+
+		for (size_t i = 0; i < length; i++) {
+			DType_dest strikeValue = strike[i] * discount[i] * d2[i];
+			DType_dest density = spot[i] * pdf[i];
+			price[i] = (spot[i] * d1[i] - strikeValue) * sign;
+			delta[i] = d1[i] * sign;
+			gamma[i] = pdf[i] / (spot[i] * vol[i] * root[i]);
+			vega[i] = density * root[i];
+			theta[i] = -density * vol[i] / (root[i] * 2) - strikeValue * rate[i] * sign;
+			rho[i] = strikeValue * tenor[i] * sign;
+		}
+	}
+
+	/**
+	* The rows are differentiated in each operand x through d1, d2 = d1 - vol
+	* sqrt(T), a = S phi(d1) = K D phi(d2) and W = K D N(s d2) = S N(s d1) -
+	* s price; broadcast operands sum their adjoints over the repetitions
+	*/
+	XMATRIX_INLINE virtual void Backward() {
+		size_t size = _shape.SubShape().getSize();
+		const DType_dest *price = _ptr, *delta = _ptr + size;
+		const DType_dest *grad = &_grad[0];
+		size_t sizes[5] = { _spot._shape.getSize(), _strike._shape.getSize(), _vol._shape.getSize(),
+			_rate._shape.getSize(), _tenor._shape.getSize() };
+		DType *grads[5] = { &_spot._grad[0], &_strike._grad[0], &_vol._grad[0], &_rate._grad[0], &_tenor._grad[0] };
+		DType_dest sign = _isCall? 1 : -1;
+		for (size_t i = 0; i < size; i += XMATRIX_FUSION_BLOCK) {
+			size_t length = (size - i < XMATRIX_FUSION_BLOCK)? size - i : XMATRIX_FUSION_BLOCK;
+			DType buffer[5][XMATRIX_FUSION_BLOCK];
+			DType_dest spot[XMATRIX_FUSION_BLOCK], strike[XMATRIX_FUSION_BLOCK], vol[XMATRIX_FUSION_BLOCK],
+				rate[XMATRIX_FUSION_BLOCK], tenor[XMATRIX_FUSION_BLOCK];
+			const DType_dest *S = FetchBroadcast(_spot, i, length, buffer[0], spot);
+			const DType_dest *K = FetchBroadcast(_strike, i, length, buffer[1], strike);
+			const DType_dest *v = FetchBroadcast(_vol, i, length, buffer[2], vol);
+			const DType_dest *r = FetchBroadcast(_rate, i, length, buffer[3], rate);
+			const DType_dest *T = FetchBroadcast(_tenor, i, length, buffer[4], tenor);
+			for (size_t j = 0; j < length; j++) {
+				size_t n = i + j;
+				DType_dest root = sqrt(T[j]), deviation = v[j] * root, discount = exp(-r[j] * T[j]);
+				DType_dest d1 = (log(S[j] / K[j]) + (r[j] + v[j] * v[j] * 0.5) * T[j]) / deviation, d2 = d1 - deviation;
+				DType_dest pdf = exp(d1 * d1 * -0.5) * 0.3989422804014327, a = S[j] * pdf;
+				DType_dest n1 = delta[n] * sign, w = S[j] * n1 - price[n] * sign, n2 = w / (K[j] * discount);
+				DType_dest gamma = pdf / (S[j] * deviation);
+				// d d1 / d x and d (K D) / d x for x = spot, strike, vol, rate, tenor
+				DType_dest dd1[5] = { 1 / (S[j] * deviation), -1 / (K[j] * deviation), -d2 / v[j], root / v[j],
+					(r[j] + v[j] * v[j] * 0.5) / deviation - d1 / (T[j] * 2) };
+				DType_dest dd2[5] = { dd1[0], dd1[1], -d1 / v[j], dd1[3], dd1[4] - v[j] / (root * 2) };
+				DType_dest dkd[5] = { 0, discount, 0, -T[j] * K[j] * discount, -r[j] * K[j] * discount };
+				for (size_t x = 0; x < 5; x++) {
+					DType_dest da = a * ((x == 0? 1 / S[j] : 0) - d1 * dd1[x]);
+					DType_dest dw = dkd[x] * n2 + sign * a * dd2[x];
+					DType_dest dprice = sign * ((x == 0? n1 : 0) + sign * a * dd1[x] - dw);
+					DType_dest ddelta = pdf * dd1[x];
+					DType_dest dgamma = gamma * (-d1 * dd1[x] - (x == 0? 1 / S[j] : 0) - (x == 2? 1 / v[j] : 0)
+						- (x == 4? 1 / (T[j] * 2) : 0));
+					DType_dest dvega = root * da + (x == 4? a / (root * 2) : 0);
+					DType_dest dtheta = -v[j] / (root * 2) * da - (x == 2? a / (root * 2) : 0)
+						+ (x == 4? a * v[j] / (root * T[j] * 4) : 0) - sign * (x == 3? w : 0) - sign * r[j] * dw;
+					DType_dest drho = sign * ((x == 4? w : 0) + T[j] * dw);
+					grads[x][n % sizes[x]] += (DType)(grad[n] * dprice + grad[n + size] * ddelta
+						+ grad[n + 2 * size] * dgamma + grad[n + 3 * size] * dvega + grad[n + 4 * size] * dtheta
+						+ grad[n + 5 * size] * drho);
+				}
+			}
+		}
+	}
+};
+
+/**
+* Implied Volatility Tensor: the vol at which the Black-Scholes price of each
+* option equals its price, over the broadcast shape of price, spot, strike,
+* rate and tenor. A block of options is solved together: each lane starts
+* from the Corrado-Miller guess and takes Halley steps on the log price of
+* the out-of-the-money twin of its option (by put-call parity) in total
+* deviation vol sqrt(T), bisecting its bracket when a step leaves it. Lanes
+* are dropped from the arrays the vector kernels run on as they converge,
+* so an iteration costs what is left to solve. Prices outside the no
+* arbitrage bounds give NaN, prices at the lower bound a vol of 0
+*/
+template<size_t dimension_dest, typename DType_dest, size_t dimension_price, size_t dimension_spot,
+	size_t dimension_strike, size_t dimension_rate, size_t dimension_tenor, typename DType>
+struct ImpliedVolTensor<cpu, dimension_dest, DType_dest,
+	cpu, dimension_price, dimension_spot, dimension_strike, dimension_rate, dimension_tenor, DType>
+	: public Tensor<cpu, dimension_dest, DType_dest> {
+	Tensor<cpu, dimension_price, DType> &_price;
+	Tensor<cpu, dimension_spot, DType> &_spot;
+	Tensor<cpu, dimension_strike, DType> &_strike;
+	Tensor<cpu, dimension_rate, DType> &_rate;
+	Tensor<cpu, dimension_tenor, DType> &_tenor;
+	int _isCall;
+
+	static const size_t _kMaxIterations = 64;
+
+	XMATRIX_INLINE ImpliedVolTensor(Tensor<cpu, dimension_price, DType> &price,
+		Tensor<cpu, dimension_spot, DType> &spot, Tensor<cpu, dimension_strike, DType> &strike,
+		Tensor<cpu, dimension_rate, DType> &rate, Tensor<cpu, dimension_tenor, DType> &tenor, int isCall)
+		: Tensor<cpu, dimension_dest, DType_dest>(false), _price(price), _spot(spot), _strike(strike), _rate(rate),
+		_tenor(tenor), _isCall(isCall) {
+		AddInput(price);
+		AddInput(spot);
+		AddInput(strike);
+		AddInput(rate);
+		AddInput(tenor);
+	}
+
+	XMATRIX_INLINE virtual bool InferShape() {
+		bool isSet = false;
+		SeedShape(_shape, isSet, _price._shape);
+		SeedShape(_shape, isSet, _spot._shape);
+		SeedShape(_shape, isSet, _strike._shape);
+		SeedShape(_shape, isSet, _rate._shape);
+		SeedShape(_shape, isSet, _tenor._shape);
+		return BroadcastShape(_shape, _shape, _price._shape) && BroadcastShape(_shape, _shape, _spot._shape)
+			&& BroadcastShape(_shape, _shape, _strike._shape) && BroadcastShape(_shape, _shape, _rate._shape)
+			&& BroadcastShape(_shape, _shape, _tenor._shape);
+	}
+
+	XMATRIX_INLINE virtual bool StreamsInputs() const {
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Update() {
+		if (!_isUpdated) {
+			_price.Prepare();
+			_spot.Prepare();
+			_strike.Prepare();
+			_rate.Prepare();
+			_tenor.Prepare();
+			CheckShape();
+			AllocMem(_shape);
+			Execute();
+			_isUpdated = true;
+		}
+	}
+
+	XMATRIX_INLINE virtual void Execute() {
+		size_t size = _shape.getSize();
+		ParallelFor(0, (size + XMATRIX_FUSION_BLOCK - 1) / XMATRIX_FUSION_BLOCK, 4, [this, size](size_t first, size_t last) {
+			for (size_t i = first * XMATRIX_FUSION_BLOCK; i < size && i < last * XMATRIX_FUSION_BLOCK; i += XMATRIX_FUSION_BLOCK)
+				Compute(i, (size - i < XMATRIX_FUSION_BLOCK)? size - i : XMATRIX_FUSION_BLOCK);
+		});
+	}
+
+	XMATRIX_INLINE void Compute(size_t offset, size_t length) {
+		DType buffer[5][XMATRIX_FUSION_BLOCK];
+		DType_dest price[XMATRIX_FUSION_BLOCK], spot[XMATRIX_FUSION_BLOCK], strike[XMATRIX_FUSION_BLOCK],
+			rate[XMATRIX_FUSION_BLOCK], tenor[XMATRIX_FUSION_BLOCK];
+		Kernel(FetchBroadcast(_price, offset, length, buffer[0], price), FetchBroadcast(_spot, offset, length, buffer[1], spot),
+			FetchBroadcast(_strike, offset, length, buffer[2], strike), FetchBroadcast(_rate, offset, length, buffer[3], rate),
+			FetchBroadcast(_tenor, offset, length, buffer[4], tenor), _ptr + offset, length);
+	}
+
+	XMATRIX_INLINE void Kernel(const DType_dest *price, const DType_dest *spot, const DType_dest *strike,
+		const DType_dest *rate, const DType_dest *tenor, DType_dest *dest, size_t length) {
+		bool fast = IsFastMath();
+		double tolerance = fast? 1e-7 : 1e-12, priceTolerance = fast? 1e-8 : 1e-15;
+		DType_dest root[XMATRIX_FUSION_BLOCK], discounted[XMATRIX_FUSION_BLOCK], moneyness[XMATRIX_FUSION_BLOCK];
+
+		VectorMath<DType_dest>::Sqrt(tenor, root, length, fast);
+		for (size_t i = 0; i < length; i++)
+			discounted[i] = -rate[i] * tenor[i];
+		VectorMath<DType_dest>::Exp(discounted, discounted, length, fast);
+		for (size_t i = 0; i < length; i++) {
+			discounted[i] = strike[i] * discounted[i];
+			moneyness[i] = spot[i] / discounted[i];
+		}
+		VectorMath<DType_dest>::Log(moneyness, moneyness, length, fast);
+
+		// the lanes still solving, packed at the front of the arrays
+		size_t lane[XMATRIX_FUSION_BLOCK];
+		DType_dest x[XMATRIX_FUSION_BLOCK], w[XMATRIX_FUSION_BLOCK], lower[XMATRIX_FUSION_BLOCK], upper[XMATRIX_FUSION_BLOCK],
+			target[XMATRIX_FUSION_BLOCK], s[XMATRIX_FUSION_BLOCK], k[XMATRIX_FUSION_BLOCK], sign[XMATRIX_FUSION_BLOCK];
+		size_t count = 0;
+		for (size_t i = 0; i < length; i++) {
+			DType_dest option = _isCall? 1 : -1;
+			DType_dest forward = (spot[i] - discounted[i]) * option;
+			DType_dest intrinsic = (forward > 0)? forward : DType_dest(0);
+			DType_dest bound = _isCall? spot[i] : discounted[i];
+			if (!(price[i] >= intrinsic && price[i] < bound)) {
+				dest[i] = NAN;
+				continue;
+			}
+			if (price[i] == intrinsic) {
+				dest[i] = 0;
+				continue;
+			}
+
+			DType_dest value = price[i];
+			if (moneyness[i] * option > 0) {
+				value = value - forward;
+				option = -option;
+			}
+			// Corrado-Miller on the call price, the inflection point of the
+			// price in w when it has no root
+			DType_dest half = (spot[i] - discounted[i]) * 0.5;
+			DType_dest excess = ((option > 0)? value : value + spot[i] - discounted[i]) - half;
+			DType_dest root2 = excess * excess - half * half * 1.2732395447351628;
+			DType_dest guess = (excess + sqrt((root2 > 0)? root2 : DType_dest(0))) * 2.5066282746310007 / (spot[i] + discounted[i]);
+			if (!(root2 >= 0 && guess > 0 && guess < 20))
+				guess = sqrt(fabs(moneyness[i]) * 2);
+			if (!(guess > 0 && guess < 20))
+				guess = 1;
+
+			lane[count] = i;
+			x[count] = moneyness[i];
+			w[count] = guess;
+			lower[count] = 0;
+			upper[count] = 20;
+			target[count] = value;
+			s[count] = spot[i];
+			k[count] = discounted[i];
+			sign[count] = option;
+			count++;
+		}
+		VectorMath<DType_dest>::Log(target, target, count, fast);
+
+		DType_dest d1[XMATRIX_FUSION_BLOCK], pdf[XMATRIX_FUSION_BLOCK], n1[XMATRIX_FUSION_BLOCK], n2[XMATRIX_FUSION_BLOCK];
+		for (size_t iteration = 0; iteration < _kMaxIterations && count > 0; iteration++) {
+			for (size_t j = 0; j < count; j++) {
+				d1[j] = x[j] / w[j] + w[j] * 0.5;
+				n1[j] = d1[j] * sign[j];
+				n2[j] = (d1[j] - w[j]) * sign[j];
+			}
+			VectorMath<DType_dest>::NormPdf(d1, pdf, count, fast);
+			VectorMath<DType_dest>::NormCdf(n1, n1, count, fast);
+			VectorMath<DType_dest>::NormCdf(n2, n2, count, fast);
+			for (size_t j = 0; j < count; j++)
+				n1[j] = (s[j] * n1[j] - k[j] * n2[j]) * sign[j];
+			VectorMath<DType_dest>::Log(n1, n2, count, fast);
+
+			// f = ln price(w) - ln target, f' = vega / price and
+			// f'' / f' = d1 d2 / w - f'
+			size_t kept = 0;
+			for (size_t j = 0; j < count; j++) {
+				DType_dest f = n2[j] - target[j];
+				if (f > 0)
+					upper[j] = w[j];
+				else if (f < 0)
+					lower[j] = w[j];
+				DType_dest slope = s[j] * pdf[j] / n1[j];
+				DType_dest newton = f / slope;
+				DType_dest denominator = 1 - newton * (d1[j] * (d1[j] - w[j]) / w[j] - slope) * 0.5;
+				DType_dest next = w[j] - ((denominator > 0.5)? newton / denominator : newton);
+				if (!(next >= lower[j] && next <= upper[j]))
+					next = (lower[j] + upper[j]) * 0.5;
+				bool done = fabs(next - w[j]) <= next * tolerance || fabs(f) <= priceTolerance;
+				w[j] = next;
+				if (done) {
+					dest[lane[j]] = w[j] / root[lane[j]];
+					continue;
+				}
+				lane[kept] = lane[j];
+				x[kept] = x[j];
+				w[kept] = w[j];
+				lower[kept] = lower[j];
+				upper[kept] = upper[j];
+				target[kept] = target[j];
+				s[kept] = s[j];
+				k[kept] = k[j];
+				sign[kept] = sign[j];
+				kept++;
+			}
+			count = kept;
+		}
+		for (size_t j = 0; j < count; j++)
+			dest[lane[j]] = w[j] / root[lane[j]];
+	}
+
+	/**
+	* d vol / d operand = -(d price / d operand) / vega at the solved vol, and
+	* 1 / vega for the price
+	*/
+	XMATRIX_INLINE virtual void Backward() {
+		size_t size = _shape.getSize();
+		size_t sizePrice = _price._shape.getSize(), sizeSpot = _spot._shape.getSize(),
+			sizeStrike = _strike._shape.getSize(), sizeRate = _rate._shape.getSize(), sizeTenor = _tenor._shape.getSize();
+		double option = _isCall? 1 : -1;
+		for (size_t i = 0; i < size; i += XMATRIX_FUSION_BLOCK) {
+			size_t length = (size - i < XMATRIX_FUSION_BLOCK)? size - i : XMATRIX_FUSION_BLOCK;
+			DType buffer[4][XMATRIX_FUSION_BLOCK];
+			DType_dest spot[XMATRIX_FUSION_BLOCK], strike[XMATRIX_FUSION_BLOCK], rate[XMATRIX_FUSION_BLOCK],
+				tenor[XMATRIX_FUSION_BLOCK];
+			const DType_dest *S = FetchBroadcast(_spot, i, length, buffer[0], spot);
+			const DType_dest *K = FetchBroadcast(_strike, i, length, buffer[1], strike);
+			const DType_dest *r = FetchBroadcast(_rate, i, length, buffer[2], rate);
+			const DType_dest *T = FetchBroadcast(_tenor, i, length, buffer[3], tenor);
+			for (size_t j = 0; j < length; j++) {
+				size_t n = i + j;
+				DType_dest vol = _ptr[n];
+				if (!(vol > 0))
+					continue;
+				DType_dest root = sqrt(T[j]), discounted = K[j] * exp(-r[j] * T[j]);
+				DType_dest d1 = log(S[j] / discounted) / (vol * root) + vol * root * 0.5;
+				DType_dest n1 = erfc(d1 * option * -0.70710678118654752) * 0.5;
+				DType_dest n2 = erfc((d1 - vol * root) * option * -0.70710678118654752) * 0.5;
+				DType_dest density = S[j] * exp(d1 * d1 * -0.5) * 0.3989422804014327;
+				DType_dest scale = _grad[n] / (density * root);
+				DType_dest theta = -density * vol / (root * 2) - discounted * n2 * r[j] * option;
+				_price._grad[n % sizePrice] += (DType)scale;
+				_spot._grad[n % sizeSpot] -= (DType)(scale * n1 * option);
+				_strike._grad[n % sizeStrike] += (DType)(scale * exp(-r[j] * T[j]) * n2 * option);
+				_rate._grad[n % sizeRate] -= (DType)(scale * discounted * n2 * T[j] * option);
+				_tenor._grad[n % sizeTenor] += (DType)(scale * theta);
+			}
+		}
+	}
+};
+
+/**
+* Gathers all elements of a tensor promoted to DType_dest, for nodes which
+* read their operands at random
+*/
+template<size_t dimension, typename DType, typename DType_dest>
+XMATRIX_INLINE void FetchAll(Tensor<cpu, dimension, DType> &operand, std::vector<DType_dest> &dest) {
+	size_t size = operand._shape.getSize();
+	std::vector<DType> buffer(size);
+	dest.resize(size);
+	const DType_dest *p = Promote(operand.Fetch(0, size, &buffer[0]), &dest[0], size);
+	if (p != &dest[0])
+		std::copy(p, p + size, dest.begin());
+}
+
+/**
+* Surface Coefficients Tensor: one polynomial patch per cell of a grid of
+* rows x cols values over increasing row and column knots, an extent of
+* (rows - 1, cols - 1, (order + 1)^2) holding the coefficient of u^p v^q at
+* p (order + 1) + q, with u and v the position in the cell scaled to [0, 1].
+* Order 1 patches are bilinear; order 3 patches are the cells of the natural
+* bicubic spline of the grid, the Hermite patches of its values and of the
+* row, column and cross slopes of the spline at the knots. The patches are
+* computed once per Load() of the grid or the knots, the Surface Tensors
+* interpolating the grid only evaluate them
+*/
+template<typename DType_dest, typename DType>
+struct SurfaceCoefficientsTensor<cpu, 3, DType_dest, cpu, DType>
+	: public Tensor<cpu, 3, DType_dest> {
+	Tensor<cpu, 2, DType> &_grid;
+	Tensor<cpu, 1, DType> &_rows;
+	Tensor<cpu, 1, DType> &_cols;
+	int _order;
+	// slopes at the knots of the splines through the unit vectors, kept for Backward()
+	std::vector<DType_dest> _rowSlopes, _colSlopes;
+
+	XMATRIX_INLINE SurfaceCoefficientsTensor(Tensor<cpu, 2, DType> &grid, Tensor<cpu, 1, DType> &rows,
+		Tensor<cpu, 1, DType> &cols, int order)
+		: Tensor<cpu, 3, DType_dest>(false), _grid(grid), _rows(rows), _cols(cols), _order(order) {
+		AddInput(grid);
+		AddInput(rows);
+		AddInput(cols);
+	}
+
+	XMATRIX_INLINE virtual bool InferShape() {
+		size_t rows = _grid._shape[0], cols = _grid._shape[1], n = _order + 1;
+		if (rows < 2 || cols < 2)
+			return false;
+		_shape = Shape3(rows - 1, cols - 1, n * n);
+		return (_order == 1 || _order == 3) && _rows._shape[0] == rows && _cols._shape[0] == cols;
+	}
+
+	XMATRIX_INLINE virtual void Update() {
+		if (!_isUpdated) {
+			_grid.Prepare();
+			_rows.Prepare();
+			_cols.Prepare();
+			CheckShape();
+			AllocMem(_shape);
+			Execute();
+			_isUpdated = true;
+		}
+	}
+
+	XMATRIX_INLINE virtual void Execute() {
+		size_t rows = _grid._shape[0], cols = _grid._shape[1];
+		std::vector<DType_dest> grid, x, y, fx, fy, fxy;
+		FetchAll(_grid, grid);
+		FetchAll(_rows, x);
+		FetchAll(_cols, y);
+		if (_order == 3) {
+			Slopes(&x[0], rows, _rowSlopes);
+			Slopes(&y[0], cols, _colSlopes);
+			fx.assign(rows * cols, DType_dest(0));
+			fy.assign(rows * cols, DType_dest(0));
+			fxy.assign(rows * cols, DType_dest(0));
+			for (size_t i = 0; i < rows; i++)
+				for (size_t j = 0; j < cols; j++)
+					for (size_t l = 0; l < cols; l++)
+						fy[i * cols + j] += _colSlopes[j * cols + l] * grid[i * cols + l];
+			for (size_t i = 0; i < rows; i++)
+				for (size_t l = 0; l < rows; l++) {
+					DType_dest slope = _rowSlopes[i * rows + l];
+					for (size_t j = 0; j < cols; j++) {
+						fx[i * cols + j] += slope * grid[l * cols + j];
+						fxy[i * cols + j] += slope * fy[l * cols + j];
+					}
+				}
+		}
+
+		size_t n = _order + 1;
+		for (size_t i = 0; i + 1 < rows; i++)
+			for (size_t j = 0; j + 1 < cols; j++) {
+				DType_dest hx = x[i + 1] - x[i], hy = y[j + 1] - y[j];
+				// corner values, then the slopes scaled to the cell, as in Basis()
+				DType_dest corners[16];
+				for (size_t a = 0; a < 2; a++)
+					for (size_t b = 0; b < 2; b++) {
+						size_t k = (i + a) * cols + j + b;
+						corners[a * n + b] = grid[k];
+						if (_order == 3) {
+							corners[a * n + 2 + b] = fy[k] * hy;
+							corners[(2 + a) * n + b] = fx[k] * hx;
+							corners[(2 + a) * n + 2 + b] = fxy[k] * hx * hy;
+						}
+					}
+				// patch = basis corners basis^T
+				const double *basis = Basis();
+				DType_dest *patch = _ptr + (i * (cols - 1) + j) * n * n;
+				for (size_t p = 0; p < n; p++)
+					for (size_t q = 0; q < n; q++) {
+						DType_dest sum = DType_dest(0);
+						for (size_t a = 0; a < n; a++)
+							for (size_t b = 0; b < n; b++)
+								sum += corners[a * n + b] * (basis[p * n + a] * basis[q * n + b]);
+						patch[p * n + q] = sum;
+					}
+			}
+	}
+
+	/**
+	* The coefficients of the polynomial in u through corner values f0, f1
+	* (and slopes d0, d1 for order 3), by row of the power of u
+	*/
+	XMATRIX_INLINE const double *Basis() const {
+		static const double linear[4] = { 1, 0, -1, 1 };
+		static const double hermite[16] = { 1, 0, 0, 0, 0, 0, 1, 0, -3, 3, -2, -1, 2, -2, 1, 1 };
+		return (_order == 3)? hermite : linear;
+	}
+
+	/**
+	* slopes[i n + k] is the slope at knot i of the natural cubic spline
+	* through the values e_k at the n knots, by the tridiagonal system of its
+	* second derivatives
+	*/
+	XMATRIX_INLINE static void Slopes(const DType_dest *knots, size_t n, std::vector<DType_dest> &slopes) {
+		slopes.assign(n * n, DType_dest(0));
+		std::vector<DType_dest> f(n), m(n), diagonal(n);
+		for (size_t k = 0; k < n; k++) {
+			std::fill(f.begin(), f.end(), DType_dest(0));
+			f[k] = 1;
+			std::fill(m.begin(), m.end(), DType_dest(0));
+			// forward elimination of h[i-1] m[i-1] + 2 (h[i-1] + h[i]) m[i] + h[i] m[i+1] = r[i]
+			for (size_t i = 1; i + 1 < n; i++) {
+				DType_dest left = knots[i] - knots[i - 1], right = knots[i + 1] - knots[i];
+				diagonal[i] = (left + right) * 2;
+				m[i] = ((f[i + 1] - f[i]) / right - (f[i] - f[i - 1]) / left) * 6;
+				if (i > 1) {
+					DType_dest ratio = left / diagonal[i - 1];
+					diagonal[i] -= ratio * left;
+					m[i] -= ratio * m[i - 1];
+				}
+			}
+			for (size_t i = n - 1; i-- > 1; )
+				m[i] = (m[i] - (knots[i + 1] - knots[i]) * m[i + 1]) / diagonal[i];
+			for (size_t i = 0; i + 1 < n; i++) {
+				DType_dest h = knots[i + 1] - knots[i];
+				slopes[i * n + k] = (f[i + 1] - f[i]) / h - h * (m[i] * 2 + m[i + 1]) / 6;
+			}
+			DType_dest h = knots[n - 1] - knots[n - 2];
+			slopes[(n - 1) * n + k] = (f[n - 1] - f[n - 2]) / h + h * (m[n - 2] + m[n - 1] * 2) / 6;
+		}
+	}
+
+	/**
+	* The patches are linear in the grid: the adjoints of the corners are
+	* basis^T grad basis, and the slopes pass theirs back through the slope
+	* matrices. The knots are taken as constants
+	*/
+	XMATRIX_INLINE virtual void Backward() {
+		size_t rows = _grid._shape[0], cols = _grid._shape[1], n = _order + 1;
+		std::vector<DType_dest> x, y, gradGrid(rows * cols, DType_dest(0)), gradX, gradY, gradXY;
+		FetchAll(_rows, x);
+		FetchAll(_cols, y);
+		if (_order == 3) {
+			gradX.assign(rows * cols, DType_dest(0));
+			gradY.assign(rows * cols, DType_dest(0));
+			gradXY.assign(rows * cols, DType_dest(0));
+		}
+		const double *basis = Basis();
+		for (size_t i = 0; i + 1 < rows; i++)
+			for (size_t j = 0; j + 1 < cols; j++) {
+				DType_dest hx = x[i + 1] - x[i], hy = y[j + 1] - y[j];
+				const DType_dest *grad = &_grad[(i * (cols - 1) + j) * n * n];
+				DType_dest corners[16];
+				for (size_t a = 0; a < n; a++)
+					for (size_t b = 0; b < n; b++) {
+						DType_dest sum = DType_dest(0);
+						for (size_t p = 0; p < n; p++)
+							for (size_t q = 0; q < n; q++)
+								sum += grad[p * n + q] * (basis[p * n + a] * basis[q * n + b]);
+						corners[a * n + b] = sum;
+					}
+				for (size_t a = 0; a < 2; a++)
+					for (size_t b = 0; b < 2; b++) {
+						size_t k = (i + a) * cols + j + b;
+						gradGrid[k] += corners[a * n + b];
+						if (_order == 3) {
+							gradY[k] += corners[a * n + 2 + b] * hy;
+							gradX[k] += corners[(2 + a) * n + b] * hx;
+							gradXY[k] += corners[(2 + a) * n + 2 + b] * hx * hy;
+						}
+					}
+			}
+
+		if (_order == 3) {
+			// fx = Sx grid, fy = grid Sy^T, fxy = Sx fy
+			for (size_t l = 0; l < rows; l++)
+				for (size_t i = 0; i < rows; i++) {
+					DType_dest slope = _rowSlopes[i * rows + l];
+					for (size_t j = 0; j < cols; j++) {
+						gradGrid[l * cols + j] += slope * gradX[i * cols + j];
+						gradY[l * cols + j] += slope * gradXY[i * cols + j];
+					}
+				}
+			for (size_t i = 0; i < rows; i++)
+				for (size_t j = 0; j < cols; j++)
+					for (size_t l = 0; l < cols; l++)
+						gradGrid[i * cols + l] += gradY[i * cols + j] * _colSlopes[j * cols + l];
+		}
+		for (size_t k = 0; k < rows * cols; k++)
+			_grid._grad[k] += (DType)gradGrid[k];
+	}
+};
+
+/**
+* Surface Tensor: the patches of a Surface Coefficients Tensor evaluated at
+* query points (x, y) over the broadcast shape of x and y. The queries are
+* streamed in XMATRIX_FUSION_BLOCK sized blocks: a first pass finds the cell
+* of each point by binary search of the knots and its position in the cell,
+* a second evaluates the patches by Horner's rule in a branch free loop.
+* Points outside the knots are clamped to the border of the grid
+*/
+template<size_t dimension_dest, typename DType_dest, size_t dimension_x, size_t dimension_y, typename DType>
+struct SurfaceTensor<cpu, dimension_dest, DType_dest, cpu, dimension_x, dimension_y, DType>
+	: public Tensor<cpu, dimension_dest, DType_dest> {
+	Tensor<cpu, 3, DType_dest> &_coefficients;
+	Tensor<cpu, 1, DType> &_rows;
+	Tensor<cpu, 1, DType> &_cols;
+	Tensor<cpu, dimension_x, DType> &_x;
+	Tensor<cpu, dimension_y, DType> &_y;
+	// knots and reciprocal cell widths, read by the blocks of Execute()
+	std::vector<DType_dest> _rowKnots, _colKnots, _rowScales, _colScales;
+
+	XMATRIX_INLINE SurfaceTensor(Tensor<cpu, 3, DType_dest> &coefficients, Tensor<cpu, 1, DType> &rows,
+		Tensor<cpu, 1, DType> &cols, Tensor<cpu, dimension_x, DType> &x, Tensor<cpu, dimension_y, DType> &y)
+		: Tensor<cpu, dimension_dest, DType_dest>(false), _coefficients(coefficients), _rows(rows), _cols(cols),
+		_x(x), _y(y) {
+		AddInput(coefficients);
+		AddInput(rows);
+		AddInput(cols);
+		AddInput(x);
+		AddInput(y);
+	}
+
+	XMATRIX_INLINE virtual bool InferShape() {
+		bool isSet = false;
+		SeedShape(_shape, isSet, _x._shape);
+		SeedShape(_shape, isSet, _y._shape);
+		return BroadcastShape(_shape, _shape, _x._shape) && BroadcastShape(_shape, _shape, _y._shape)
+			&& _coefficients._shape[0] + 1 == _rows._shape[0] && _coefficients._shape[1] + 1 == _cols._shape[0];
+	}
+
+	XMATRIX_INLINE virtual bool StreamsInputs() const {
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Update() {
+		if (!_isUpdated) {
+			_coefficients.Prepare();
+			_rows.Prepare();
+			_cols.Prepare();
+			_x.Prepare();
+			_y.Prepare();
+			CheckShape();
+			AllocMem(_shape);
+			Execute();
+			_isUpdated = true;
+		}
+	}
+
+	XMATRIX_INLINE virtual void Execute() {
+		Knots(_rows, _rowKnots, _rowScales);
+		Knots(_cols, _colKnots, _colScales);
+		size_t size = _shape.getSize();
+		ParallelFor(0, (size + XMATRIX_FUSION_BLOCK - 1) / XMATRIX_FUSION_BLOCK, 8, [this, size](size_t first, size_t last) {
+			for (size_t i = first * XMATRIX_FUSION_BLOCK; i < size && i < last * XMATRIX_FUSION_BLOCK; i += XMATRIX_FUSION_BLOCK)
+				Compute(i, (size - i < XMATRIX_FUSION_BLOCK)? size - i : XMATRIX_FUSION_BLOCK);
+		});
+	}
+
+	XMATRIX_INLINE static void Knots(Tensor<cpu, 1, DType> &axis, std::vector<DType_dest> &knots,
+		std::vector<DType_dest> &scales) {
+		FetchAll(axis, knots);
+		scales.resize(knots.size() - 1);
+		for (size_t i = 0; i + 1 < knots.size(); i++)
+			scales[i] = DType_dest(1) / (knots[i + 1] - knots[i]);
+	}
+
+	/**
+	* cell[i] is the cell of query[i] among the n knots and t[i] its position
+	* in the cell, unclamped
+	*/
+	XMATRIX_INLINE static void Locate(const std::vector<DType_dest> &knots, const std::vector<DType_dest> &scales,
+		const DType_dest *query, size_t *cell, DType_dest *t, size_t length) {
+		const DType_dest *first = &knots[0], *last = first + knots.size() - 1;
+		for (size_t i = 0; i < length; i++) {
+			size_t c = std::upper_bound(first, last, query[i]) - first;
+			c = (c > 0)? c - 1 : 0;
+			cell[i] = c;
+			t[i] = (query[i] - first[c]) * scales[c];
+		}
+	}
+
+	XMATRIX_INLINE void Compute(size_t offset, size_t length) {
+		DType buffer[XMATRIX_FUSION_BLOCK];
+		DType_dest x[XMATRIX_FUSION_BLOCK], y[XMATRIX_FUSION_BLOCK], u[XMATRIX_FUSION_BLOCK], v[XMATRIX_FUSION_BLOCK];
+		size_t row[XMATRIX_FUSION_BLOCK], col[XMATRIX_FUSION_BLOCK];
+		Locate(_rowKnots, _rowScales, FetchBroadcast(_x, offset, length, buffer, x), row, u, length);
+		Locate(_colKnots, _colScales, FetchBroadcast(_y, offset, length, buffer, y), col, v, length);
+		for (size_t i = 0; i < length; i++) {
+			u[i] = (u[i] < 0)? DType_dest(0) : (u[i] > 1)? DType_dest(1) : u[i];
+			v[i] = (v[i] < 0)? DType_dest(0) : (v[i] > 1)? DType_dest(1) : v[i];
+			row[i] = row[i] * _coefficients._shape[1] + col[i];
+		}
+		Kernel(row, u, v, _ptr + offset, length);
+	}
+
+	XMATRIX_INLINE void Kernel(const size_t *cell, const DType_dest *u, const DType_dest *v, DType_dest *dest, size_t length) {
+		const DType_dest *coefficients = _coefficients._ptr;
+		if (_coefficients._shape[2] == 4) {
+			for (size_t i = 0; i < length; i++) {
+				const DType_dest *c = coefficients + cell[i] * 4;
+				dest[i] = (c[3] * v[i] + c[2]) * u[i] + c[1] * v[i] + c[0];
+			}
+			return;
+		}
+		for (size_t i = 0; i < length; i++) {
+			const DType_dest *c = coefficients + cell[i] * 16;
+			DType_dest a = v[i];
+			DType_dest c0 = ((c[3] * a + c[2]) * a + c[1]) * a + c[0];
+			DType_dest c1 = ((c[7] * a + c[6]) * a + c[5]) * a + c[4];
+			DType_dest c2 = ((c[11] * a + c[10]) * a + c[9]) * a + c[8];
+			DType_dest c3 = ((c[15] * a + c[14]) * a + c[13]) * a + c[12];
+			dest[i] = ((c3 * u[i] + c2) * u[i] + c1) * u[i] + c0;
+		}
+	}
+
+	/**
+	* The adjoint of a coefficient is grad u^p v^q, of a query grad times the
+	* slope of the patch across its cell, 0 where it is clamped. The knots are
+	* taken as constants
+	*/
+	XMATRIX_INLINE virtual void Backward() {
+		size_t size = _shape.getSize(), sizeX = _x._shape.getSize(), sizeY = _y._shape.getSize();
+		size_t cols = _coefficients._shape[1], n = (_coefficients._shape[2] == 4)? 2 : 4;
+		const DType_dest *coefficients = _coefficients._ptr;
+		for (size_t i = 0; i < size; i += XMATRIX_FUSION_BLOCK) {
+			size_t length = (size - i < XMATRIX_FUSION_BLOCK)? size - i : XMATRIX_FUSION_BLOCK;
+			DType buffer[XMATRIX_FUSION_BLOCK];
+			DType_dest x[XMATRIX_FUSION_BLOCK], y[XMATRIX_FUSION_BLOCK], u[XMATRIX_FUSION_BLOCK], v[XMATRIX_FUSION_BLOCK];
+			size_t row[XMATRIX_FUSION_BLOCK], col[XMATRIX_FUSION_BLOCK];
+			Locate(_rowKnots, _rowScales, FetchBroadcast(_x, i, length, buffer, x), row, u, length);
+			Locate(_colKnots, _colScales, FetchBroadcast(_y, i, length, buffer, y), col, v, length);
+			for (size_t j = 0; j < length; j++) {
+				size_t k = i + j;
+				bool insideX = u[j] >= 0 && u[j] <= 1, insideY = v[j] >= 0 && v[j] <= 1;
+				DType_dest a = insideX? u[j] : (u[j] < 0)? DType_dest(0) : DType_dest(1);
+				DType_dest b = insideY? v[j] : (v[j] < 0)? DType_dest(0) : DType_dest(1);
+				size_t cell = (row[j] * cols + col[j]) * n * n;
+				const DType_dest *c = coefficients + cell;
+				DType_dest *gradC = &_coefficients._grad[cell];
+				DType_dest du = DType_dest(0), dv = DType_dest(0), powerU = DType_dest(1);
+				for (size_t p = 0; p < n; p++) {
+					DType_dest powerV = DType_dest(1);
+					for (size_t q = 0; q < n; q++) {
+						gradC[p * n + q] += _grad[k] * powerU * powerV;
+						if (p + 1 < n)
+							du += c[(p + 1) * n + q] * powerU * powerV * (DType_dest)(p + 1);
+						if (q + 1 < n)
+							dv += c[p * n + q + 1] * powerU * powerV * (DType_dest)(q + 1);
+						powerV = powerV * b;
+					}
+					powerU = powerU * a;
+				}
+				if (insideX)
+					_x._grad[k % sizeX] += (DType)(_grad[k] * du * _rowScales[row[j]]);
+				if (insideY)
+					_y._grad[k % sizeY] += (DType)(_grad[k] * dv * _colScales[col[j]]);
+			}
+		}
+	}
+};
+
+/**
+* Abs Tensor
+*/
+template<size_t dimension, typename DType>
+struct AbsTensor<cpu, dimension, DType, cpu, dimension, DType>
+	: public UnaryElementwiseTensor<cpu, dimension, DType, cpu, dimension, DType> {
+	
+	XMATRIX_INLINE AbsTensor(Tensor<cpu, dimension, DType> &src) 
+		: UnaryElementwiseTensor<cpu, dimension, DType, cpu, dimension, DType>(src) {}
+
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string src;
+		if (!EmitOperand(code, index, src))
+			return false;
+		expr = "fabs(" + src + ")";
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Kernel(const DType *src, DType *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = fabs(src[i]);
+	}
+
+	XMATRIX_INLINE virtual void Adjoint(const DType *src, const DType *dest, const DType *grad, 
+		DType *gradSrc, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			gradSrc[i] += (src[i] < 0)? -grad[i] : grad[i];
+	}
+};
+
+template<size_t dimension>
+struct AbsTensor<cpu, dimension, int, cpu, dimension, int>
+	: public UnaryElementwiseTensor<cpu, dimension, int, cpu, dimension, int> {
+	
+	XMATRIX_INLINE AbsTensor(Tensor<cpu, dimension, int> &src) 
+		: UnaryElementwiseTensor<cpu, dimension, int, cpu, dimension, int>(src) {}
+
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string src;
+		if (!EmitOperand(code, index, src))
+			return false;
+		expr = "abs(" + src + ")";
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Kernel(const int *src, int *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = abs(src[i]);
 	}
 };
 
@@ -514,19 +2026,23 @@ struct AbsTensor<cpu, dimension, int, cpu, dimension, int>
 */
 template<size_t dimension, typename DType>
 struct FloorTensor<cpu, dimension, int, cpu, dimension, DType>
-	: public UnaryDeducedTensor<cpu, dimension, int, cpu, dimension, DType> {
+	: public UnaryElementwiseTensor<cpu, dimension, int, cpu, dimension, DType> {
 	
 	XMATRIX_INLINE FloorTensor(Tensor<cpu, dimension, DType> &src) 
-		: UnaryDeducedTensor<cpu, dimension, int, cpu, dimension, DType>(src) {}
+		: UnaryElementwiseTensor<cpu, dimension, int, cpu, dimension, DType>(src) {}
+
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string src;
+		if (!EmitOperand(code, index, src))
+			return false;
+		expr = "floor(" + src + ")";
+		return true;
+	}
 
-	XMATRIX_INLINE void virtual Update() {
-		if (!_isUpdated) {
-			UnaryDeducedTensor::Update();
-			AllocMem(_src._shape);
-			for (size_t i = 0; i < _shape.getSize(); i++)
-	#pragma warning(disable: 4244)	
-					_ptr[i] = (int)floor(_src._ptr[i]);
-		}
+	XMATRIX_INLINE virtual void Kernel(const DType *src, int *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
+#pragma warning(disable: 4244)	
+			dest[i] = (int)floor(src[i]);
 	}
 };
 
@@ -535,19 +2051,23 @@ struct FloorTensor<cpu, dimension, int, cpu, dimension, DType>
 */
 template<size_t dimension, typename DType>
 struct CeilTensor<cpu, dimension, int, cpu, dimension, DType>
-	: public UnaryDeducedTensor<cpu, dimension, int, cpu, dimension, DType> {
+	: public UnaryElementwiseTensor<cpu, dimension, int, cpu, dimension, DType> {
 	
 	XMATRIX_INLINE CeilTensor(Tensor<cpu, dimension, DType> &src) 
-		: UnaryDeducedTensor<cpu, dimension, int, cpu, dimension, DType>(src) {}
+		: UnaryElementwiseTensor<cpu, dimension, int, cpu, dimension, DType>(src) {}
+
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string src;
+		if (!EmitOperand(code, index, src))
+			return false;
+		expr = "ceil(" + src + ")";
+		return true;
+	}
 
-	XMATRIX_INLINE void virtual Update() {
-		if (!_isUpdated) {
-			UnaryDeducedTensor::Update();
-			AllocMem(_src._shape);
-			for (size_t i = 0; i < _shape.getSize(); i++)
+	XMATRIX_INLINE virtual void Kernel(const DType *src, int *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
 #pragma warning(disable: 4244)	
-				_ptr[i] = (int)ceil(_src._ptr[i]);
-		}
+			dest[i] = (int)ceil(src[i]);
 	}
 };
 
@@ -556,24 +2076,28 @@ struct CeilTensor<cpu, dimension, int, cpu, dimension, DType>
 */
 template<size_t dimension, typename DType>
 struct RoundTensor<cpu, dimension, int, cpu, dimension, DType>
-	: public UnaryDeducedTensor<cpu, dimension, int, cpu, dimension, DType> {
+	: public UnaryElementwiseTensor<cpu, dimension, int, cpu, dimension, DType> {
 	
 	XMATRIX_INLINE RoundTensor(Tensor<cpu, dimension, DType> &src) 
-		: UnaryDeducedTensor<cpu, dimension, int, cpu, dimension, DType>(src) {}
+		: UnaryElementwiseTensor<cpu, dimension, int, cpu, dimension, DType>(src) {}
+
+	XMATRIX_INLINE virtual bool Emit(JitCode &code, const std::string &index, std::string &expr) {
+		std::string src;
+		if (!EmitOperand(code, index, src))
+			return false;
+		expr = "round(" + src + ")";
+		return true;
+	}
 
-	XMATRIX_INLINE void virtual Update() {
-		if (!_isUpdated) {
-			UnaryDeducedTensor::Update();
-			AllocMem(_src._shape);
-			for (size_t i = 0; i < _shape.getSize(); i++)
+	XMATRIX_INLINE virtual void Kernel(const DType *src, int *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
 #ifdef _MSC_VER
 #pragma warning(disable: 4244)	
-				_ptr[i] = (int)floor(_src._ptr[i] + 0.5);
+			dest[i] = (int)floor(src[i] + 0.5);
 #else
 #pragma warning(disable: 4244)	
-				_ptr[i] = (int)round(_src._ptr[i]);
+			dest[i] = (int)round(src[i]);
 #endif
-		}
 	}
 };
 
@@ -582,23 +2106,17 @@ struct RoundTensor<cpu, dimension, int, cpu, dimension, DType>
 */
 template<size_t dimension, typename DType_lhs, typename DType_rhs>
 struct GreaterThanTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, dimension, DType_rhs> 
-	: public BinaryDeducedTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, dimension, DType_rhs> {
+	: public BinaryElementwiseTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, dimension, DType_rhs> {
 
 	XMATRIX_INLINE GreaterThanTensor(
 		Tensor<cpu, dimension, DType_lhs> &lhs, 
 		Tensor<cpu, dimension, DType_rhs> &rhs)
-	: BinaryDeducedTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, dimension, DType_rhs>
+	: BinaryElementwiseTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, dimension, DType_rhs>
 		(lhs, rhs) { }
 
-	XMATRIX_INLINE virtual void Update() {
-		if (!_isUpdated) {
-			BinaryDeducedTensor::Update();
-			assert(_lhs._shape == _rhs._shape);
-			AllocMem(_lhs._shape);
-
-			for (size_t i = 0; i < _shape.getSize(); i++)
-				_ptr[i] = (_lhs._ptr[i] > _rhs._ptr[i])? 1 : 0;
-		}
+	XMATRIX_INLINE virtual void Kernel(const DType_lhs *lhs, const DType_rhs *rhs, int *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = (lhs[i] > rhs[i])? 1 : 0;
 	}
 };
 
@@ -607,21 +2125,17 @@ struct GreaterThanTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, di
 */
 template<size_t dimension, typename DType_lhs, typename DType_rhs>
 struct GreaterThanTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, 0, DType_rhs> 
-	: public BinaryDeducedTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, 0, DType_rhs> {
+	: public BinaryElementwiseTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, 0, DType_rhs> {
 
 	XMATRIX_INLINE GreaterThanTensor(
 		Tensor<cpu, dimension, DType_lhs> &lhs, 
 		Tensor<cpu, 0, DType_rhs> &rhs)
-	: BinaryDeducedTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, 0, DType_rhs>
+	: BinaryElementwiseTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, 0, DType_rhs>
 		(lhs, rhs) {}
 
-	XMATRIX_INLINE void virtual Update() {
-		if (!_isUpdated) {
-			BinaryDeducedTensor::Update();
-			AllocMem(_lhs._shape);
-			for (size_t i=0; i<_lhs._shape.getSize(); i++)
-				_ptr[i] = (_lhs._ptr[i] > _rhs._ptr[0]) ? 1 : 0;
-		}
+	XMATRIX_INLINE virtual void Kernel(const DType_lhs *lhs, const DType_rhs *rhs, int *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = (lhs[i] > rhs[0])? 1 : 0;
 	}
 };
 
@@ -630,21 +2144,17 @@ struct GreaterThanTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, 0,
 */
 template<size_t dimension, typename DType_lhs, typename DType_rhs>
 struct GreaterThanTensor<cpu, dimension, int, cpu, 0, DType_lhs, cpu, dimension, DType_rhs> 
-	: public BinaryDeducedTensor<cpu, dimension, int, cpu, 0, DType_lhs, cpu, dimension, DType_rhs> {
+	: public BinaryElementwiseTensor<cpu, dimension, int, cpu, 0, DType_lhs, cpu, dimension, DType_rhs> {
 
 	XMATRIX_INLINE GreaterThanTensor(
 		Tensor<cpu, 0, DType_lhs> &lhs, 
 		Tensor<cpu, dimension, DType_rhs> &rhs)
-	: BinaryDeducedTensor<cpu, dimension, int, cpu, 0, DType_lhs, cpu, dimension, DType_rhs>
+	: BinaryElementwiseTensor<cpu, dimension, int, cpu, 0, DType_lhs, cpu, dimension, DType_rhs>
 		(lhs, rhs) {}
 
-	XMATRIX_INLINE void virtual Update() {
-		if (!_isUpdated) {
-			BinaryDeducedTensor::Update();
-			AllocMem(_rhs._shape);
-			for (size_t i=0; i<_rhs._shape.getSize(); i++)
-				_ptr[i] = (_lhs._ptr[0] > _rhs._ptr[i]) ? 1 : 0;
-		}
+	XMATRIX_INLINE virtual void Kernel(const DType_lhs *lhs, const DType_rhs *rhs, int *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = (lhs[0] > rhs[i])? 1 : 0;
 	}
 };
 
@@ -653,20 +2163,16 @@ struct GreaterThanTensor<cpu, dimension, int, cpu, 0, DType_lhs, cpu, dimension,
 */
 template<typename DType_lhs, typename DType_rhs>
 struct GreaterThanTensor<cpu, 0, int, cpu, 0, DType_lhs, cpu, 0, DType_rhs> 
-	: public BinaryDeducedTensor<cpu, 0, int, cpu, 0, DType_lhs, cpu, 0, DType_rhs> {
+	: public BinaryElementwiseTensor<cpu, 0, int, cpu, 0, DType_lhs, cpu, 0, DType_rhs> {
 
 	XMATRIX_INLINE GreaterThanTensor(
 		Tensor<cpu, 0, DType_lhs> &lhs, 
 		Tensor<cpu, 0, DType_rhs> &rhs)
-	: BinaryDeducedTensor<cpu, 0, int, cpu, 0, DType_lhs, cpu, 0, DType_rhs>
+	: BinaryElementwiseTensor<cpu, 0, int, cpu, 0, DType_lhs, cpu, 0, DType_rhs>
 		(lhs, rhs) {}
 
-	XMATRIX_INLINE void virtual Update() {
-		if (!_isUpdated) {
-			BinaryDeducedTensor::Update();
-			AllocMem(_rhs._shape);
-			_ptr[0] = (_lhs._ptr[0] > _rhs._ptr[0]) ? 1 : 0;
-		}
+	XMATRIX_INLINE virtual void Kernel(const DType_lhs *lhs, const DType_rhs *rhs, int *dest, size_t length) {
+		dest[0] = (lhs[0] > rhs[0])? 1 : 0;
 	}
 };
 
@@ -675,23 +2181,17 @@ struct GreaterThanTensor<cpu, 0, int, cpu, 0, DType_lhs, cpu, 0, DType_rhs>
 */
 template<size_t dimension, typename DType_lhs, typename DType_rhs>
 struct EqualTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, dimension, DType_rhs> 
-	: public BinaryDeducedTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, dimension, DType_rhs> {
+	: public BinaryElementwiseTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, dimension, DType_rhs> {
 
 	XMATRIX_INLINE EqualTensor(
 		Tensor<cpu, dimension, DType_lhs> &lhs, 
 		Tensor<cpu, dimension, DType_rhs> &rhs)
-	: BinaryDeducedTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, dimension, DType_rhs>
+	: BinaryElementwiseTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, dimension, DType_rhs>
 		(lhs, rhs) { }
 
-	XMATRIX_INLINE virtual void Update() {
-		if (!_isUpdated) {
-			BinaryDeducedTensor::Update();
-			assert(_lhs._shape == _rhs._shape);
-			AllocMem(_lhs._shape);
-
-			for (size_t i = 0; i < _shape.getSize(); i++)
-				_ptr[i] = (_lhs._ptr[i] == _rhs._ptr[i])? 1 : 0;
-		}
+	XMATRIX_INLINE virtual void Kernel(const DType_lhs *lhs, const DType_rhs *rhs, int *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = (lhs[i] == rhs[i])? 1 : 0;
 	}
 };
 
@@ -700,21 +2200,17 @@ struct EqualTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, dimensio
 */
 template<size_t dimension, typename DType_lhs, typename DType_rhs>
 struct EqualTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, 0, DType_rhs>
-	: public BinaryDeducedTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, 0, DType_rhs> {
+	: public BinaryElementwiseTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, 0, DType_rhs> {
 
 	XMATRIX_INLINE EqualTensor(
 		Tensor<cpu, dimension, DType_lhs> &lhs, 
 		Tensor<cpu, 0, DType_rhs> &rhs)
-	: BinaryDeducedTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, 0, DType_rhs>
+	: BinaryElementwiseTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, 0, DType_rhs>
 		(lhs, rhs) {}
 
-	XMATRIX_INLINE void virtual Update() {
-		if (!_isUpdated) {
-			BinaryDeducedTensor::Update();
-			AllocMem(_lhs._shape);
-			for (size_t i=0; i<_lhs._shape.getSize(); i++)
-				_ptr[i] = (_lhs._ptr[i] == _rhs._ptr[0]) ? 1 : 0;
-		}
+	XMATRIX_INLINE virtual void Kernel(const DType_lhs *lhs, const DType_rhs *rhs, int *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = (lhs[i] == rhs[0])? 1 : 0;
 	}
 };
 
@@ -723,21 +2219,17 @@ struct EqualTensor<cpu, dimension, int, cpu, dimension, DType_lhs, cpu, 0, DType
 */
 template<size_t dimension, typename DType_lhs, typename DType_rhs>
 struct EqualTensor<cpu, dimension, int, cpu, 0, DType_lhs, cpu, dimension, DType_rhs>
-	: public BinaryDeducedTensor<cpu, dimension, int, cpu, 0, DType_lhs, cpu, dimension, DType_rhs> {
+	: public BinaryElementwiseTensor<cpu, dimension, int, cpu, 0, DType_lhs, cpu, dimension, DType_rhs> {
 
 	XMATRIX_INLINE EqualTensor(
 		Tensor<cpu, 0, DType_lhs> &lhs, 
 		Tensor<cpu, dimension, DType_rhs> &rhs)
-	: BinaryDeducedTensor<cpu, dimension, int, cpu, 0, DType_lhs, cpu, dimension, DType_rhs>
+	: BinaryElementwiseTensor<cpu, dimension, int, cpu, 0, DType_lhs, cpu, dimension, DType_rhs>
 		(lhs, rhs) {}
 
-	XMATRIX_INLINE void virtual Update() {
-		if (!_isUpdated) {
-			BinaryDeducedTensor::Update();
-			AllocMem(_rhs._shape);
-			for (size_t i=0; i<_rhs._shape.getSize(); i++)
-				_ptr[i] = (_lhs._ptr[0] == _rhs._ptr[i]) ? 1 : 0;
-		}
+	XMATRIX_INLINE virtual void Kernel(const DType_lhs *lhs, const DType_rhs *rhs, int *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = (lhs[0] == rhs[i])? 1 : 0;
 	}
 };
 
@@ -746,20 +2238,16 @@ struct EqualTensor<cpu, dimension, int, cpu, 0, DType_lhs, cpu, dimension, DType
 */
 template<typename DType_lhs, typename DType_rhs>
 struct EqualTensor<cpu, 0, int, cpu, 0, DType_lhs, cpu, 0, DType_rhs> 
-	: public BinaryDeducedTensor<cpu, 0, int, cpu, 0, DType_lhs, cpu, 0, DType_rhs> {
+	: public BinaryElementwiseTensor<cpu, 0, int, cpu, 0, DType_lhs, cpu, 0, DType_rhs> {
 
 	XMATRIX_INLINE EqualTensor(
 		Tensor<cpu, 0, DType_lhs> &lhs, 
 		Tensor<cpu, 0, DType_rhs> &rhs)
-	: BinaryDeducedTensor<cpu, 0, int, cpu, 0, DType_lhs, cpu, 0, DType_rhs>
+	: BinaryElementwiseTensor<cpu, 0, int, cpu, 0, DType_lhs, cpu, 0, DType_rhs>
 		(lhs, rhs) {}
 
-	XMATRIX_INLINE void virtual Update() {
-		if (!_isUpdated) {
-			BinaryDeducedTensor::Update();
-			AllocMem(_rhs._shape);
-			_ptr[0] = (_lhs._ptr[0] == _rhs._ptr[0]) ? 1 : 0;
-		}
+	XMATRIX_INLINE virtual void Kernel(const DType_lhs *lhs, const DType_rhs *rhs, int *dest, size_t length) {
+		dest[0] = (lhs[0] == rhs[0])? 1 : 0;
 	}
 };
 
@@ -768,23 +2256,17 @@ struct EqualTensor<cpu, 0, int, cpu, 0, DType_lhs, cpu, 0, DType_rhs>
 */
 template<size_t dimension>
 struct AndTensor<cpu, dimension, int, cpu, dimension, int, cpu, dimension, int> 
-	: public BinaryDeducedTensor<cpu, dimension, int, cpu, dimension, int, cpu, dimension, int> {
+	: public BinaryElementwiseTensor<cpu, dimension, int, cpu, dimension, int, cpu, dimension, int> {
 
 	XMATRIX_INLINE AndTensor(
 		Tensor<cpu, dimension, int> &lhs, 
 		Tensor<cpu, dimension, int> &rhs)
-	: BinaryDeducedTensor<cpu, dimension, int, cpu, dimension, int, cpu, dimension, int>
+	: BinaryElementwiseTensor<cpu, dimension, int, cpu, dimension, int, cpu, dimension, int>
 		(lhs, rhs) { }
 
-	XMATRIX_INLINE virtual void Update() {
-		if (!_isUpdated) {
-			BinaryDeducedTensor::Update();
-			assert(_lhs._shape == _rhs._shape);
-			AllocMem(_lhs._shape);
-
-			for (size_t i = 0; i < _shape.getSize(); i++)
-				_ptr[i] = (_lhs._ptr[i] && _rhs._ptr[i]) ? 1:0;
-		}
+	XMATRIX_INLINE virtual void Kernel(const int *lhs, const int *rhs, int *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = (lhs[i] && rhs[i])? 1 : 0;
 	}
 };
 
@@ -793,23 +2275,17 @@ struct AndTensor<cpu, dimension, int, cpu, dimension, int, cpu, dimension, int>
 */
 template<size_t dimension>
 struct OrTensor<cpu, dimension, int, cpu, dimension, int, cpu, dimension, int> 
-	: public BinaryDeducedTensor<cpu, dimension, int, cpu, dimension, int, cpu, dimension, int> {
+	: public BinaryElementwiseTensor<cpu, dimension, int, cpu, dimension, int, cpu, dimension, int> {
 
 	XMATRIX_INLINE OrTensor(
 		Tensor<cpu, dimension, int> &lhs, 
 		Tensor<cpu, dimension, int> &rhs)
-	: BinaryDeducedTensor<cpu, dimension, int, cpu, dimension, int, cpu, dimension, int>
+	: BinaryElementwiseTensor<cpu, dimension, int, cpu, dimension, int, cpu, dimension, int>
 		(lhs, rhs) { }
 
-	XMATRIX_INLINE virtual void Update() {
-		if (!_isUpdated) {
-			BinaryDeducedTensor::Update();
-			assert(_lhs._shape == _rhs._shape);
-			AllocMem(_lhs._shape);
-
-			for (size_t i = 0; i < _shape.getSize(); i++)
-				_ptr[i] = (_lhs._ptr[i] || _rhs._ptr[i]) ? 1:0;
-		}
+	XMATRIX_INLINE virtual void Kernel(const int *lhs, const int *rhs, int *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = (lhs[i] || rhs[i])? 1 : 0;
 	}
 };
 
@@ -818,18 +2294,14 @@ struct OrTensor<cpu, dimension, int, cpu, dimension, int, cpu, dimension, int>
 */
 template<size_t dimension, typename DType>
 struct NotTensor<cpu, dimension, int, cpu, dimension, DType>
-	: public UnaryDeducedTensor<cpu, dimension, DType, cpu, dimension, DType> {
+	: public UnaryElementwiseTensor<cpu, dimension, int, cpu, dimension, DType> {
 	
 	XMATRIX_INLINE NotTensor(Tensor<cpu, dimension, DType> &src) 
-		: UnaryDeducedTensor<cpu, dimension, DType, cpu, dimension, DType>(src) {}
+		: UnaryElementwiseTensor<cpu, dimension, int, cpu, dimension, DType>(src) {}
 
-	XMATRIX_INLINE void virtual Update() {
-		if (!_isUpdated) {
-			UnaryDeducedTensor::Update();
-			AllocMem(_src._shape);
-			for (size_t i = 0; i < _shape.getSize(); i++)
-				_ptr[i] = (_src._ptr[i] > 0)? 0 : 1;
-		}
+	XMATRIX_INLINE virtual void Kernel(const DType *src, int *dest, size_t length) {
+		for (size_t i = 0; i < length; i++)
+			dest[i] = (src[i] > 0)? 0 : 1;
 	}
 };
 
@@ -838,27 +2310,43 @@ struct NotTensor<cpu, dimension, int, cpu, dimension, DType>
 */
 template<size_t dimension, typename DType>
 struct SignTensor<cpu, dimension, int, cpu, dimension, DType>
-	: public UnaryDeducedTensor<cpu, dimension, DType, cpu, dimension, DType> {
+	: public UnaryElementwiseTensor<cpu, dimension, int, cpu, dimension, DType> {
 	
 	XMATRIX_INLINE SignTensor(Tensor<cpu, dimension, DType> &src) 
-		: UnaryDeducedTensor<cpu, dimension, DType, cpu, dimension, DType>(src) {}
-
-	XMATRIX_INLINE void virtual Update() {
-		if (!_isUpdated) {
-			UnaryDeducedTensor::Update();
-			AllocMem(_src._shape);
-			for (size_t i = 0; i < _shape.getSize(); i++) {
-				if (_src._ptr[i] > 0)
-					_ptr[i] = 1;
-				else if (_src._ptr[i] == 0)
-					_ptr[i] = 0;
-				else
-					_ptr[i] = -1;
-			}
+		: UnaryElementwiseTensor<cpu, dimension, int, cpu, dimension, DType>(src) {}
+
+	XMATRIX_INLINE virtual void Kernel(const DType *src, int *dest, size_t length) {
+		for (size_t i = 0; i < length; i++) {
+			if (src[i] > 0)
+				dest[i] = 1;
+			else if (src[i] == 0)
+				dest[i] = 0;
+			else
+				dest[i] = -1;
 		}
 	}
 };
 
+/**
+* Strided Sum: sum of all elements, row by row for strided views
+*/
+template<size_t dimension, typename DType>
+XMATRIX_INLINE DType StridedSum(const Tensor<cpu, dimension, DType> &t) {
+	if (t.IsContiguous())
+		return Sum(t._shape.getSize(), t._ptr, 1);
+	if (dimension == 1)
+		return Sum(t._shape[0], t._ptr, t._stride);
+
+	// rows _stride apart with _innerStride between elements, only slices of
+	// matrices leave gaps (see SliceTensor)
+	assert(dimension <= 2 || t.IsDense());
+	size_t inner = t._shape.SubShape().getSize();
+	DType sum = 0;
+	for (size_t i = 0; i < t._shape[0]; i++)
+		sum += Sum(inner, t._ptr + i * t._stride, t._innerStride);
+	return sum;
+}
+
 /**
 * Sum Opeartor
 */
@@ -873,11 +2361,32 @@ struct SumTensor<cpu, 0, DType, cpu, dimension, DType>
 		if (!_isUpdated) {
 			UnaryDeducedTensor::Update();
 			AllocMem();
-			_ptr[0] = 0;
-			for (size_t i = 0; i < _src._shape.getSize(); i++)
-					_ptr[0] += _src._ptr[i];
+			Execute();
 		}
 	}
+
+	XMATRIX_INLINE virtual void Execute() {
+		_ptr[0] = StridedSum(_src);
+	}
+
+	XMATRIX_INLINE virtual bool EmitKernel(JitCode &code, std::string &body) {
+		std::string src;
+		const char *type = CTypeName<DType>();
+		if (type == NULL || !code.Operand(_src, "i", src))
+			return false;
+		std::ostringstream os;
+		os << "\t" << type << " sum = 0;\n"
+			<< "\tfor (size_t i = 0; i < " << _src._shape.getSize() << "; i++)\n"
+			<< "\t\tsum += " << src << ";\n"
+			<< "\t" << code.Argument(*this, type) << "[0] = sum;\n";
+		body = os.str();
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Backward() {
+		for (size_t i = 0; i < _src._shape.getSize(); i++)
+			_src._grad[i] += _grad[0];
+	}
 };
 
 /**
@@ -894,12 +2403,108 @@ struct MeanTensor<cpu, 0, DType, cpu, dimension, DType>
 		if (!_isUpdated) {
 			UnaryDeducedTensor::Update();
 			AllocMem();
-			_ptr[0] = 0;
-			for (size_t i = 0; i < _src._shape.getSize(); i++)
-					_ptr[0] += _src._ptr[i];
-			_ptr[0] /= _shape.getSize();
+			Execute();
 		}
 	}
+
+	XMATRIX_INLINE virtual void Execute() {
+		_ptr[0] = StridedSum(_src) / _src._shape.getSize();
+	}
+
+	XMATRIX_INLINE virtual bool EmitKernel(JitCode &code, std::string &body) {
+		std::string src;
+		const char *type = CTypeName<DType>();
+		if (type == NULL || !code.Operand(_src, "i", src))
+			return false;
+		std::ostringstream os;
+		os << "\t" << type << " sum = 0;\n"
+			<< "\tfor (size_t i = 0; i < " << _src._shape.getSize() << "; i++)\n"
+			<< "\t\tsum += " << src << ";\n"
+			<< "\t" << code.Argument(*this, type) << "[0] = sum / " << _src._shape.getSize() << ";\n";
+		body = os.str();
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Backward() {
+		for (size_t i = 0; i < _src._shape.getSize(); i++)
+			_src._grad[i] += _grad[0] / _src._shape.getSize();
+	}
+};
+
+/**
+* Batch Sum Opeartor: sum over all axes but the leading batch axis
+*/
+template<size_t dimension, typename DType>
+struct SumTensor<cpu, 1, DType, cpu, dimension, DType>
+	: public UnaryDeducedTensor<cpu, 1, DType, cpu, dimension, DType> {
+	
+	XMATRIX_INLINE SumTensor(Tensor<cpu, dimension, DType> &src) 
+		: UnaryDeducedTensor<cpu, 1, DType, cpu, dimension, DType>(src) {}
+
+	XMATRIX_INLINE void virtual Update() {
+		if (!_isUpdated) {
+			UnaryDeducedTensor::Update();
+			CheckShape();
+			AllocMem(_shape);
+			Execute();
+		}
+	}
+
+	XMATRIX_INLINE virtual bool InferShape() {
+		_shape = Shape1(_src._shape[0]);
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Execute() {
+		assert(dimension <= 2 || _src.IsDense()); // see StridedSum
+		size_t inner = _src._shape.SubShape().getSize();
+		for (size_t i = 0; i < _shape[0]; i++)
+			_ptr[i] = Sum(inner, _src._ptr + i * _src._stride, _src._innerStride);
+	}
+
+	XMATRIX_INLINE virtual void Backward() {
+		size_t inner = _src._shape.SubShape().getSize();
+		for (size_t i = 0; i < _src._shape.getSize(); i++)
+			_src._grad[i] += _grad[i / inner];
+	}
+};
+
+/**
+* Batch Mean Opeartor: mean over all axes but the leading batch axis
+*/
+template<size_t dimension, typename DType>
+struct MeanTensor<cpu, 1, DType, cpu, dimension, DType>
+	: public UnaryDeducedTensor<cpu, 1, DType, cpu, dimension, DType> {
+	
+	XMATRIX_INLINE MeanTensor(Tensor<cpu, dimension, DType> &src) 
+		: UnaryDeducedTensor<cpu, 1, DType, cpu, dimension, DType>(src) {}
+
+	XMATRIX_INLINE void virtual Update() {
+		if (!_isUpdated) {
+			UnaryDeducedTensor::Update();
+			CheckShape();
+			AllocMem(_shape);
+			Execute();
+		}
+	}
+
+	XMATRIX_INLINE virtual bool InferShape() {
+		_shape = Shape1(_src._shape[0]);
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Execute() {
+		assert(dimension <= 2 || _src.IsDense()); // see StridedSum
+		size_t inner = _src._shape.SubShape().getSize();
+		for (size_t i = 0; i < _shape[0]; i++)
+			_ptr[i] = Sum(inner, _src._ptr + i * _src._stride, _src._innerStride) / inner;
+	}
+
+	XMATRIX_INLINE virtual void Backward() {
+		size_t inner = _src._shape.SubShape().getSize();
+		for (size_t i = 0; i < _src._shape.getSize(); i++)
+			_src._grad[i] += _grad[i / inner] / inner;
+	}
 };
 
 } // namespace xmatrix
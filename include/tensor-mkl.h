@@ -0,0 +1,261 @@
+#ifndef XMATRIX_TENSOR_MKL_H_
+#define XMATRIX_TENSOR_MKL_H_
+
+/**
+* CBLAS Backend: the cpu tensors of tensor-cpu.h with their float and double
+* kernels routed to an installed CBLAS (MKL, OpenBLAS, BLIS or the reference
+* implementation). Every routine can be switched back to the built-in kernel
+* by defining its XMATRIX_CBLAS_* flag to 0; other element types always use
+* the built-in kernels
+*/
+#ifndef XMATRIX_CBLAS_HEADER
+#define XMATRIX_CBLAS_HEADER <cblas.h>
+#endif
+#ifndef XMATRIX_CBLAS_GEMM
+#define XMATRIX_CBLAS_GEMM 1
+#endif
+#ifndef XMATRIX_CBLAS_GEMV
+#define XMATRIX_CBLAS_GEMV 1
+#endif
+#ifndef XMATRIX_CBLAS_DOT
+#define XMATRIX_CBLAS_DOT 1
+#endif
+#ifndef XMATRIX_CBLAS_SUM
+#define XMATRIX_CBLAS_SUM 1
+#endif
+// cblas_?omatcopy is an extension shipped by OpenBLAS
+#ifndef XMATRIX_CBLAS_OMATCOPY
+#define XMATRIX_CBLAS_OMATCOPY 0
+#endif
+
+#include "common.h"
+#include "tensor.h"
+#include "tensor-cpu.h"
+
+#include XMATRIX_CBLAS_HEADER
+
+namespace xmatrix {
+
+/**
+* CBLAS Layout: row-major leading dimension and transpose flag of a matrix
+* with row stride rs and column stride cs, false if neither is unit
+*/
+XMATRIX_INLINE bool CblasLayout(size_t rows, size_t cols, size_t rs, size_t cs,
+	CBLAS_TRANSPOSE &trans, size_t &ld) {
+	if (cs == 1 || cols == 1) {
+		trans = CblasNoTrans;
+		ld = (rs > cols)? rs : cols;
+		return true;
+	}
+	if (rs == 1 || rows == 1) {
+		trans = CblasTrans;
+		ld = (cs > rows)? cs : rows;
+		return true;
+	}
+	return false;
+}
+
+/**
+* CBLAS Pack: contiguous row-major copy of a matrix with arbitrary strides
+*/
+template<typename DType, int tag>
+XMATRIX_INLINE const DType *CblasPack(size_t rows, size_t cols, const DType *a, size_t rs, size_t cs) {
+	DType *buffer = GemmBuffer<DType, tag>(rows * cols);
+	for (size_t i = 0; i < rows; i++)
+		for (size_t j = 0; j < cols; j++)
+			buffer[i * cols + j] = a[i * rs + j * cs];
+	return buffer;
+}
+
+/**
+* CBLAS Routines: the s/d routines selected by element type
+*/
+template<typename DType>
+struct Cblas;
+
+template<>
+struct Cblas<float> {
+	XMATRIX_INLINE static void Gemm(CBLAS_TRANSPOSE ta, CBLAS_TRANSPOSE tb, int m, int n, int k,
+		const float *a, int lda, const float *b, int ldb, float *c, int ldc) {
+		cblas_sgemm(CblasRowMajor, ta, tb, m, n, k, 1, a, lda, b, ldb, 0, c, ldc);
+	}
+	XMATRIX_INLINE static void Gemv(CBLAS_TRANSPOSE ta, int m, int n,
+		const float *a, int lda, const float *x, int incx, float *y) {
+		cblas_sgemv(CblasRowMajor, ta, m, n, 1, a, lda, x, incx, 0, y, 1);
+	}
+	XMATRIX_INLINE static float Dot(int n, const float *x, int incx, const float *y, int incy) {
+		return cblas_sdot(n, x, incx, y, incy);
+	}
+#if XMATRIX_CBLAS_OMATCOPY == 1
+	XMATRIX_INLINE static void Transpose(int m, int n, const float *a, int lda, float *b, int ldb) {
+		cblas_somatcopy(CblasRowMajor, CblasTrans, m, n, 1, a, lda, b, ldb);
+	}
+#endif
+};
+
+template<>
+struct Cblas<double> {
+	XMATRIX_INLINE static void Gemm(CBLAS_TRANSPOSE ta, CBLAS_TRANSPOSE tb, int m, int n, int k,
+		const double *a, int lda, const double *b, int ldb, double *c, int ldc) {
+		cblas_dgemm(CblasRowMajor, ta, tb, m, n, k, 1, a, lda, b, ldb, 0, c, ldc);
+	}
+	XMATRIX_INLINE static void Gemv(CBLAS_TRANSPOSE ta, int m, int n,
+		const double *a, int lda, const double *x, int incx, double *y) {
+		cblas_dgemv(CblasRowMajor, ta, m, n, 1, a, lda, x, incx, 0, y, 1);
+	}
+	XMATRIX_INLINE static double Dot(int n, const double *x, int incx, const double *y, int incy) {
+		return cblas_ddot(n, x, incx, y, incy);
+	}
+#if XMATRIX_CBLAS_OMATCOPY == 1
+	XMATRIX_INLINE static void Transpose(int m, int n, const double *a, int lda, double *b, int ldb) {
+		cblas_domatcopy(CblasRowMajor, CblasTrans, m, n, 1, a, lda, b, ldb);
+	}
+#endif
+};
+
+/**
+* CBLAS Gemm: operands without a unit stride are packed first
+*/
+template<typename DType>
+XMATRIX_INLINE void CblasGemm(size_t m, size_t n, size_t k,
+	const DType *a, size_t rsa, size_t csa,
+	const DType *b, size_t rsb, size_t csb,
+	DType *c, size_t rsc) {
+
+	if (m == 0 || n == 0)
+		return;
+	if (k == 0) {
+		for (size_t i = 0; i < m; i++)
+			for (size_t j = 0; j < n; j++)
+				c[i * rsc + j] = 0;
+		return;
+	}
+
+	CBLAS_TRANSPOSE ta, tb;
+	size_t lda, ldb;
+	if (!CblasLayout(m, k, rsa, csa, ta, lda)) {
+		a = CblasPack<DType, 2>(m, k, a, rsa, csa);
+		ta = CblasNoTrans;
+		lda = k;
+	}
+	if (!CblasLayout(k, n, rsb, csb, tb, ldb)) {
+		b = CblasPack<DType, 3>(k, n, b, rsb, csb);
+		tb = CblasNoTrans;
+		ldb = n;
+	}
+	Cblas<DType>::Gemm(ta, tb, (int)m, (int)n, (int)k, a, (int)lda, b, (int)ldb, c, (int)((rsc > n)? rsc : n));
+}
+
+/**
+* CBLAS Gemv: y = B^T x, B transposed or not depending on its layout
+*/
+template<typename DType>
+XMATRIX_INLINE void CblasGemv(size_t k, size_t n,
+	const DType *x, size_t incx,
+	const DType *b, size_t rsb, size_t csb,
+	DType *y) {
+
+	if (n == 0)
+		return;
+	if (k == 0) {
+		for (size_t j = 0; j < n; j++)
+			y[j] = 0;
+		return;
+	}
+
+	CBLAS_TRANSPOSE tb;
+	size_t ldb;
+	if (!CblasLayout(k, n, rsb, csb, tb, ldb)) {
+		b = CblasPack<DType, 3>(k, n, b, rsb, csb);
+		tb = CblasNoTrans;
+		ldb = n;
+	}
+	if (tb == CblasNoTrans)
+		Cblas<DType>::Gemv(CblasTrans, (int)k, (int)n, b, (int)ldb, x, (int)incx, y);
+	else
+		Cblas<DType>::Gemv(CblasNoTrans, (int)n, (int)k, b, (int)ldb, x, (int)incx, y);
+}
+
+/**
+* CBLAS Sum: there is no plain sum in CBLAS (?asum adds absolute values), so
+* the elements are dotted chunk by chunk against a block of ones
+*/
+template<typename DType>
+XMATRIX_INLINE DType CblasSum(size_t n, const DType *x, size_t incx) {
+	const size_t NB = 1024;
+	static const std::vector<DType> ones(NB, (DType)1);
+	DType sum = 0;
+	for (size_t i = 0; i < n; i += NB)
+		sum += Cblas<DType>::Dot((int)((n - i < NB)? n - i : NB), x + i * incx, (int)incx, &ones[0], 1);
+	return sum;
+}
+
+#if XMATRIX_CBLAS_GEMM == 1
+template<>
+XMATRIX_INLINE void Gemm<float, float, float>(size_t m, size_t n, size_t k,
+	const float *a, size_t rsa, size_t csa, const float *b, size_t rsb, size_t csb, float *c, size_t rsc) {
+	CblasGemm(m, n, k, a, rsa, csa, b, rsb, csb, c, rsc);
+}
+
+template<>
+XMATRIX_INLINE void Gemm<double, double, double>(size_t m, size_t n, size_t k,
+	const double *a, size_t rsa, size_t csa, const double *b, size_t rsb, size_t csb, double *c, size_t rsc) {
+	CblasGemm(m, n, k, a, rsa, csa, b, rsb, csb, c, rsc);
+}
+#endif
+
+#if XMATRIX_CBLAS_GEMV == 1
+template<>
+XMATRIX_INLINE void Gemv<float, float, float>(size_t k, size_t n,
+	const float *x, size_t incx, const float *b, size_t rsb, size_t csb, float *y) {
+	CblasGemv(k, n, x, incx, b, rsb, csb, y);
+}
+
+template<>
+XMATRIX_INLINE void Gemv<double, double, double>(size_t k, size_t n,
+	const double *x, size_t incx, const double *b, size_t rsb, size_t csb, double *y) {
+	CblasGemv(k, n, x, incx, b, rsb, csb, y);
+}
+#endif
+
+#if XMATRIX_CBLAS_DOT == 1
+template<>
+XMATRIX_INLINE float Dot<float, float, float>(size_t n, const float *x, size_t incx, const float *y, size_t incy) {
+	return Cblas<float>::Dot((int)n, x, (int)incx, y, (int)incy);
+}
+
+template<>
+XMATRIX_INLINE double Dot<double, double, double>(size_t n, const double *x, size_t incx, const double *y, size_t incy) {
+	return Cblas<double>::Dot((int)n, x, (int)incx, y, (int)incy);
+}
+#endif
+
+#if XMATRIX_CBLAS_SUM == 1
+template<>
+XMATRIX_INLINE float Sum<float>(size_t n, const float *x, size_t incx) {
+	return CblasSum(n, x, incx);
+}
+
+template<>
+XMATRIX_INLINE double Sum<double>(size_t n, const double *x, size_t incx) {
+	return CblasSum(n, x, incx);
+}
+#endif
+
+#if XMATRIX_CBLAS_OMATCOPY == 1
+template<>
+XMATRIX_INLINE void Transpose<float>(size_t m, size_t n, const float *a, size_t rsa, float *b, size_t rsb) {
+	if (m > 0 && n > 0)
+		Cblas<float>::Transpose((int)m, (int)n, a, (int)((rsa > n)? rsa : n), b, (int)((rsb > m)? rsb : m));
+}
+
+template<>
+XMATRIX_INLINE void Transpose<double>(size_t m, size_t n, const double *a, size_t rsa, double *b, size_t rsb) {
+	if (m > 0 && n > 0)
+		Cblas<double>::Transpose((int)m, (int)n, a, (int)((rsa > n)? rsa : n), b, (int)((rsb > m)? rsb : m));
+}
+#endif
+
+} // namespace xmatrix
+
+#endif // XMATRIX_TENSOR_MKL_H_
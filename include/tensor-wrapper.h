@@ -3,19 +3,158 @@
 
 #include "common.h"
 #include "tensor.h"
+#include "graph.h"
 
 namespace xmatrix {
 
+/**
+* Cache Key: operands are identified by their node, parameters by value
+*/
+XMATRIX_INLINE void CacheKey(std::string &key, const AbstractTensor &operand) {
+	const AbstractTensor *node = &operand;
+	key.append((const char *)&node, sizeof(node));
+}
+
+template<typename DType_Param>
+XMATRIX_INLINE typename enable_if<IsElementType<DType_Param>::value>::type CacheKey(std::string &key, const DType_Param &param) {
+	key.append((const char *)&param, sizeof(param));
+}
+
+template<size_t dimension>
+XMATRIX_INLINE void CacheKey(std::string &key, const Shape<dimension> &param) {
+	for (size_t i = 0; i < dimension; i++)
+		CacheKey(key, param[i]);
+}
+
+/**
+* Parameter Key: the parameters of an operator without its operands
+*/
+XMATRIX_INLINE void ParamKey(std::string &key, const AbstractTensor &operand) {}
+
+template<typename DType_Param>
+XMATRIX_INLINE typename enable_if<IsElementType<DType_Param>::value>::type ParamKey(std::string &key, const DType_Param &param) {
+	CacheKey(key, param);
+}
+
+template<size_t dimension>
+XMATRIX_INLINE void ParamKey(std::string &key, const Shape<dimension> &param) {
+	CacheKey(key, param);
+}
+
+/**
+* Scalar leaf holding a literal operand, shared by equal literals while a
+* TensorCache is active
+*/
+template<typename device, typename DType, typename DType_Param>
+XMATRIX_INLINE Tensor<device, 0, DType> *MakeScalar(DType_Param param) {
+	DType value = (DType)param;
+	TensorCache *cache = TensorCache::Active();
+	std::string key;
+	if (cache != NULL) {
+		key = typeid(Tensor<device, 0, DType>).name();
+		CacheKey(key, value);
+		std::unordered_map<std::string, AbstractTensor *>::iterator it = cache->_nodes.find(key);
+		if (it != cache->_nodes.end())
+			return static_cast<Tensor<device, 0, DType> *>(it->second);
+	}
+
+	Tensor<device, 0, DType> *t = NewTensor<Tensor<device, 0, DType> >();
+	t->Input(&value);
+	t->_isConstant = true;
+	if (cache != NULL)
+		t->Cache(cache, key);
+	return t;
+}
+
+/**
+* Constant Operands: clears constant if a tensor operand is not constant
+*/
+XMATRIX_INLINE void IsConstant(bool &constant, const AbstractTensor &operand) {
+	constant = constant && operand._isConstant;
+}
+
+template<typename DType_Param>
+XMATRIX_INLINE typename enable_if<IsElementType<DType_Param>::value>::type IsConstant(bool &constant, const DType_Param &param) {}
+
+template<size_t dimension>
+XMATRIX_INLINE void IsConstant(bool &constant, const Shape<dimension> &param) {}
+
+/**
+* Constant Folding: a scalar node computed from literals only is evaluated
+* once and replaced with a literal, larger ones are evaluated and kept
+*/
+template<typename device, typename DType>
+XMATRIX_INLINE Tensor<device, 0, DType> *Fold(Tensor<device, 0, DType> *node) {
+	AbstractTensor *root = node;
+	Scheduler(&root, 1).Run();
+	DType value = node->_ptr[0];
+	DeleteTensor(node);
+	return MakeScalar<device, DType>(value);
+}
+
+template<typename device, size_t dimension, typename DType>
+XMATRIX_INLINE Tensor<device, dimension, DType> *Fold(Tensor<device, dimension, DType> *node) {
+	AbstractTensor *root = node;
+	Scheduler(&root, 1).Run();
+	node->_isConstant = true;
+	return node;
+}
+
+template<typename device, size_t dimension, typename DType>
+Tensor<device, dimension, DType> *BaseTensor(Tensor<device, dimension, DType> *node);
+
+/**
+* Node factory of the operators: with a TensorCache active, an identical
+* node already built is returned instead of a new one. Nodes of constant
+* operands are folded
+*/
+template<typename Node, typename... Args>
+XMATRIX_INLINE decltype(BaseTensor((Node *)NULL)) MakeTensor(Args &&... args) {
+	typedef decltype(BaseTensor((Node *)NULL)) Result;
+	bool constant = true;
+	int constants[] = { 0, (IsConstant(constant, args), 0)... };
+	(void)constants;
+
+	std::string params;
+	int parameters[] = { 0, (ParamKey(params, args), 0)... };
+	(void)parameters;
+
+	TensorCache *cache = TensorCache::Active();
+	if (cache == NULL) {
+		Result node = NewTensor<Node>(std::forward<Args>(args)...);
+		node->_params = params;
+		node->CheckShape();
+		return constant? Fold(node) : node;
+	}
+
+	std::string key(typeid(Node).name());
+	int expand[] = { 0, (CacheKey(key, args), 0)... };
+	(void)expand;
+
+	std::unordered_map<std::string, AbstractTensor *>::iterator it = cache->_nodes.find(key);
+	if (it != cache->_nodes.end())
+		return static_cast<Result>(it->second);
+	Result node = NewTensor<Node>(std::forward<Args>(args)...);
+	node->_params = params;
+	node->CheckShape();
+	if (constant)
+		node = Fold(node);
+	node->Cache(cache, key);
+	return node;
+}
+
 template<typename device, size_t dimension, typename DType>
 struct Tensor_Wrapper {
 	Tensor<device, dimension, DType> * _tensor;
 
 	XMATRIX_INLINE Tensor_Wrapper() {
-		_tensor = new Tensor<device, dimension, DType>();
+		_tensor = NewTensor<Tensor<device, dimension, DType> >();
+		_tensor->_owners++;
 	}
 
 	XMATRIX_INLINE Tensor_Wrapper(const Tensor_Wrapper<device, dimension, DType> &tensor) {
 		_tensor = tensor._tensor;
+		_tensor->_owners++;
 	}
 
 	XMATRIX_INLINE Tensor_Wrapper(Tensor<device, dimension, DType> tensor) {
@@ -27,36 +166,74 @@ struct Tensor_Wrapper {
 	}
 
 	XMATRIX_INLINE Tensor_Wrapper<device, dimension, DType> &operator=(const Tensor_Wrapper<device, dimension, DType> &tensor) {
-		_tensor->FreeMem();
-		delete _tensor;
-		_tensor = tensor._tensor;
+		if (_tensor != tensor._tensor) {
+			Release();
+			_tensor = tensor._tensor;
+			_tensor->_owners++;
+		}
 
 		return *this;
 	}
 
 	XMATRIX_INLINE Tensor_Wrapper<device, dimension, DType> &operator=(const Tensor<device, dimension, DType> &tensor) {
-		_tensor->FreeMem();
-		delete _tensor;
+		Release();
 		_tensor = &tensor;
 
 		return *this;
 	}
 
 	XMATRIX_INLINE Tensor_Wrapper<device, dimension, DType> &operator=(const Tensor<device, dimension, DType> *tensor) {
-		_tensor->FreeMem();
-		delete _tensor;
+		Release();
 		_tensor = tensor;
 
 		return *this;
 	}
 
 	XMATRIX_INLINE virtual ~Tensor_Wrapper() {
+		Release();
+	}
+
+	/**
+	* The wrappers returned by the operators are allocated from the active
+	* Graph, if any, and go away with it
+	*/
+	XMATRIX_INLINE static void *operator new(size_t size) {
+		Graph *graph = Graph::Active();
+		return (graph != NULL)? graph->Allocate(size) : ::operator new(size);
+	}
+
+	XMATRIX_INLINE static void operator delete(void *p) {
+		for (Graph *graph = Graph::Active(); graph != NULL; graph = graph->_previous)
+			if (graph->Owns(p))
+				return;
+		::operator delete(p);
+	}
+
+	/**
+	* Nodes may be shared between wrappers (see TensorCache), the last
+	* wrapper holding a node destroys it unless a Graph owns the node
+	*/
+	XMATRIX_INLINE void Release() {
+		if (_tensor->_owners > 1 || _tensor->_graph != NULL) {
+			if (_tensor->_owners > 0)
+				_tensor->_owners--;
+			return;
+		}
 		_tensor->FreeMem();
 		delete _tensor;
 	}
 
+	/**
+	* Entry index of the leading dimension, as a view sharing the buffer
+	*/
+	XMATRIX_INLINE Tensor_Wrapper<device, dimension - 1, DType> &operator[](size_t index) {
+		Tensor_Wrapper<device, dimension - 1, DType> *t 
+			= new Tensor_Wrapper<device, dimension - 1, DType>(
+				MakeTensor<SubscriptTensor<device, dimension - 1, DType, device, dimension, DType> >(*_tensor, index));
+		return *t;
+	}
+
 	XMATRIX_INLINE void Load(DType * pData, const Shape<dimension> &shape) {
-		_tensor->FreeMem();
 		_tensor->Input(pData, shape);
 	}
 
@@ -65,8 +242,23 @@ struct Tensor_Wrapper {
 	}
 
 	XMATRIX_INLINE void Update() {
-		if (_tensor != NULL)
-			_tensor->Update();
+		if (_tensor != NULL) {
+			AbstractTensor *root = _tensor;
+			Scheduler(&root, 1).Run();
+		}
+	}
+
+	/**
+	* Gradient of the sum of the elements of this tensor with respect to every
+	* tensor it is computed from, read with Grad(); keep a Tape to
+	* differentiate the same expression repeatedly
+	*/
+	XMATRIX_INLINE void Backward() {
+		Tape(*this).Run();
+	}
+
+	XMATRIX_INLINE DType *Grad() {
+		return _tensor->_grad.empty()? NULL : &_tensor->_grad[0];
 	}
 
 }; // tensor_wrapper
@@ -99,6 +291,7 @@ struct Vector {
 		}
 
 		Shape<1> s = Shape1(length);
+		dest._tensor->Invalid();
 		dest._tensor->AllocMem(s);
 		if (dest._tensor->_isCPU)
 			std::copy(buffer.begin(), buffer.end(), dest._tensor->_ptr);
@@ -131,11 +324,13 @@ struct Matrix {
 		}
 
 		Shape<2> s = Shape2(row, col);
+		dest._tensor->Invalid();
 		dest._tensor->AllocMem(s);
 
 		for(size_t i=0; i<row; i++) {
 			if (dest._tensor->_isCPU) {
 				std::copy(buffer[i].begin(), buffer[i].end(), dest._tensor->_ptr + i * col);
+				std::fill(dest._tensor->_ptr + i * col + buffer[i].size(), dest._tensor->_ptr + (i + 1) * col, DType());
 			}
 		}
 
@@ -148,6 +343,27 @@ XMATRIX_INLINE ostream &operator<<(ostream &os, const Tensor_Wrapper<device, dim
 	os << *tensor._tensor;
 	return os;
 }
+
+/**
+* Same Wrapper: the operand itself if it already has the result type of an
+* operator, NULL otherwise. Lets an operator reduce to its operand, as for
+* x + 0 or x * 1, without changing the type of its result
+*/
+template<typename Result, typename Src>
+struct SameWrapper {
+	XMATRIX_INLINE static Result *Get(Src &src) { return NULL; }
+};
+
+template<typename Result>
+struct SameWrapper<Result, Result> {
+	XMATRIX_INLINE static Result *Get(Result &src) { return &src; }
+};
+
+template<typename Result, typename Src>
+XMATRIX_INLINE Result *Identity(Src &src, bool isIdentity) {
+	return isIdentity? SameWrapper<Result, Src>::Get(src) : NULL;
+}
+
 /**
 * Add Operator
 */
@@ -157,8 +373,34 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() +
 
 	Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() + declval<DType_rhs>())> *t
 		= new Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() + declval<DType_rhs>())>(
-			new AddTensor<device, dimension, decltype(declval<DType_lhs>() + declval<DType_rhs>()), 
-				device, dimension, DType_lhs, device, dimension, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<AddTensor<device, dimension, decltype(declval<DType_lhs>() + declval<DType_rhs>()), 
+				device, dimension, DType_lhs, device, dimension, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
+	return *t;
+}
+
+/**
+* Add Operator: a batch of vectors (the rows of a matrix) and one vector
+* repeated over the batch
+*/
+template<typename device, typename DType_lhs, typename DType_rhs>
+XMATRIX_INLINE Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() + declval<DType_rhs>())> &operator+(
+	Tensor_Wrapper<device, 2, DType_lhs> &lhs, Tensor_Wrapper<device, 1, DType_rhs> &rhs) {
+	
+	Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() + declval<DType_rhs>())> *t 
+		= new Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() + declval<DType_rhs>())>(
+			MakeTensor<AddTensor<device, 2, decltype(declval<DType_lhs>() + declval<DType_rhs>()), 
+				device, 2, DType_lhs, device, 1, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
+	return *t;
+}
+
+template<typename device, typename DType_lhs, typename DType_rhs>
+XMATRIX_INLINE Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() + declval<DType_rhs>())> &operator+(
+	Tensor_Wrapper<device, 1, DType_lhs> &lhs, Tensor_Wrapper<device, 2, DType_rhs> &rhs) {
+	
+	Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() + declval<DType_rhs>())> *t 
+		= new Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() + declval<DType_rhs>())>(
+			MakeTensor<AddTensor<device, 2, decltype(declval<DType_lhs>() + declval<DType_rhs>()), 
+				device, 1, DType_lhs, device, 2, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return *t;
 }
 
@@ -168,8 +410,8 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() +
 	
 	Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() + declval<DType_rhs>())> *t 
 		= new Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() + declval<DType_rhs>())>(
-			new AddTensor<device, dimension, decltype(declval<DType_lhs>() + declval<DType_rhs>()), 
-				device, dimension, DType_lhs, device, 0, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<AddTensor<device, dimension, decltype(declval<DType_lhs>() + declval<DType_rhs>()), 
+				device, dimension, DType_lhs, device, 0, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return *t;
 }
 
@@ -179,8 +421,8 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() +
 	
 	Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() + declval<DType_rhs>())> *t 
 		= new Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() + declval<DType_rhs>())>(
-			new AddTensor<device, dimension, decltype(declval<DType_lhs>() + declval<DType_rhs>()), 
-				device, dimension, DType_rhs, device, 0, DType_lhs>(*(rhs._tensor), *(lhs._tensor)));
+			MakeTensor<AddTensor<device, dimension, decltype(declval<DType_lhs>() + declval<DType_rhs>()), 
+				device, dimension, DType_rhs, device, 0, DType_lhs> >(*(rhs._tensor), *(lhs._tensor)));
 	return *t;
 }
 
@@ -190,8 +432,8 @@ XMATRIX_INLINE Tensor_Wrapper<device, 0, decltype(declval<DType_lhs>() + declval
 	
 	Tensor_Wrapper<device, 0, decltype(declval<DType_lhs>() + declval<DType_rhs>())> *t 
 		= new Tensor_Wrapper<device, 0, decltype(declval<DType_lhs>() + declval<DType_rhs>())>(
-			new AddTensor<device, 0, decltype(declval<DType_lhs>() + declval<DType_rhs>()), 
-				device, 0, DType_lhs, device, 0, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<AddTensor<device, 0, decltype(declval<DType_lhs>() + declval<DType_rhs>()), 
+				device, 0, DType_lhs, device, 0, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return *t;
 }
 
@@ -199,9 +441,12 @@ template<typename device, size_t dimension, typename DType, typename DType_Param
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, decltype(declval<DType>() + declval<DType_Param>())> &operator+(
 	Tensor_Wrapper<device, dimension, DType> &src, DType_Param param) {
 
+	Tensor_Wrapper<device, dimension, decltype(declval<DType>() + declval<DType_Param>())> *same = Identity<Tensor_Wrapper<device, dimension, decltype(declval<DType>() + declval<DType_Param>())> >(src, param == 0);
+	if (same != NULL)
+		return *same;
+
 	Tensor_Wrapper<device, 0, DType_Param> *t 
-		= new Tensor_Wrapper<device, 0, DType_Param>(new Tensor<device, 0, DType_Param>());
-	t->_tensor->Input(&param);
+		= new Tensor_Wrapper<device, 0, DType_Param>(MakeScalar<device, DType_Param>(param));
 	return src + (*t);
 }
 
@@ -209,9 +454,12 @@ template<typename device, size_t dimension, typename DType, typename DType_Param
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, decltype(declval<DType>() + declval<DType_Param>())> &operator+(
 	DType param, Tensor_Wrapper<device, dimension, DType_Param> &src) {
 
+	Tensor_Wrapper<device, dimension, decltype(declval<DType>() + declval<DType_Param>())> *same = Identity<Tensor_Wrapper<device, dimension, decltype(declval<DType>() + declval<DType_Param>())> >(src, param == 0);
+	if (same != NULL)
+		return *same;
+
 	Tensor_Wrapper<device, 0, DType_Param> *t 
-		= new Tensor_Wrapper<device, 0, DType_Param>(new Tensor<device, 0, DType_Param>());
-	t->_tensor->Input(&param);
+		= new Tensor_Wrapper<device, 0, DType_Param>(MakeScalar<device, DType_Param>(param));
 	return *t + src;
 }
 
@@ -224,8 +472,34 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() -
 
 	Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() - declval<DType_rhs>())> *t
 		= new Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() - declval<DType_rhs>())>(
-			new MinusTensor<device, dimension, decltype(declval<DType_lhs>() - declval<DType_rhs>()), 
-				device, dimension, DType_lhs, device, dimension, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<MinusTensor<device, dimension, decltype(declval<DType_lhs>() - declval<DType_rhs>()), 
+				device, dimension, DType_lhs, device, dimension, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
+	return *t;
+}
+
+/**
+* Minus Operator: a batch of vectors (the rows of a matrix) and one vector
+* repeated over the batch
+*/
+template<typename device, typename DType_lhs, typename DType_rhs>
+XMATRIX_INLINE Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() - declval<DType_rhs>())> &operator-(
+	Tensor_Wrapper<device, 2, DType_lhs> &lhs, Tensor_Wrapper<device, 1, DType_rhs> &rhs) {
+	
+	Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() - declval<DType_rhs>())> *t 
+		= new Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() - declval<DType_rhs>())>(
+			MakeTensor<MinusTensor<device, 2, decltype(declval<DType_lhs>() - declval<DType_rhs>()), 
+				device, 2, DType_lhs, device, 1, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
+	return *t;
+}
+
+template<typename device, typename DType_lhs, typename DType_rhs>
+XMATRIX_INLINE Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() - declval<DType_rhs>())> &operator-(
+	Tensor_Wrapper<device, 1, DType_lhs> &lhs, Tensor_Wrapper<device, 2, DType_rhs> &rhs) {
+	
+	Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() - declval<DType_rhs>())> *t 
+		= new Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() - declval<DType_rhs>())>(
+			MakeTensor<MinusTensor<device, 2, decltype(declval<DType_lhs>() - declval<DType_rhs>()), 
+				device, 1, DType_lhs, device, 2, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return *t;
 }
 
@@ -235,8 +509,8 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() -
 	
 	Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() - declval<DType_rhs>())> *t 
 		= new Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() - declval<DType_rhs>())>(
-			new MinusTensor<device, dimension, decltype(declval<DType_lhs>() - declval<DType_rhs>()), 
-				device, dimension, DType_lhs, device, 0, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<MinusTensor<device, dimension, decltype(declval<DType_lhs>() - declval<DType_rhs>()), 
+				device, dimension, DType_lhs, device, 0, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return *t;
 }
 
@@ -246,8 +520,8 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() -
 	
 	Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() - declval<DType_rhs>())> *t 
 		= new Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() - declval<DType_rhs>())>(
-			new MinusTensor<device, dimension, decltype(declval<DType_lhs>() - declval<DType_rhs>()), 
-				device, dimension, DType_rhs, device, 0, DType_lhs>(*(rhs._tensor), *(lhs._tensor)));
+			MakeTensor<MinusTensor<device, dimension, decltype(declval<DType_lhs>() - declval<DType_rhs>()), 
+				device, dimension, DType_rhs, device, 0, DType_lhs> >(*(rhs._tensor), *(lhs._tensor)));
 	return *t;
 }
 
@@ -257,8 +531,8 @@ XMATRIX_INLINE Tensor_Wrapper<device, 0, decltype(declval<DType_lhs>() - declval
 	
 	Tensor_Wrapper<device, 0, decltype(declval<DType_lhs>() - declval<DType_rhs>())> *t 
 		= new Tensor_Wrapper<device, 0, decltype(declval<DType_lhs>() - declval<DType_rhs>())>(
-			new MinusTensor<device, 0, decltype(declval<DType_lhs>() - declval<DType_rhs>()), 
-				device, 0, DType_lhs, device, 0, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<MinusTensor<device, 0, decltype(declval<DType_lhs>() - declval<DType_rhs>()), 
+				device, 0, DType_lhs, device, 0, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return *t;
 }
 
@@ -266,9 +540,12 @@ template<typename device, size_t dimension, typename DType, typename DType_Param
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, decltype(declval<DType>() - declval<DType_Param>())> &operator-(
 	Tensor_Wrapper<device, dimension, DType> &src, DType_Param param) {
 
+	Tensor_Wrapper<device, dimension, decltype(declval<DType>() - declval<DType_Param>())> *same = Identity<Tensor_Wrapper<device, dimension, decltype(declval<DType>() - declval<DType_Param>())> >(src, param == 0);
+	if (same != NULL)
+		return *same;
+
 	Tensor_Wrapper<device, 0, DType_Param> *t 
-		= new Tensor_Wrapper<device, 0, DType_Param>(new Tensor<device, 0, DType_Param>());
-	t->_tensor->Input(&param);
+		= new Tensor_Wrapper<device, 0, DType_Param>(MakeScalar<device, DType_Param>(param));
 	return src - (*t);
 }
 
@@ -277,8 +554,7 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, decltype(declval<DType>() - dec
 	DType_Param param, Tensor_Wrapper<device, dimension, DType> &src) {
 
 	Tensor_Wrapper<device, 0, DType_Param> *t 
-		= new Tensor_Wrapper<device, 0, DType_Param>(new Tensor<device, 0, DType_Param>());
-	t->_tensor->Input(&param);
+		= new Tensor_Wrapper<device, 0, DType_Param>(MakeScalar<device, DType_Param>(param));
 	return (*t) - src;
 }
 
@@ -296,8 +572,8 @@ XMATRIX_INLINE Tensor_Wrapper<device, 1, decltype(declval<DType_lhs>() * declval
 	
 	Tensor_Wrapper<device, 1, decltype(declval<DType_lhs>() * declval<DType_rhs>())> *t 
 		= new Tensor_Wrapper<device, 1, decltype(declval<DType_lhs>() * declval<DType_rhs>())>(
-			new MultipleTensor<device, 1, decltype(declval<DType_lhs>() * declval<DType_rhs>()), 
-				device, 1, DType_lhs, device, 2, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<MultipleTensor<device, 1, decltype(declval<DType_lhs>() * declval<DType_rhs>()), 
+				device, 1, DType_lhs, device, 2, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return *t;
 }
 
@@ -307,8 +583,19 @@ XMATRIX_INLINE Tensor_Wrapper<device, 0, decltype(declval<DType_lhs>() * declval
 	
 	Tensor_Wrapper<device, 0, decltype(declval<DType_lhs>() * declval<DType_rhs>())> *t 
 		= new Tensor_Wrapper<device, 0, decltype(declval<DType_lhs>() * declval<DType_rhs>())>(
-			new MultipleTensor<device, 0, decltype(declval<DType_lhs>() * declval<DType_rhs>()), 
-				device, 1, DType_lhs, device, 1, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<MultipleTensor<device, 0, decltype(declval<DType_lhs>() * declval<DType_rhs>()), 
+				device, 1, DType_lhs, device, 1, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
+	return *t;
+}
+
+template<typename device, typename DType_lhs, typename DType_rhs>
+XMATRIX_INLINE Tensor_Wrapper<device, 1, decltype(declval<DType_lhs>() * declval<DType_rhs>())> &operator*(
+	Tensor_Wrapper<device, 2, DType_lhs> &lhs, Tensor_Wrapper<device, 1, DType_rhs> &rhs) {
+	
+	Tensor_Wrapper<device, 1, decltype(declval<DType_lhs>() * declval<DType_rhs>())> *t 
+		= new Tensor_Wrapper<device, 1, decltype(declval<DType_lhs>() * declval<DType_rhs>())>(
+			MakeTensor<MultipleTensor<device, 1, decltype(declval<DType_lhs>() * declval<DType_rhs>()), 
+				device, 2, DType_lhs, device, 1, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return *t;
 }
 
@@ -318,8 +605,8 @@ XMATRIX_INLINE Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() * declval
 	
 	Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() * declval<DType_rhs>())> *t 
 		= new Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() * declval<DType_rhs>())>(
-			new MultipleTensor<device, 2, decltype(declval<DType_lhs>() * declval<DType_rhs>()), 
-				device, 2, DType_lhs, device, 2, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<MultipleTensor<device, 2, decltype(declval<DType_lhs>() * declval<DType_rhs>()), 
+				device, 2, DType_lhs, device, 2, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return *t;
 }
 
@@ -329,8 +616,8 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() *
 	
 	Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() * declval<DType_rhs>())> *t 
 		= new Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() * declval<DType_rhs>())>(
-			new MultipleTensor<device, dimension, decltype(declval<DType_lhs>() * declval<DType_rhs>()), 
-				device, dimension, DType_lhs, device, 0, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<MultipleTensor<device, dimension, decltype(declval<DType_lhs>() * declval<DType_rhs>()), 
+				device, dimension, DType_lhs, device, 0, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return *t;
 }
 
@@ -340,8 +627,8 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() *
 	
 	Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() * declval<DType_rhs>())> *t 
 		= new Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() * declval<DType_rhs>())>(
-			new MultipleTensor<device, dimension, decltype(declval<DType_lhs>() * declval<DType_rhs>()), 
-				device, dimension, DType_rhs, device, 0, DType_lhs>(*(rhs._tensor), *(lhs._tensor)));
+			MakeTensor<MultipleTensor<device, dimension, decltype(declval<DType_lhs>() * declval<DType_rhs>()), 
+				device, dimension, DType_rhs, device, 0, DType_lhs> >(*(rhs._tensor), *(lhs._tensor)));
 	return *t;
 }
 
@@ -351,8 +638,8 @@ XMATRIX_INLINE Tensor_Wrapper<device, 0, decltype(declval<DType_lhs>() * declval
 	
 	Tensor_Wrapper<device, 0, decltype(declval<DType_lhs>() * declval<DType_rhs>())> *t 
 		= new Tensor_Wrapper<device, 0, decltype(declval<DType_lhs>() * declval<DType_rhs>())>(
-			new MultipleTensor<device, 0, decltype(declval<DType_lhs>() * declval<DType_rhs>()), 
-				device, 0, DType_lhs, device, 0, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<MultipleTensor<device, 0, decltype(declval<DType_lhs>() * declval<DType_rhs>()), 
+				device, 0, DType_lhs, device, 0, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return *t;
 }
 
@@ -360,9 +647,12 @@ template<typename device, size_t dimension, typename DType, typename DType_Param
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, decltype(declval<DType>() * declval<DType_Param>())> &operator*(
 	Tensor_Wrapper<device, dimension, DType> &src, DType_Param param) {
 
+	Tensor_Wrapper<device, dimension, decltype(declval<DType>() * declval<DType_Param>())> *same = Identity<Tensor_Wrapper<device, dimension, decltype(declval<DType>() * declval<DType_Param>())> >(src, param == 1);
+	if (same != NULL)
+		return *same;
+
 	Tensor_Wrapper<device, 0, DType_Param> *t 
-		= new Tensor_Wrapper<device, 0, DType_Param>(new Tensor<device, 0, DType_Param>());
-	t->_tensor->Input(&param);
+		= new Tensor_Wrapper<device, 0, DType_Param>(MakeScalar<device, DType_Param>(param));
 	return src * (*t);
 }
 
@@ -370,23 +660,59 @@ template<typename device, size_t dimension, typename DType, typename DType_Param
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, decltype(declval<DType>() * declval<DType_Param>())> &operator*(
 	DType param, Tensor_Wrapper<device, dimension, DType_Param> &src) {
 
+	Tensor_Wrapper<device, dimension, decltype(declval<DType>() * declval<DType_Param>())> *same = Identity<Tensor_Wrapper<device, dimension, decltype(declval<DType>() * declval<DType_Param>())> >(src, param == 1);
+	if (same != NULL)
+		return *same;
+
 	Tensor_Wrapper<device, 0, DType_Param> *t 
-		= new Tensor_Wrapper<device, 0, DType_Param>(new Tensor<device, 0, DType_Param>());
-	t->_tensor->Input(&param);
+		= new Tensor_Wrapper<device, 0, DType_Param>(MakeScalar<device, DType_Param>(param));
 	return (*t) * src;
 }
 
 /**
 * Divide Operator
 */
+template<typename device, size_t dimension, typename DType_lhs, typename DType_rhs>
+XMATRIX_INLINE Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() / declval<DType_rhs>())> &operator/(
+	Tensor_Wrapper<device, dimension, DType_lhs> &lhs, Tensor_Wrapper<device, dimension, DType_rhs> &rhs) {
+	
+	Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() / declval<DType_rhs>())> *t 
+		= new Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() / declval<DType_rhs>())>(
+			MakeTensor<DivideTensor<device, dimension, decltype(declval<DType_lhs>() / declval<DType_rhs>()), 
+				device, dimension, DType_lhs, device, dimension, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
+	return *t;
+}
+
+template<typename device, typename DType_lhs, typename DType_rhs>
+XMATRIX_INLINE Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() / declval<DType_rhs>())> &operator/(
+	Tensor_Wrapper<device, 2, DType_lhs> &lhs, Tensor_Wrapper<device, 1, DType_rhs> &rhs) {
+	
+	Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() / declval<DType_rhs>())> *t 
+		= new Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() / declval<DType_rhs>())>(
+			MakeTensor<DivideTensor<device, 2, decltype(declval<DType_lhs>() / declval<DType_rhs>()), 
+				device, 2, DType_lhs, device, 1, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
+	return *t;
+}
+
+template<typename device, typename DType_lhs, typename DType_rhs>
+XMATRIX_INLINE Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() / declval<DType_rhs>())> &operator/(
+	Tensor_Wrapper<device, 1, DType_lhs> &lhs, Tensor_Wrapper<device, 2, DType_rhs> &rhs) {
+	
+	Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() / declval<DType_rhs>())> *t 
+		= new Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() / declval<DType_rhs>())>(
+			MakeTensor<DivideTensor<device, 2, decltype(declval<DType_lhs>() / declval<DType_rhs>()), 
+				device, 1, DType_lhs, device, 2, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
+	return *t;
+}
+
 template<typename device, size_t dimension, typename DType_lhs, typename DType_rhs>
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() / declval<DType_rhs>())> &operator/(
 	Tensor_Wrapper<device, dimension, DType_lhs> &lhs, Tensor_Wrapper<device, 0, DType_rhs> &rhs) {
 	
 	Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() / declval<DType_rhs>())> *t 
 		= new Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() / declval<DType_rhs>())>(
-			new DivideTensor<device, dimension, decltype(declval<DType_lhs>() / declval<DType_rhs>()), 
-				device, dimension, DType_lhs, device, 0, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<DivideTensor<device, dimension, decltype(declval<DType_lhs>() / declval<DType_rhs>()), 
+				device, dimension, DType_lhs, device, 0, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return *t;
 }
 
@@ -396,8 +722,8 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() /
 	
 	Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() / declval<DType_rhs>())> *t 
 		= new Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() / declval<DType_rhs>())>(
-			new DivideTensor<device, dimension, decltype(declval<DType_lhs>() / declval<DType_rhs>()), 
-				device, 0, DType_lhs, device, dimension, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<DivideTensor<device, dimension, decltype(declval<DType_lhs>() / declval<DType_rhs>()), 
+				device, 0, DType_lhs, device, dimension, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return *t;
 }
 
@@ -407,8 +733,8 @@ XMATRIX_INLINE Tensor_Wrapper<device, 0, decltype(declval<DType_lhs>() / declval
 	
 	Tensor_Wrapper<device, 0, decltype(declval<DType_lhs>() / declval<DType_rhs>())> *t 
 		= new Tensor_Wrapper<device, 0, decltype(declval<DType_lhs>() / declval<DType_rhs>())>(
-			new DivideTensor<device, 0, decltype(declval<DType_lhs>() / declval<DType_rhs>()), 
-				device, 0, DType_lhs, device, 0, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<DivideTensor<device, 0, decltype(declval<DType_lhs>() / declval<DType_rhs>()), 
+				device, 0, DType_lhs, device, 0, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return *t;
 }
 
@@ -416,9 +742,12 @@ template<typename device, size_t dimension, typename DType, typename DType_Param
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, decltype(declval<DType>() / declval<DType_Param>())> &operator/(
 	Tensor_Wrapper<device, dimension, DType> &src, DType_Param param) {
 
+	Tensor_Wrapper<device, dimension, decltype(declval<DType>() / declval<DType_Param>())> *same = Identity<Tensor_Wrapper<device, dimension, decltype(declval<DType>() / declval<DType_Param>())> >(src, param == 1);
+	if (same != NULL)
+		return *same;
+
 	Tensor_Wrapper<device, 0, DType_Param> *t 
-		= new Tensor_Wrapper<device, 0, DType_Param>(new Tensor<device, 0, DType_Param>());
-	t->_tensor->Input(&param);
+		= new Tensor_Wrapper<device, 0, DType_Param>(MakeScalar<device, DType_Param>(param));
 	return src / (*t);
 }
 
@@ -427,8 +756,7 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, decltype(declval<DType>() / dec
 	DType param, Tensor_Wrapper<device, dimension, DType_Param> &src) {
 
 	Tensor_Wrapper<device, 0, DType_Param> *t 
-		= new Tensor_Wrapper<device, 0, DType_Param>(new Tensor<device, 0, DType_Param>());
-	t->_tensor->Input(&param);
+		= new Tensor_Wrapper<device, 0, DType_Param>(MakeScalar<device, DType_Param>(param));
 	return (*t) / src;
 }
 
@@ -439,7 +767,7 @@ template<typename device, size_t dimension, typename DType>
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator!(Tensor_Wrapper<device, dimension, DType> &src) {
 	Tensor_Wrapper<device, dimension, int> *t 
 		= new Tensor_Wrapper<device, dimension, int>(
-			new NotTensor<device, dimension, int, device, dimension, DType>(*(src._tensor)));
+			MakeTensor<NotTensor<device, dimension, int, device, dimension, DType> >(*(src._tensor)));
 	return *t;
 }
 
@@ -450,7 +778,7 @@ template<typename device, size_t dimension, typename DType>
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &Sign(Tensor_Wrapper<device, dimension, DType> &src) {
 	Tensor_Wrapper<device, dimension, int> *t 
 		= new Tensor_Wrapper<device, dimension, int>(
-			new SignTensor<device, dimension, int, device, dimension, DType>(*(src._tensor)));
+			MakeTensor<SignTensor<device, dimension, int, device, dimension, DType> >(*(src._tensor)));
 	return *t;
 }
 
@@ -461,7 +789,7 @@ template<typename device, size_t dimension, typename DType_lhs, typename DType_r
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator&&(Tensor_Wrapper<device, dimension, DType_lhs> &lhs, Tensor_Wrapper<device, dimension, DType_rhs> &rhs) {
 	Tensor_Wrapper<device, dimension, int> *t  
 		= new Tensor_Wrapper<device, dimension, int>(
-			new AndTensor<device, dimension, int, device, dimension, DType_lhs, device, dimension, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<AndTensor<device, dimension, int, device, dimension, DType_lhs, device, dimension, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return *t;
 }
 
@@ -469,7 +797,7 @@ template<typename device, size_t dimension, typename DType, typename DType_Param
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator&&(Tensor_Wrapper<device, dimension, DType> &src, Tensor_Wrapper<device, 0, DType_Param> &param) {
 	Tensor_Wrapper<device, dimension, int> *t  
 		= new Tensor_Wrapper<device, dimension, int>(
-			new AndTensor<device, dimension, int, device, dimension, DType, device, 0, DType_Param>(*(src._tensor), *(param._tensor)));
+			MakeTensor<AndTensor<device, dimension, int, device, dimension, DType, device, 0, DType_Param> >(*(src._tensor), *(param._tensor)));
 	return *t;
 }
 
@@ -477,7 +805,7 @@ template<typename device, size_t dimension, typename DType, typename DType_Param
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator&&(Tensor_Wrapper<device, 0, DType_Param> &param, Tensor_Wrapper<device, dimension, DType> &src) {
 	Tensor_Wrapper<device, dimension, int> *t  
 		= new Tensor_Wrapper<device, dimension, int>(
-			new AndTensor<device, dimension, int, device, dimension, DType, device, 0, DType_Param>(*(src._tensor), *(param._tensor)));
+			MakeTensor<AndTensor<device, dimension, int, device, dimension, DType, device, 0, DType_Param> >(*(src._tensor), *(param._tensor)));
 	return *t;
 }
 
@@ -485,23 +813,21 @@ template<typename device, typename DType_lhs, typename DType_rhs>
 XMATRIX_INLINE Tensor_Wrapper<device, 0, int> &operator&&(Tensor_Wrapper<device, 0, DType_lhs> &lhs, Tensor_Wrapper<device, 0, DType_rhs> &rhs) {
 	Tensor_Wrapper<device, 0, int> *t  
 		= new Tensor_Wrapper<device, 0, int>(
-			new AndTensor<device, 0, int, device, 0, DType_lhs, device, 0, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<AndTensor<device, 0, int, device, 0, DType_lhs, device, 0, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return *t;
 }
 	
 template<typename device, size_t dimension, typename DType, typename DType_Param>
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator&&(Tensor_Wrapper<device, dimension, DType> &src, DType_Param param) {
 	Tensor_Wrapper<device, 0, DType_Param> *t 
-		= new Tensor_Wrapper<device, 0, DType_Param>(new Tensor<device, 0, DType_Param>());
-	t->_tensor->Input(&param);
+		= new Tensor_Wrapper<device, 0, DType_Param>(MakeScalar<device, DType_Param>(param));
 	return src && (*t);
 }
 
 template<typename device, size_t dimension, typename DType, typename DType_Param>
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator&&(DType_Param param, Tensor_Wrapper<device, dimension, DType> &src) {
 	Tensor_Wrapper<device, 0, DType_Param> *t 
-		= new Tensor_Wrapper<device, 0, DType_Param>(new Tensor<device, 0, DType_Param>());
-	t->_tensor->Input(&param);
+		= new Tensor_Wrapper<device, 0, DType_Param>(MakeScalar<device, DType_Param>(param));
 	return (*t) && src;
 }
 
@@ -512,7 +838,7 @@ template<typename device, size_t dimension, typename DType_lhs, typename DType_r
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator||(Tensor_Wrapper<device, dimension, DType_lhs> &lhs, Tensor_Wrapper<device, dimension, DType_rhs> &rhs) {
 	Tensor_Wrapper<device, dimension, int> *t  
 		= new Tensor_Wrapper<device, dimension, int>(
-			new OrTensor<device, dimension, int, device, dimension, DType_lhs, device, dimension, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<OrTensor<device, dimension, int, device, dimension, DType_lhs, device, dimension, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return *t;
 }
 
@@ -520,7 +846,7 @@ template<typename device, size_t dimension, typename DType, typename DType_Param
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator||(Tensor_Wrapper<device, dimension, DType> &src, Tensor_Wrapper<device, 0, DType_Param> &param) {
 	Tensor_Wrapper<device, dimension, int> *t  
 		= new Tensor_Wrapper<device, dimension, int>(
-			new OrTensor<device, dimension, int, device, dimension, DType, device, 0, DType_Param>(*(src._tensor), *(param._tensor)));
+			MakeTensor<OrTensor<device, dimension, int, device, dimension, DType, device, 0, DType_Param> >(*(src._tensor), *(param._tensor)));
 	return *t;
 }
 
@@ -528,7 +854,7 @@ template<typename device, size_t dimension, typename DType, typename DType_Param
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator||(Tensor_Wrapper<device, 0, DType_Param> &param, Tensor_Wrapper<device, dimension, DType> &src) {
 	Tensor_Wrapper<device, dimension, int> *t  
 		= new Tensor_Wrapper<device, dimension, int>(
-			new OrTensor<device, dimension, int, device, dimension, DType, device, 0, DType_Param>(*(src._tensor), *(param._tensor)));
+			MakeTensor<OrTensor<device, dimension, int, device, dimension, DType, device, 0, DType_Param> >(*(src._tensor), *(param._tensor)));
 	return *t;
 }
 
@@ -536,23 +862,21 @@ template<typename device, typename DType_lhs, typename DType_rhs>
 XMATRIX_INLINE Tensor_Wrapper<device, 0, int> &operator||(Tensor_Wrapper<device, 0, DType_lhs> &lhs, Tensor_Wrapper<device, 0, DType_rhs> &rhs) {
 	Tensor_Wrapper<device, 0, int> *t  
 		= new Tensor_Wrapper<device, 0, int>(
-			new OrTensor<device, 0, int, device, 0, DType_lhs, device, 0, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<OrTensor<device, 0, int, device, 0, DType_lhs, device, 0, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return *t;
 }
 	
 template<typename device, size_t dimension, typename DType, typename DType_Param>
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator||(Tensor_Wrapper<device, dimension, DType> &src, DType_Param param) {
 	Tensor_Wrapper<device, 0, DType_Param> *t 
-		= new Tensor_Wrapper<device, 0, DType_Param>(new Tensor<device, 0, DType_Param>());
-	t->_tensor->Input(&param);
+		= new Tensor_Wrapper<device, 0, DType_Param>(MakeScalar<device, DType_Param>(param));
 	return src || (*t);
 }
 
 template<typename device, size_t dimension, typename DType, typename DType_Param>
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator||(DType_Param param, Tensor_Wrapper<device, dimension, DType> &src) {
 	Tensor_Wrapper<device, 0, DType_Param> *t 
-		= new Tensor_Wrapper<device, 0, DType_Param>(new Tensor<device, 0, DType_Param>());
-	t->_tensor->Input(&param);
+		= new Tensor_Wrapper<device, 0, DType_Param>(MakeScalar<device, DType_Param>(param));
 	return (*t) || src;
 }
 
@@ -582,8 +906,7 @@ XMATRIX_INLINE Tensor_Wrapper<device, 0, int> &operator^(Tensor_Wrapper<device,
 template<typename device, size_t dimension, typename DType, typename DType_Param>
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator^(Tensor_Wrapper<device, dimension, DType> &src, DType_Param param) {
 	Tensor_Wrapper<device, 0, DType_Param> *t 
-		= new Tensor_Wrapper<device, 0, DType_Param>(new Tensor<device, 0, DType_Param>());
-	t->_tensor->Input(&param);
+		= new Tensor_Wrapper<device, 0, DType_Param>(MakeScalar<device, DType_Param>(param));
 
 	return (!src && (*t)) || (src && !(*t));
 }
@@ -591,8 +914,7 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator^(Tensor_Wrapper<
 template<typename device, size_t dimension, typename DType, typename DType_Param>
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator^(DType_Param param, Tensor_Wrapper<device, dimension, DType> &src) {
 	Tensor_Wrapper<device, 0, DType_Param> *t 
-		= new Tensor_Wrapper<device, 0, DType_Param>(new Tensor<device, 0, DType_Param>());
-	t->_tensor->Input(&param);
+		= new Tensor_Wrapper<device, 0, DType_Param>(MakeScalar<device, DType_Param>(param));
 	return (!src && (*t)) || (src && !(*t));
 }
 
@@ -603,7 +925,7 @@ template<typename device, size_t dimension, typename DType_lhs, typename DType_r
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator==(Tensor_Wrapper<device, dimension, DType_lhs> &lhs, Tensor_Wrapper<device, dimension, DType_rhs> &rhs) {
 	Tensor_Wrapper<device, dimension, int> *t 
 		= new Tensor_Wrapper<device, dimension, int>(
-			new EqualTensor<device, dimension, int, device, dimension, DType_lhs, device, dimension, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<EqualTensor<device, dimension, int, device, dimension, DType_lhs, device, dimension, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return *t;
 }
 
@@ -611,7 +933,7 @@ template<typename device, size_t dimension, typename DType, typename DType_Param
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator==(Tensor_Wrapper<device, dimension, DType> &src, Tensor_Wrapper<device, 0, DType_Param> &param) {
 	Tensor_Wrapper<device, dimension, int> *t 
 		= new Tensor_Wrapper<device, dimension, int>(
-			new EqualTensor<device, dimension, int, device, dimension, DType, device, 0, DType_Param>(*(src._tensor), *(param._tensor)));
+			MakeTensor<EqualTensor<device, dimension, int, device, dimension, DType, device, 0, DType_Param> >(*(src._tensor), *(param._tensor)));
 	return *t;
 }
 
@@ -619,7 +941,7 @@ template<typename device, size_t dimension, typename DType, typename DType_Param
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator==(Tensor_Wrapper<device, 0, DType_Param> &param, Tensor_Wrapper<device, dimension, DType> &src) {
 	Tensor_Wrapper<device, dimension, int> *t 
 		= new Tensor_Wrapper<device, dimension, int>(
-			new EqualTensor<device, dimension, int, device, dimension, DType, device, 0, DType_Param>(*(src._tensor), *(param._tensor)));
+			MakeTensor<EqualTensor<device, dimension, int, device, dimension, DType, device, 0, DType_Param> >(*(src._tensor), *(param._tensor)));
 	return *t;
 }
 
@@ -627,15 +949,14 @@ template<typename device, typename DType_lhs, typename DType_rhs>
 XMATRIX_INLINE Tensor_Wrapper<device, 0, int> &operator==(Tensor_Wrapper<device, 0, DType_lhs> &lhs, Tensor_Wrapper<device, 0, DType_rhs> &rhs) {
 	Tensor_Wrapper<device, 0, int> *t 
 		= new Tensor_Wrapper<device, 0, int>(
-			new EqualTensor<device, 0, int, device, 0, DType_lhs, device, 0, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<EqualTensor<device, 0, int, device, 0, DType_lhs, device, 0, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return *t;
 }
 	
 template<typename device, size_t dimension, typename DType, typename DType_Param>
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator==(Tensor_Wrapper<device, dimension, DType> &src, DType_Param param) {
 	Tensor_Wrapper<device, 0, DType_Param> *t 
-		= new Tensor_Wrapper<device, 0, DType_Param>(new Tensor<device, 0, DType_Param>());
-	t->_tensor->Input(&param);
+		= new Tensor_Wrapper<device, 0, DType_Param>(MakeScalar<device, DType_Param>(param));
 
 	return src == (*t);
 }
@@ -643,8 +964,7 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator==(Tensor_Wrapper
 template<typename device, size_t dimension, typename DType, typename DType_Param>
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator==(DType_Param param, Tensor_Wrapper<device, dimension, DType> &src) {
 	Tensor_Wrapper<device, 0, DType_Param> *t 
-		= new Tensor_Wrapper<device, 0, DType_Param>(new Tensor<device, 0, DType_Param>());
-	t->_tensor->Input(&param);
+		= new Tensor_Wrapper<device, 0, DType_Param>(MakeScalar<device, DType_Param>(param));
 	return (*t) == src;
 }
 
@@ -655,7 +975,7 @@ template<typename device, size_t dimension, typename DType_lhs, typename DType_r
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator!=(Tensor_Wrapper<device, dimension, DType_lhs> &lhs, Tensor_Wrapper<device, dimension, DType_rhs> &rhs) {
 	Tensor_Wrapper<device, dimension, int> *t 
 		= new Tensor_Wrapper<device, dimension, int>(
-			new EqualTensor<device, dimension, int, device, dimension, DType_lhs, device, dimension, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<EqualTensor<device, dimension, int, device, dimension, DType_lhs, device, dimension, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return !(*t);
 }
 
@@ -663,7 +983,7 @@ template<typename device, size_t dimension, typename DType, typename DType_Param
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator!=(Tensor_Wrapper<device, dimension, DType> &src, Tensor_Wrapper<device, 0, DType_Param> &param) {
 	Tensor_Wrapper<device, dimension, int> *t 
 		= new Tensor_Wrapper<device, dimension, int>(
-			new EqualTensor<device, dimension, int, device, dimension, DType, device, 0, DType_Param>(*(src._tensor), *(param._tensor)));
+			MakeTensor<EqualTensor<device, dimension, int, device, dimension, DType, device, 0, DType_Param> >(*(src._tensor), *(param._tensor)));
 	return !(*t);
 }
 
@@ -671,7 +991,7 @@ template<typename device, size_t dimension, typename DType, typename DType_Param
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator!=(Tensor_Wrapper<device, 0, DType_Param> &param, Tensor_Wrapper<device, dimension, DType> &src) {
 	Tensor_Wrapper<device, dimension, int> *t 
 		= new Tensor_Wrapper<device, dimension, int>(
-			new EqualTensor<device, dimension, int, device, dimension, DType, device, 0, DType_Param>(*(src._tensor), *(param._tensor)));
+			MakeTensor<EqualTensor<device, dimension, int, device, dimension, DType, device, 0, DType_Param> >(*(src._tensor), *(param._tensor)));
 	return !(*t);
 }
 
@@ -679,23 +999,21 @@ template<typename device, typename DType_lhs, typename DType_rhs>
 XMATRIX_INLINE Tensor_Wrapper<device, 0, int> &operator!=(Tensor_Wrapper<device, 0, DType_lhs> &lhs, Tensor_Wrapper<device, 0, DType_rhs> &rhs) {
 	Tensor_Wrapper<device, 0, int> *t 
 		= new Tensor_Wrapper<device, 0, int>(
-			new EqualTensor<device, 0, int, device, 0, DType_lhs, device, 0, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<EqualTensor<device, 0, int, device, 0, DType_lhs, device, 0, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return !(*t);
 }
 	
 template<typename device, size_t dimension, typename DType, typename DType_Param>
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator!=(Tensor_Wrapper<device, dimension, DType> &src, DType_Param param) {
 	Tensor_Wrapper<device, 0, DType_Param> *t 
-		= new Tensor_Wrapper<device, 0, DType_Param>(new Tensor<device, 0, DType_Param>());
-	t->_tensor->Input(&param);
+		= new Tensor_Wrapper<device, 0, DType_Param>(MakeScalar<device, DType_Param>(param));
 	return src != (*t);
 }
 
 template<typename device, size_t dimension, typename DType, typename DType_Param>
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator!=(DType_Param param, Tensor_Wrapper<device, dimension, DType> &src) {
 	Tensor_Wrapper<device, 0, DType_Param> *t 
-		= new Tensor_Wrapper<device, 0, DType_Param>(new Tensor<device, 0, DType_Param>());
-	t->_tensor->Input(&param);
+		= new Tensor_Wrapper<device, 0, DType_Param>(MakeScalar<device, DType_Param>(param));
 
 	return (*t) != src;
 }
@@ -707,7 +1025,7 @@ template<typename device, size_t dimension, typename DType_lhs, typename DType_r
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator>(Tensor_Wrapper<device, dimension, DType_lhs> &lhs, Tensor_Wrapper<device, dimension, DType_rhs> &rhs) {
 	Tensor_Wrapper<device, dimension, int> *t 
 		= new Tensor_Wrapper<device, dimension, int>(
-			new GreaterThanTensor<device, dimension, int, device, dimension, DType_lhs, device, dimension, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<GreaterThanTensor<device, dimension, int, device, dimension, DType_lhs, device, dimension, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return *t;
 }
 	
@@ -715,7 +1033,7 @@ template<typename device, size_t dimension, typename DType, typename DType_Param
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator>(Tensor_Wrapper<device, dimension, DType> &src, Tensor_Wrapper<device, 0, DType_Param> &param) {
 	Tensor_Wrapper<device, dimension, int> *t 
 		= new Tensor_Wrapper<device, dimension, int>(
-			new GreaterThanTensor<device, dimension, int, device, dimension, DType, device, 0, DType_Param>(*(src._tensor), *(param._tensor)));
+			MakeTensor<GreaterThanTensor<device, dimension, int, device, dimension, DType, device, 0, DType_Param> >(*(src._tensor), *(param._tensor)));
 	return *t;
 }
 
@@ -723,7 +1041,7 @@ template<typename device, size_t dimension, typename DType, typename DType_Param
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator>(Tensor_Wrapper<device, 0, DType_Param> &param, Tensor_Wrapper<device, dimension, DType> &src) {
 	Tensor_Wrapper<device, dimension, int> *t
 		= new Tensor_Wrapper<device, dimension, int>(
-			new GreaterThanTensor<device, dimension, int, device, 0, DType, device, dimension, DType_Param>(*(param._tensor), *(src._tensor)));
+			MakeTensor<GreaterThanTensor<device, dimension, int, device, 0, DType, device, dimension, DType_Param> >(*(param._tensor), *(src._tensor)));
 	return *t;
 }
 
@@ -731,15 +1049,14 @@ template<typename device, typename DType_lhs, typename DType_rhs>
 XMATRIX_INLINE Tensor_Wrapper<device, 0, int> &operator>(Tensor_Wrapper<device, 0, DType_lhs> &lhs, Tensor_Wrapper<device, 0, DType_rhs> &rhs) {
 	Tensor_Wrapper<device, 0, int> *t 
 		= new Tensor_Wrapper<device, 0, int>(
-			new GreaterThanTensor<device, 0, int, device, 0, DType_lhs, device, 0, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<GreaterThanTensor<device, 0, int, device, 0, DType_lhs, device, 0, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 	return *t;
 }
 	
 template<typename device, size_t dimension, typename DType, typename DType_Param>
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator>(Tensor_Wrapper<device, dimension, DType> &src, DType_Param param) {
 	Tensor_Wrapper<device, 0, DType_Param> *t 
-		= new Tensor_Wrapper<device, 0, DType_Param>(new Tensor<device, 0, DType_Param>());
-	t->_tensor->Input(&param);
+		= new Tensor_Wrapper<device, 0, DType_Param>(MakeScalar<device, DType_Param>(param));
 
 	return src > (*t);
 }
@@ -747,8 +1064,7 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator>(Tensor_Wrapper<
 template<typename device, size_t dimension, typename DType, typename DType_Param>
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator>(DType_Param param, Tensor_Wrapper<device, dimension, DType> &src) {
 	Tensor_Wrapper<device, 0, DType_Param> *t 
-		= new Tensor_Wrapper<device, 0, DType_Param>(new Tensor<device, 0, DType_Param>());
-	t->_tensor->Input(&param);
+		= new Tensor_Wrapper<device, 0, DType_Param>(MakeScalar<device, DType_Param>(param));
 
 	return (*t) > src;
 }
@@ -853,6 +1169,9 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &operator<=(DType_Param pa
 }
 
 namespace op {
+template<typename device, size_t dimension, typename DType>
+XMATRIX_INLINE Tensor_Wrapper<device, dimension, DType> &Abs(Tensor_Wrapper<device, dimension, DType> &src);
+
 /**
 * Dot Operator
 */
@@ -863,21 +1182,52 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() *
 		
 	Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() * declval<DType_rhs>())> *t = 
 		new Tensor_Wrapper<device, dimension, decltype(declval<DType_lhs>() * declval<DType_rhs>())>(
-			new DotTensor<device, dimension, decltype(declval<DType_lhs>() * declval<DType_rhs>()), 
-				device, dimension, DType_lhs, device, dimension, DType_rhs>(*(lhs._tensor), *(rhs._tensor)));
+			MakeTensor<DotTensor<device, dimension, decltype(declval<DType_lhs>() * declval<DType_rhs>()), 
+				device, dimension, DType_lhs, device, dimension, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
 
 	return *t;
 }
 
+/**
+* Dot Operator: a batch of vectors and one vector repeated over the batch
+*/
+template<typename device, typename DType_lhs, typename DType_rhs>
+XMATRIX_INLINE Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() * declval<DType_rhs>())> &Dot(
+	Tensor_Wrapper<device, 2, DType_lhs> &lhs, Tensor_Wrapper<device, 1, DType_rhs> &rhs) {
+	
+	Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() * declval<DType_rhs>())> *t 
+		= new Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() * declval<DType_rhs>())>(
+			MakeTensor<DotTensor<device, 2, decltype(declval<DType_lhs>() * declval<DType_rhs>()), 
+				device, 2, DType_lhs, device, 1, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
+	return *t;
+}
+
+template<typename device, typename DType_lhs, typename DType_rhs>
+XMATRIX_INLINE Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() * declval<DType_rhs>())> &Dot(
+	Tensor_Wrapper<device, 1, DType_lhs> &lhs, Tensor_Wrapper<device, 2, DType_rhs> &rhs) {
+	
+	Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() * declval<DType_rhs>())> *t 
+		= new Tensor_Wrapper<device, 2, decltype(declval<DType_lhs>() * declval<DType_rhs>())>(
+			MakeTensor<DotTensor<device, 2, decltype(declval<DType_lhs>() * declval<DType_rhs>()), 
+				device, 1, DType_lhs, device, 2, DType_rhs> >(*(lhs._tensor), *(rhs._tensor)));
+	return *t;
+}
+
 
 /**
 * Transpose Operator
 */
 template<typename device, typename DType>
 XMATRIX_INLINE Tensor_Wrapper<device, 2, DType> &Transpose(Tensor_Wrapper<device, 2, DType> &src) {
+	// Transpose(Transpose(x)) is x
+	TransposeTensor<device, 2, DType, device, 2, DType> *inner 
+		= dynamic_cast<TransposeTensor<device, 2, DType, device, 2, DType> *>(src._tensor);
+	if (inner != NULL)
+		return *new Tensor_Wrapper<device, 2, DType>(&inner->_src);
+
 	Tensor_Wrapper<device, 2, DType> *t 
 		= new Tensor_Wrapper<device, 2, DType>(
-			new TransposeTensor<device, 2, DType, device, 2, DType>(*(src._tensor)));
+			MakeTensor<TransposeTensor<device, 2, DType, device, 2, DType> >(*(src._tensor)));
 	return *t;
 }
 
@@ -885,18 +1235,74 @@ template<typename device, typename DType>
 XMATRIX_INLINE Tensor_Wrapper<device, 2, DType> &Transpose(Tensor_Wrapper<device, 1, DType> &src) {
 	Tensor_Wrapper<device, 2, DType> *t 
 		= new Tensor_Wrapper<device, 2, DType>(
-			new TransposeTensor<device, 2, DType, device, 1, DType>(*(src._tensor)));
+			MakeTensor<TransposeTensor<device, 2, DType, device, 1, DType> >(*(src._tensor)));
+	return *t;
+}
+
+/**
+* Slice Operator: elements begin, begin + step, ... before end, as a view
+* sharing the buffer of src; an end past the extent stops at the extent
+*/
+template<typename device, typename DType>
+XMATRIX_INLINE Tensor_Wrapper<device, 1, DType> &Slice(Tensor_Wrapper<device, 1, DType> &src, 
+	size_t begin, size_t end, size_t step = 1) {
+	Tensor_Wrapper<device, 1, DType> *t 
+		= new Tensor_Wrapper<device, 1, DType>(
+			MakeTensor<SliceTensor<device, 1, DType, device, 1, DType> >(*(src._tensor), Shape1(begin), Shape1(end), Shape1(step)));
+	return *t;
+}
+
+template<typename device, typename DType>
+XMATRIX_INLINE Tensor_Wrapper<device, 2, DType> &Slice(Tensor_Wrapper<device, 2, DType> &src, 
+	size_t rowBegin, size_t rowEnd, size_t colBegin, size_t colEnd, size_t rowStep = 1, size_t colStep = 1) {
+	Tensor_Wrapper<device, 2, DType> *t 
+		= new Tensor_Wrapper<device, 2, DType>(
+			MakeTensor<SliceTensor<device, 2, DType, device, 2, DType> >(*(src._tensor), 
+				Shape2(rowBegin, colBegin), Shape2(rowEnd, colEnd), Shape2(rowStep, colStep)));
 	return *t;
 }
 
+/**
+* Rows and Cols Operators: the rows or columns [begin, end) of a matrix
+*/
+template<typename device, typename DType>
+XMATRIX_INLINE Tensor_Wrapper<device, 2, DType> &Rows(Tensor_Wrapper<device, 2, DType> &src, size_t begin, size_t end) {
+	return Slice(src, begin, end, 0, (size_t)-1);
+}
+
+template<typename device, typename DType>
+XMATRIX_INLINE Tensor_Wrapper<device, 2, DType> &Cols(Tensor_Wrapper<device, 2, DType> &src, size_t begin, size_t end) {
+	return Slice(src, 0, (size_t)-1, begin, end);
+}
+
+/**
+* Reshape Operator: an extent of 0 in shape is deduced from the size of src
+*/
+template<typename device, size_t dimension_dest, size_t dimension_src, typename DType>
+XMATRIX_INLINE Tensor_Wrapper<device, dimension_dest, DType> &Reshape(Tensor_Wrapper<device, dimension_src, DType> &src, 
+	Shape<dimension_dest> shape) {
+	Tensor_Wrapper<device, dimension_dest, DType> *t 
+		= new Tensor_Wrapper<device, dimension_dest, DType>(
+			MakeTensor<ReshapeTensor<device, dimension_dest, DType, device, dimension_src, DType> >(*(src._tensor), shape));
+	return *t;
+}
+
+/**
+* Flatten Operator
+*/
+template<typename device, size_t dimension, typename DType>
+XMATRIX_INLINE Tensor_Wrapper<device, 1, DType> &Flatten(Tensor_Wrapper<device, dimension, DType> &src) {
+	return Reshape(src, Shape1(0));
+}
+
 /**
 * Exponential Operator
 */
 template<typename device, size_t dimension, typename DType>
-XMATRIX_INLINE Tensor_Wrapper<device, dimension, double> &Exp(Tensor_Wrapper<device, dimension, DType> &src) {
-	Tensor_Wrapper<device, dimension, double> *t 
-		= new Tensor_Wrapper<device, dimension, double>(
-			new ExponentialTensor<device, dimension, double, device, dimension, DType>(*(src._tensor)));
+XMATRIX_INLINE Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> &Exp(Tensor_Wrapper<device, dimension, DType> &src) {
+	Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> *t 
+		= new Tensor_Wrapper<device, dimension, typename FloatType<DType>::type>(
+			MakeTensor<ExponentialTensor<device, dimension, typename FloatType<DType>::type, device, dimension, DType> >(*(src._tensor)));
 	return *t;
 }
 
@@ -904,10 +1310,10 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, double> &Exp(Tensor_Wrapper<dev
 * Log Operator
 */
 template<typename device, size_t dimension, typename DType>
-XMATRIX_INLINE Tensor_Wrapper<device, dimension, double> &Log(Tensor_Wrapper<device, dimension, DType> &src) {
-	Tensor_Wrapper<device, dimension, double> *t 
-		= new Tensor_Wrapper<device, dimension, double>(
-			new LogTensor<device, dimension, double, device, dimension, DType>(*(src._tensor)));
+XMATRIX_INLINE Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> &Log(Tensor_Wrapper<device, dimension, DType> &src) {
+	Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> *t 
+		= new Tensor_Wrapper<device, dimension, typename FloatType<DType>::type>(
+			MakeTensor<LogTensor<device, dimension, typename FloatType<DType>::type, device, dimension, DType> >(*(src._tensor)));
 	return *t;
 }
 
@@ -915,10 +1321,10 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, double> &Log(Tensor_Wrapper<dev
 * Log10 Operator
 */
 template<typename device, size_t dimension, typename DType>
-XMATRIX_INLINE Tensor_Wrapper<device, dimension, double> &Log10(Tensor_Wrapper<device, dimension, DType> &src) {
-	Tensor_Wrapper<device, dimension, double> *t 
-		= new Tensor_Wrapper<device, dimension, double>(
-			new Log10Tensor<device, dimension, double, device, dimension, DType>(*(src._tensor)));
+XMATRIX_INLINE Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> &Log10(Tensor_Wrapper<device, dimension, DType> &src) {
+	Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> *t 
+		= new Tensor_Wrapper<device, dimension, typename FloatType<DType>::type>(
+			MakeTensor<Log10Tensor<device, dimension, typename FloatType<DType>::type, device, dimension, DType> >(*(src._tensor)));
 	return *t;
 }
 
@@ -926,10 +1332,19 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, double> &Log10(Tensor_Wrapper<d
 * Sqrt Operator
 */
 template<typename device, size_t dimension, typename DType>
-XMATRIX_INLINE Tensor_Wrapper<device, dimension, double> &Sqrt(Tensor_Wrapper<device, dimension, DType> &src) {
-	Tensor_Wrapper<device, dimension, double> *t 
-		= new Tensor_Wrapper<device, dimension, double>(
-			new SqrtTensor<device, dimension, double, device, dimension, DType>(*(src._tensor)));
+XMATRIX_INLINE Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> &Sqrt(Tensor_Wrapper<device, dimension, DType> &src) {
+	// Sqrt(Dot(x, x)), also built by Pow(x, 2), is Abs(x). The square is
+	// never formed, so |x| > ~1e154 no longer overflows to inf, |x| < ~1e-162
+	// no longer underflows to 0, and the gradient at 0 is 0 instead of NaN
+	typedef typename FloatType<DType>::type DType_dest;
+	typedef DotTensor<device, dimension, DType_dest, device, dimension, DType_dest, device, dimension, DType_dest> Square;
+	Square *square = dynamic_cast<Square *>(src._tensor);
+	if (square != NULL && &square->_lhs == &square->_rhs)
+		return Abs(*new Tensor_Wrapper<device, dimension, DType_dest>(&square->_lhs));
+
+	Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> *t 
+		= new Tensor_Wrapper<device, dimension, typename FloatType<DType>::type>(
+			MakeTensor<SqrtTensor<device, dimension, typename FloatType<DType>::type, device, dimension, DType> >(*(src._tensor)));
 	return *t;
 }
 
@@ -937,21 +1352,218 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, double> &Sqrt(Tensor_Wrapper<de
 * Power Operator
 */
 template<typename device, size_t dimension, typename DType>
-XMATRIX_INLINE Tensor_Wrapper<device, dimension, double> &Pow(Tensor_Wrapper<device, dimension, DType> &src, double exp) {
-	Tensor_Wrapper<device, dimension, double> *t 
-		= new Tensor_Wrapper<device, dimension, double>(
-			new PowerTensor<device, dimension, double, device, dimension, DType>(*(src._tensor), exp));
+XMATRIX_INLINE Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> &Pow(Tensor_Wrapper<device, dimension, DType> &src, double exp) {
+	// x^0 is a literal 1, even for NaN and inf. Small integer and half
+	// exponents of double and dual tensors become products, Sqrt and a
+	// division, which are cheaper than pow() but not bitwise equal to it:
+	// x^3 and x^4 round twice, and Sqrt gives -0 at -0 and NaN at -inf
+	// where pow() gives +0 and +inf
+	typedef Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> Result;
+	if (exp == 0) {
+		Result *t = new Result(MakeTensor<FillTensor<device, dimension, typename FloatType<DType>::type,
+			device, dimension, DType> >(*(src._tensor), 1.0));
+		return *t;
+	}
+
+	Result *same = NULL;
+	if (is_same<DType, typename FloatType<DType>::type>::value) {
+		if (exp == 1)
+			same = Identity<Result>(src, true);
+		else if (exp == 2)
+			same = Identity<Result>(Dot(src, src), true);
+		else if (exp == 3)
+			same = Identity<Result>(Dot(Dot(src, src), src), true);
+		else if (exp == 4) {
+			Tensor_Wrapper<device, dimension, decltype(declval<DType>() * declval<DType>())> &square = Dot(src, src);
+			same = Identity<Result>(Dot(square, square), true);
+		}
+		else if (exp == 0.5)
+			same = Identity<Result>(Sqrt(src), true);
+		else if (exp == -1)
+			same = Identity<Result>((DType)1 / src, true);
+	}
+	if (same != NULL)
+		return *same;
+
+	Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> *t 
+		= new Tensor_Wrapper<device, dimension, typename FloatType<DType>::type>(
+			MakeTensor<PowerTensor<device, dimension, typename FloatType<DType>::type, device, dimension, DType> >(*(src._tensor), exp));
+	return *t;
+}
+
+/**
+* Erf Operator
+*/
+template<typename device, size_t dimension, typename DType>
+XMATRIX_INLINE Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> &Erf(Tensor_Wrapper<device, dimension, DType> &src) {
+	Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> *t 
+		= new Tensor_Wrapper<device, dimension, typename FloatType<DType>::type>(
+			MakeTensor<ErfTensor<device, dimension, typename FloatType<DType>::type, device, dimension, DType> >(*(src._tensor)));
+	return *t;
+}
+
+/**
+* Erfc Operator
+*/
+template<typename device, size_t dimension, typename DType>
+XMATRIX_INLINE Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> &Erfc(Tensor_Wrapper<device, dimension, DType> &src) {
+	Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> *t 
+		= new Tensor_Wrapper<device, dimension, typename FloatType<DType>::type>(
+			MakeTensor<ErfcTensor<device, dimension, typename FloatType<DType>::type, device, dimension, DType> >(*(src._tensor)));
+	return *t;
+}
+
+/**
+* Normal CDF Operator
+*/
+template<typename device, size_t dimension, typename DType>
+XMATRIX_INLINE Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> &NormCdf(Tensor_Wrapper<device, dimension, DType> &src) {
+	Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> *t 
+		= new Tensor_Wrapper<device, dimension, typename FloatType<DType>::type>(
+			MakeTensor<NormCdfTensor<device, dimension, typename FloatType<DType>::type, device, dimension, DType> >(*(src._tensor)));
+	return *t;
+}
+
+/**
+* Normal PDF Operator
+*/
+template<typename device, size_t dimension, typename DType>
+XMATRIX_INLINE Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> &NormPdf(Tensor_Wrapper<device, dimension, DType> &src) {
+	Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> *t 
+		= new Tensor_Wrapper<device, dimension, typename FloatType<DType>::type>(
+			MakeTensor<NormPdfTensor<device, dimension, typename FloatType<DType>::type, device, dimension, DType> >(*(src._tensor)));
+	return *t;
+}
+
+/**
+* Inverse Normal CDF Operator: the quantile of probabilities
+*/
+template<typename device, size_t dimension, typename DType>
+XMATRIX_INLINE Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> &NormInv(Tensor_Wrapper<device, dimension, DType> &src) {
+	Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> *t 
+		= new Tensor_Wrapper<device, dimension, typename FloatType<DType>::type>(
+			MakeTensor<NormInvTensor<device, dimension, typename FloatType<DType>::type, device, dimension, DType> >(*(src._tensor)));
 	return *t;
 }
 
+/**
+* Broadcast Dimension: dimensions of the broadcast shape of operands, the
+* largest of theirs
+*/
+template<size_t dimension, size_t... dimensions>
+struct BroadcastDimension {
+	static const size_t rest = BroadcastDimension<dimensions...>::value;
+	static const size_t value = (dimension > rest)? dimension : rest;
+};
+
+template<size_t dimension>
+struct BroadcastDimension<dimension> {
+	static const size_t value = dimension;
+};
+
+/**
+* Black-Scholes Operator: price, delta, gamma, vega, theta and rho of
+* European calls (or puts) in rows 0 to 5 of the result, read with
+* result[0] ... result[5]. Each operand is a scalar or has the trailing
+* extents of the others, e.g. a Vector of strikes over a Matrix of tenors by
+* strikes
+*/
+template<typename device, size_t dimension_spot, size_t dimension_strike, size_t dimension_vol,
+	size_t dimension_rate, size_t dimension_tenor, typename DType>
+XMATRIX_INLINE Tensor_Wrapper<device,
+	BroadcastDimension<dimension_spot, dimension_strike, dimension_vol, dimension_rate, dimension_tenor>::value + 1,
+	typename FloatType<DType>::type> &BlackScholes(
+	Tensor_Wrapper<device, dimension_spot, DType> &spot, Tensor_Wrapper<device, dimension_strike, DType> &strike,
+	Tensor_Wrapper<device, dimension_vol, DType> &vol, Tensor_Wrapper<device, dimension_rate, DType> &rate,
+	Tensor_Wrapper<device, dimension_tenor, DType> &tenor, bool isCall = true) {
+	const size_t dimension = BroadcastDimension<dimension_spot, dimension_strike, dimension_vol, dimension_rate, dimension_tenor>::value + 1;
+	Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> *t
+		= new Tensor_Wrapper<device, dimension, typename FloatType<DType>::type>(
+			MakeTensor<BlackScholesTensor<device, dimension, typename FloatType<DType>::type,
+				device, dimension_spot, dimension_strike, dimension_vol, dimension_rate, dimension_tenor, DType> >(
+				*(spot._tensor), *(strike._tensor), *(vol._tensor), *(rate._tensor), *(tenor._tensor), (int)isCall));
+	return *t;
+}
+
+/**
+* Implied Volatility Operator: the Black-Scholes vols of call (or put) prices,
+* broadcast over spot, strike, rate and tenor like BlackScholes, e.g. a
+* Vector of prices over a Vector of strikes with scalar spot, rate and tenor
+*/
+template<typename device, size_t dimension_price, size_t dimension_spot, size_t dimension_strike,
+	size_t dimension_rate, size_t dimension_tenor, typename DType>
+XMATRIX_INLINE Tensor_Wrapper<device,
+	BroadcastDimension<dimension_price, dimension_spot, dimension_strike, dimension_rate, dimension_tenor>::value,
+	typename FloatType<DType>::type> &ImpliedVol(
+	Tensor_Wrapper<device, dimension_price, DType> &price, Tensor_Wrapper<device, dimension_spot, DType> &spot,
+	Tensor_Wrapper<device, dimension_strike, DType> &strike, Tensor_Wrapper<device, dimension_rate, DType> &rate,
+	Tensor_Wrapper<device, dimension_tenor, DType> &tenor, bool isCall = true) {
+	const size_t dimension = BroadcastDimension<dimension_price, dimension_spot, dimension_strike, dimension_rate, dimension_tenor>::value;
+	Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> *t
+		= new Tensor_Wrapper<device, dimension, typename FloatType<DType>::type>(
+			MakeTensor<ImpliedVolTensor<device, dimension, typename FloatType<DType>::type,
+				device, dimension_price, dimension_spot, dimension_strike, dimension_rate, dimension_tenor, DType> >(
+				*(price._tensor), *(spot._tensor), *(strike._tensor), *(rate._tensor), *(tenor._tensor), (int)isCall));
+	return *t;
+}
+
+/**
+* Surface Operator: a grid interpolated at query points by its patches of
+* the given order; the patch node depends on the grid and knots only, so
+* it is computed once per Load() of them however often the queries change
+*/
+template<typename device, size_t dimension_x, size_t dimension_y, typename DType>
+XMATRIX_INLINE Tensor_Wrapper<device, BroadcastDimension<dimension_x, dimension_y>::value,
+	typename FloatType<DType>::type> &Surface(
+	Tensor_Wrapper<device, 2, DType> &grid, Tensor_Wrapper<device, 1, DType> &rows, Tensor_Wrapper<device, 1, DType> &cols,
+	Tensor_Wrapper<device, dimension_x, DType> &x, Tensor_Wrapper<device, dimension_y, DType> &y, int order) {
+	const size_t dimension = BroadcastDimension<dimension_x, dimension_y>::value;
+	Tensor<device, 3, typename FloatType<DType>::type> *coefficients
+		= MakeTensor<SurfaceCoefficientsTensor<device, 3, typename FloatType<DType>::type, device, DType> >(
+			*(grid._tensor), *(rows._tensor), *(cols._tensor), order);
+	Tensor_Wrapper<device, dimension, typename FloatType<DType>::type> *t
+		= new Tensor_Wrapper<device, dimension, typename FloatType<DType>::type>(
+			MakeTensor<SurfaceTensor<device, dimension, typename FloatType<DType>::type,
+				device, dimension_x, dimension_y, DType> >(
+				*coefficients, *(rows._tensor), *(cols._tensor), *(x._tensor), *(y._tensor)));
+	return *t;
+}
+
+/**
+* Bilinear Operator: a grid of rows x cols values over increasing row and
+* column knots, e.g. a Matrix of vols by tenor and strike, interpolated
+* bilinearly at the points (x, y); x and y are scalars or have the trailing
+* extents of each other. Points outside the knots take the border values
+*/
+template<typename device, size_t dimension_x, size_t dimension_y, typename DType>
+XMATRIX_INLINE Tensor_Wrapper<device, BroadcastDimension<dimension_x, dimension_y>::value,
+	typename FloatType<DType>::type> &Bilinear(
+	Tensor_Wrapper<device, 2, DType> &grid, Tensor_Wrapper<device, 1, DType> &rows, Tensor_Wrapper<device, 1, DType> &cols,
+	Tensor_Wrapper<device, dimension_x, DType> &x, Tensor_Wrapper<device, dimension_y, DType> &y) {
+	return Surface(grid, rows, cols, x, y, 1);
+}
+
+/**
+* Cubic Spline Operator: a grid interpolated at the points (x, y) like
+* Bilinear, by the natural bicubic spline of the grid, which is twice
+* continuously differentiable across the cells
+*/
+template<typename device, size_t dimension_x, size_t dimension_y, typename DType>
+XMATRIX_INLINE Tensor_Wrapper<device, BroadcastDimension<dimension_x, dimension_y>::value,
+	typename FloatType<DType>::type> &CubicSpline(
+	Tensor_Wrapper<device, 2, DType> &grid, Tensor_Wrapper<device, 1, DType> &rows, Tensor_Wrapper<device, 1, DType> &cols,
+	Tensor_Wrapper<device, dimension_x, DType> &x, Tensor_Wrapper<device, dimension_y, DType> &y) {
+	return Surface(grid, rows, cols, x, y, 3);
+}
+
 /**
 * Abs Operator
 */
 template<typename device, size_t dimension, typename DType>
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, DType> &Abs(Tensor_Wrapper<device, dimension, DType> &src) {
-	Tensor_Wrapper<device, dimension, double> *t 
-		= new Tensor_Wrapper<device, dimension, double>(
-			new AbsTensor<device, dimension, DType, device, dimension, DType>(*(src._tensor)));
+	Tensor_Wrapper<device, dimension, DType> *t 
+		= new Tensor_Wrapper<device, dimension, DType>(
+			MakeTensor<AbsTensor<device, dimension, DType, device, dimension, DType> >(*(src._tensor)));
 	return *t;
 }
 
@@ -960,9 +1572,9 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, DType> &Abs(Tensor_Wrapper<devi
 */
 template<typename device, size_t dimension, typename DType>
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &Floor(Tensor_Wrapper<device, dimension, DType> &src) {
-	Tensor_Wrapper<device, dimension, double> *t 
-		= new Tensor_Wrapper<device, dimension, double>(
-			new FloorTensor<device, dimension, int, device, dimension, DType>(*(src._tensor)));
+	Tensor_Wrapper<device, dimension, int> *t 
+		= new Tensor_Wrapper<device, dimension, int>(
+			MakeTensor<FloorTensor<device, dimension, int, device, dimension, DType> >(*(src._tensor)));
 	return *t;
 }
 
@@ -971,9 +1583,9 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &Floor(Tensor_Wrapper<devi
 */
 template<typename device, size_t dimension, typename DType>
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &Ceil(Tensor_Wrapper<device, dimension, DType> &src) {
-	Tensor_Wrapper<device, dimension, double> *t 
-		= new Tensor_Wrapper<device, dimension, double>(
-			new CeilTensor<device, dimension, int, device, dimension, DType>(*(src._tensor)));
+	Tensor_Wrapper<device, dimension, int> *t 
+		= new Tensor_Wrapper<device, dimension, int>(
+			MakeTensor<CeilTensor<device, dimension, int, device, dimension, DType> >(*(src._tensor)));
 	return *t;
 }
 
@@ -982,9 +1594,9 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &Ceil(Tensor_Wrapper<devic
 */
 template<typename device, size_t dimension, typename DType>
 XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &Round(Tensor_Wrapper<device, dimension, DType> &src) {
-	Tensor_Wrapper<device, dimension, double> *t 
-		= new Tensor_Wrapper<device, dimension, double>(
-			new RoundTensor<device, dimension, int, device, dimension, DType>(*(src._tensor)));
+	Tensor_Wrapper<device, dimension, int> *t 
+		= new Tensor_Wrapper<device, dimension, int>(
+			MakeTensor<RoundTensor<device, dimension, int, device, dimension, DType> >(*(src._tensor)));
 	return *t;
 }
 
@@ -993,9 +1605,9 @@ XMATRIX_INLINE Tensor_Wrapper<device, dimension, int> &Round(Tensor_Wrapper<devi
 */
 template<typename device, size_t dimension, typename DType>
 XMATRIX_INLINE Tensor_Wrapper<device, 0, DType> &Sum(Tensor_Wrapper<device, dimension, DType> &src) {
-	Tensor_Wrapper<device, 0, double> *t 
-		= new Tensor_Wrapper<device, 0, double>(
-			new SumTensor<device, 0, DType, device, dimension, DType>(*(src._tensor)));
+	Tensor_Wrapper<device, 0, DType> *t 
+		= new Tensor_Wrapper<device, 0, DType>(
+			MakeTensor<SumTensor<device, 0, DType, device, dimension, DType> >(*(src._tensor)));
 	return *t;
 }
 
@@ -1004,9 +1616,31 @@ XMATRIX_INLINE Tensor_Wrapper<device, 0, DType> &Sum(Tensor_Wrapper<device, dime
 */
 template<typename device, size_t dimension, typename DType>
 XMATRIX_INLINE Tensor_Wrapper<device, 0, DType> &Mean(Tensor_Wrapper<device, dimension, DType> &src) {
-	Tensor_Wrapper<device, 0, double> *t 
-		= new Tensor_Wrapper<device, 0, double>(
-			new MeanTensor<device, 0, DType, device, dimension, DType>(*(src._tensor)));
+	Tensor_Wrapper<device, 0, DType> *t 
+		= new Tensor_Wrapper<device, 0, DType>(
+			MakeTensor<MeanTensor<device, 0, DType, device, dimension, DType> >(*(src._tensor)));
+	return *t;
+}
+
+/**
+* Batch Sum Operator: one sum per entry of the leading batch axis
+*/
+template<typename device, size_t dimension, typename DType>
+XMATRIX_INLINE Tensor_Wrapper<device, 1, DType> &BatchSum(Tensor_Wrapper<device, dimension, DType> &src) {
+	Tensor_Wrapper<device, 1, DType> *t 
+		= new Tensor_Wrapper<device, 1, DType>(
+			MakeTensor<SumTensor<device, 1, DType, device, dimension, DType> >(*(src._tensor)));
+	return *t;
+}
+
+/**
+* Batch Mean Operator: one mean per entry of the leading batch axis
+*/
+template<typename device, size_t dimension, typename DType>
+XMATRIX_INLINE Tensor_Wrapper<device, 1, DType> &BatchMean(Tensor_Wrapper<device, dimension, DType> &src) {
+	Tensor_Wrapper<device, 1, DType> *t 
+		= new Tensor_Wrapper<device, 1, DType>(
+			MakeTensor<MeanTensor<device, 1, DType, device, dimension, DType> >(*(src._tensor)));
 	return *t;
 }
 
@@ -2,6 +2,11 @@
 #define XMATRIX_TENSOR_H_
 
 #include "common.h"
+#include "dual.h"
+#include "thread-pool.h"
+
+#include <unordered_map>
+#include <atomic>
 
 namespace xmatrix {
 /**
@@ -65,10 +70,10 @@ struct Shape {
 	}
 
 	XMATRIX_INLINE Shape<dimension - 1> SubShape() const {
-		Shape<dimension - 1> *s = new Shape<dimension - 1>();
+		Shape<dimension - 1> s;
 		for (size_t i=0; i<dimension-1; i++)
-			s->_shape[i] = _shape[i+1];
-		return *s;
+			s._shape[i] = _shape[i+1];
+		return s;
 	}
 }; // struct Shape<dimension>
 
@@ -91,7 +96,7 @@ struct Shape<0> {
 		return 1;
 	}
 
-	XMATRIX_INLINE Shape<0> SubShape() {
+	XMATRIX_INLINE Shape<0> SubShape() const {
 		return Shape<0>();
 	}
 
@@ -114,20 +119,25 @@ XMATRIX_INLINE std::ostream &operator<<(std::ostream &os, Shape<0> d) {
 }
 
 XMATRIX_INLINE Shape<0> Shape0() {
-	Shape<0> *s = new Shape<0>();
-	return *s;
+	return Shape<0>();
 }
 
 XMATRIX_INLINE Shape<1> Shape1(size_t s0) {
-	Shape<1> *s = new Shape<1>();
-	(*s)[0] = s0;
-	return *s;
+	Shape<1> s;
+	s[0] = s0;
+	return s;
 }
 
 XMATRIX_INLINE Shape<2> Shape2(size_t s0, size_t s1) {
-	Shape<2> *s = new Shape<2>();
-	(*s)[0] = s0; (*s)[1] = s1;
-	return *s;
+	Shape<2> s;
+	s[0] = s0; s[1] = s1;
+	return s;
+}
+
+XMATRIX_INLINE Shape<3> Shape3(size_t s0, size_t s1, size_t s2) {
+	Shape<3> s;
+	s[0] = s0; s[1] = s1; s[2] = s2;
+	return s;
 }
 
 /**
@@ -141,13 +151,306 @@ struct Random {
 	static const bool _isGPU = device::_isGPU;
 };
 
+struct AbstractTensor;
+struct Graph;
+
+/**
+* JIT Code: what a node sees of the kernel being generated for it (see
+* jit.h). Nodes describe element index of themselves as a C++ expression of
+* the same elements of their inputs
+*/
+struct JitCode {
+	/**
+	* Expression of element index of an input, expanded in place if the input
+	* is inlined into the kernel, read from its buffer otherwise
+	*/
+	virtual bool Operand(AbstractTensor &node, const std::string &index, std::string &expr) = 0;
+
+	/**
+	* Name of the kernel argument pointing to the buffer of a node
+	*/
+	virtual std::string Argument(AbstractTensor &node, const char *type) = 0;
+};
+
+/**
+* Element index of an operand broadcast over total elements
+*/
+XMATRIX_INLINE std::string JitIndex(const std::string &index, size_t size, size_t total) {
+	if (size == total)
+		return index;
+	if (size == 1)
+		return "0";
+	std::ostringstream os;
+	os << "(" << index << ") % " << size;
+	return os.str();
+}
+
+/**
+* C++ spelling of a DType in generated code, NULL for types the JIT does not
+* generate (duals)
+*/
+template<typename DType>
+XMATRIX_INLINE const char *CTypeName() { return NULL; }
+template<> XMATRIX_INLINE const char *CTypeName<double>() { return "double"; }
+template<> XMATRIX_INLINE const char *CTypeName<float>() { return "float"; }
+template<> XMATRIX_INLINE const char *CTypeName<int>() { return "int"; }
+template<> XMATRIX_INLINE const char *CTypeName<long>() { return "long"; }
+template<> XMATRIX_INLINE const char *CTypeName<long long>() { return "long long"; }
+template<> XMATRIX_INLINE const char *CTypeName<unsigned>() { return "unsigned"; }
+template<> XMATRIX_INLINE const char *CTypeName<size_t>() { return "size_t"; }
+
+/**
+* Tensor Cache: hash-consing table of the graph-building mode. While a cache
+* is alive the operators return the existing node for a subexpression that
+* was already built (same op, operands and parameters) instead of a copy.
+* Caches are active per thread
+*/
+struct TensorCache {
+	std::unordered_map<std::string, AbstractTensor *> _nodes;
+	TensorCache *_previous;
+
+	XMATRIX_INLINE TensorCache() : _previous(Active()) {
+		Active() = this;
+	}
+
+	XMATRIX_INLINE ~TensorCache() {
+		Active() = _previous;
+	}
+
+	XMATRIX_INLINE static TensorCache *&Active() {
+		static thread_local TensorCache *active = NULL;
+		return active;
+	}
+
+	XMATRIX_INLINE void Forget(const std::string &key, AbstractTensor *node) {
+		std::unordered_map<std::string, AbstractTensor *>::iterator it = _nodes.find(key);
+		if (it != _nodes.end() && it->second == node)
+			_nodes.erase(it);
+	}
+};
+
+/**
+* Abstract Tensor: the part of a node independent of device, dimension and
+* DType. Each node records the nodes it reads (_inputs) and the nodes reading
+* it (_consumers), so that loading a leaf invalidates exactly the nodes
+* computed from it and Update() keeps the cached results of all the others
+*/
+struct AbstractTensor {
+	std::vector<AbstractTensor *> _inputs;
+	std::vector<AbstractTensor *> _consumers;
+
+	bool _isUpdated;
+	size_t _epoch;
+	size_t _owners; // wrappers holding the node as their result
+	bool _isConstant; // literal, or computed from literals only
+	Graph *_graph; // arena owning the node, NULL for nodes on the heap
+	std::string _params; // operator parameters by value (exponents, indices, shapes)
+	bool _hasShape; // extents known: loaded, or inferred from inputs which have theirs
+	std::vector<std::pair<TensorCache *, std::string> > _cacheKeys; // entries of the node in caches
+
+	XMATRIX_INLINE AbstractTensor() : _isUpdated(false), _epoch(0), _owners(0), _isConstant(false), _graph(NULL), 
+		_hasShape(false) {}
+
+	XMATRIX_INLINE virtual ~AbstractTensor() {
+		for (size_t k = 0; k < _cacheKeys.size(); k++) {
+			for (TensorCache *cache = TensorCache::Active(); cache != NULL; cache = cache->_previous) {
+				if (cache == _cacheKeys[k].first) {
+					cache->Forget(_cacheKeys[k].second, this);
+					break;
+				}
+			}
+		}
+		for (size_t i = 0; i < _inputs.size(); i++)
+			Unlink(_inputs[i]->_consumers, this);
+		for (size_t i = 0; i < _consumers.size(); i++)
+			Unlink(_consumers[i]->_inputs, this);
+	}
+
+	/**
+	* Enters the node in cache under key; the destructor erases it by that
+	* key from the caches still active
+	*/
+	XMATRIX_INLINE void Cache(TensorCache *cache, const std::string &key) {
+		cache->_nodes[key] = this;
+		_cacheKeys.push_back(std::make_pair(cache, key));
+	}
+
+	XMATRIX_INLINE void AddInput(AbstractTensor &input) {
+		_inputs.push_back(&input);
+		input._consumers.push_back(this);
+	}
+
+	/**
+	* Marks this node and every node computed from it as stale; a node reached
+	* along several paths is visited once per invalidation epoch
+	*/
+	XMATRIX_INLINE void Invalid() {
+		Invalid(++Epoch());
+	}
+
+	XMATRIX_INLINE virtual void Invalid(size_t epoch) {
+		if (_epoch == epoch)
+			return;
+		_epoch = epoch;
+		_isUpdated = false;
+		for (size_t i = 0; i < _consumers.size(); i++)
+			_consumers[i]->Invalid(epoch);
+	}
+
+	/**
+	* Update() brings the node up to date; with all inputs up to date it only
+	* computes the node itself, which lets the scheduler run nodes one by one
+	*/
+	virtual void Update() = 0;
+
+	virtual bool IsElementwise() const = 0;
+
+	/**
+	* whether Update() pulls elementwise inputs through Fetch, so they can be
+	* fused into this node instead of being materialized
+	*/
+	XMATRIX_INLINE virtual bool StreamsInputs() const {
+		return IsElementwise();
+	}
+
+	/**
+	* Whether the node belongs to a fast math Graph
+	*/
+	XMATRIX_INLINE bool IsFastMath() const;
+
+	/**
+	* Execute() computes the node alone, its inputs up to date and its shape
+	* and buffer left by an earlier Update(): no recursion, no shape checks
+	* and no allocation, the instruction of a compiled Plan. Nodes without a
+	* kernel of their own go through Update()
+	*/
+	XMATRIX_INLINE virtual void Execute() {
+		_isUpdated = false;
+		Update();
+	}
+
+	/**
+	* Appends the extents of the node to key
+	*/
+	virtual void ShapeKey(std::string &key) const = 0;
+
+	virtual void PrintShape(std::ostream &os) const = 0;
+
+	/**
+	* Shape Inference: InferShape() sets the extents of the node from the
+	* extents of its inputs without computing anything, and returns false if
+	* they do not fit together. CheckShape() runs it once all inputs have
+	* their extents and reports mismatches; operators check their shapes when
+	* they are built, evaluations before any node is computed
+	*/
+	XMATRIX_INLINE virtual bool InferShape() {
+		return true;
+	}
+
+	XMATRIX_INLINE void CheckShape() {
+		if (_inputs.empty())
+			return;
+		_hasShape = true;
+		for (size_t i = 0; i < _inputs.size(); i++)
+			_hasShape = _hasShape && _inputs[i]->_hasShape;
+		if (_hasShape && !InferShape()) {
+			cerr << "Shape mismatch in " << typeid(*this).name() << " of";
+			for (size_t i = 0; i < _inputs.size(); i++) {
+				cerr << " ";
+				_inputs[i]->PrintShape(cerr);
+			}
+			cerr << endl;
+			assert(false);
+		}
+	}
+
+	/**
+	* Memory Planning (see Plan): MemSize() is the size in bytes of the
+	* buffer the node allocates for its shape, 0 for views into their input,
+	* and Bind() places that buffer in a block owned by someone else, or
+	* drops it for NULL. FreeMem() gives the buffer back, the node must be
+	* computed again before it is read (see BudgetedEvaluation)
+	*/
+	virtual size_t MemSize() const = 0;
+
+	/**
+	* IsView() tells a node reading its elements from the buffer of its first
+	* input, with none of its own; IsDense() that the elements of the node
+	* will be row-major without gaps, from the extents alone, so that both
+	* are known before anything runs
+	*/
+	XMATRIX_INLINE virtual bool IsView() const {
+		return false;
+	}
+
+	XMATRIX_INLINE virtual bool IsDense() const {
+		return true;
+	}
+
+	virtual void Bind(void *block) = 0;
+
+	virtual void FreeMem() = 0;
+
+	/**
+	* JIT (see jit.h): Emit() writes element index of the node as an
+	* expression of its inputs, EmitLoad() as a read of its buffer, and
+	* EmitKernel() the statements computing the whole node. All return false
+	* for nodes the JIT cannot generate, which keep their Execute()
+	*/
+	XMATRIX_INLINE virtual bool Emit(JitCode &, const std::string &, std::string &) {
+		return false;
+	}
+
+	XMATRIX_INLINE virtual bool EmitLoad(JitCode &, const std::string &, std::string &) {
+		return false;
+	}
+
+	XMATRIX_INLINE virtual bool EmitKernel(JitCode &, std::string &) {
+		return false;
+	}
+
+	virtual const char *TypeName() const = 0;
+
+	virtual void *Buffer() const = 0;
+
+	/**
+	* Reverse-mode differentiation (see Tape): ClearGrad() sizes the adjoint
+	* of the node to its shape and zeroes it, SeedGrad() sets it to ones, and
+	* Backward() adds the adjoint times the local derivatives of the node to
+	* the adjoints of its inputs
+	*/
+	virtual void ClearGrad() = 0;
+
+	virtual void SeedGrad() = 0;
+
+	XMATRIX_INLINE virtual void Backward() {}
+
+	/**
+	* Shared by the threads loading leaves, each invalidation takes a fresh
+	* epoch
+	*/
+	XMATRIX_INLINE static std::atomic<size_t> &Epoch() {
+		static std::atomic<size_t> epoch(0);
+		return epoch;
+	}
+
+	XMATRIX_INLINE static void Unlink(std::vector<AbstractTensor *> &nodes, AbstractTensor *node) {
+		for (size_t i = 0; i < nodes.size(); i++) {
+			if (nodes[i] == node) {
+				nodes.erase(nodes.begin() + i);
+				return;
+			}
+		}
+	}
+};
+
 /**
 * Tensor Definition
 */
 template<typename device, size_t dimension, typename DType>
-struct Tensor {
+struct Tensor : public AbstractTensor {
 	static_assert(is_base_of<AbstractDevice, device>::value, "Target device not supported!");
-	static_assert(is_integral<DType>::value || is_floating_point<DType>::value, "DType supports integral and float point only!");
+	static_assert(IsElementType<DType>::value, "DType supports integral, float point and dual only!");
 	static const bool _isCPU = device::_isCPU;
 	static const bool _isGPU = device::_isGPU;
 
@@ -155,12 +458,15 @@ struct Tensor {
 	const bool _isLeaf;
 	
 	Shape<dimension> _shape;
-	size_t _stride;
+	size_t _stride; // elements between two entries of the leading dimension
+	size_t _innerStride; // elements between two entries of the last dimension
 	DType *_ptr;
-
-	bool _isUpdated;
+	size_t _capacity; // elements owned by _ptr, 0 for views into another tensor
+	bool _isBound; // _ptr lies in a block bound by a Plan, not freed here
+	std::vector<DType> _grad; // adjoint, contiguous even for views
 	
-	XMATRIX_INLINE Tensor(bool isLeaf = true) : _ptr(NULL), _isLeaf(isLeaf), _isUpdated(false) {}
+	XMATRIX_INLINE Tensor(bool isLeaf = true) : _stride(1), _innerStride(1), _ptr(NULL), _capacity(0), _isBound(false), 
+		_isLeaf(isLeaf) {}
 
 	XMATRIX_INLINE virtual ~Tensor() { FreeMem(); }
 
@@ -172,21 +478,37 @@ struct Tensor {
 		}
 	}
 
+	/**
+	* The buffer is kept across calls and only reallocated when the shape
+	* outgrows it; its contents are left uninitialized
+	*/
 	XMATRIX_INLINE void AllocMem(Shape<dimension> shape) {
-		Invalid();
-		FreeMem();
 		_shape = shape;
+		_hasShape = true;
 		_stride = shape.SubShape().getSize();
-		if (_isCPU)
-			_ptr = (DType*)calloc(_shape.getSize(), sizeof(DType));
+		_innerStride = 1;
+		if (_isCPU && _shape.getSize() > _capacity) {
+			FreeMem();
+			_ptr = (DType*)malloc(_shape.getSize() * sizeof(DType));
+			_capacity = _shape.getSize();
+		}
 	}
 
-	XMATRIX_INLINE void FreeMem() {
-		if (_ptr != NULL) {
+	XMATRIX_INLINE virtual void FreeMem() {
+		if (_ptr != NULL && _capacity > 0 && !_isBound) {
 			if (_isCPU)
 				free(_ptr);
 		}
 		_ptr = NULL;
+		_capacity = 0;
+		_isBound = false;
+	}
+
+	XMATRIX_INLINE virtual void Bind(void *block) {
+		FreeMem();
+		_ptr = (DType *)block;
+		_capacity = (block != NULL)? _shape.getSize() : 0;
+		_isBound = block != NULL;
 	}
 
 	XMATRIX_INLINE Tensor<device, dimension - 1, DType> &operator[](size_t index) const {
@@ -200,18 +522,88 @@ struct Tensor {
 	}
 
 	XMATRIX_INLINE virtual void Update() {
-		_isUpdated = true;
+		// read-only once up to date, leaves are shared by nodes running in parallel
+		if (!_isUpdated)
+			_isUpdated = true;
 	}
 
-	XMATRIX_INLINE virtual void Invalid() {
-		_isUpdated = false;
+	/**
+	* Streaming interface of the elementwise fusion pass: Prepare() readies
+	* the node for Fetch(), which returns elements [offset, offset + length)
+	* either from the materialized buffer or computed into the given buffer
+	*/
+	XMATRIX_INLINE virtual bool IsElementwise() const {
+		return false;
+	}
+
+	XMATRIX_INLINE virtual void Prepare() {
+		Update();
+	}
+
+	/**
+	* Views into another tensor (slices, subscripts) may be strided, their
+	* elements are gathered into the buffer in row-major order
+	*/
+	XMATRIX_INLINE virtual const DType *Fetch(size_t offset, size_t length, DType *buffer) {
+		if (IsContiguous())
+			return _ptr + offset;
+
+		size_t inner = _shape.SubShape().getSize();
+		size_t row = offset / inner, col = offset % inner;
+		for (size_t i = 0; i < length; i++) {
+			buffer[i] = _ptr[row * _stride + col * _innerStride];
+			if (++col == inner) {
+				col = 0;
+				row++;
+			}
+		}
+		return buffer;
+	}
+
+	XMATRIX_INLINE bool IsContiguous() const {
+		return _innerStride == 1 && _stride == _shape.SubShape().getSize();
+	}
+
+	XMATRIX_INLINE virtual void ClearGrad() {
+		_grad.assign(_shape.getSize(), DType(0));
+	}
+
+	XMATRIX_INLINE virtual void SeedGrad() {
+		_grad.assign(_shape.getSize(), DType(1));
+	}
+
+	XMATRIX_INLINE virtual void ShapeKey(std::string &key) const {
+		key.append((const char *)&_shape[0], dimension * sizeof(size_t));
+	}
+
+	XMATRIX_INLINE virtual void PrintShape(std::ostream &os) const {
+		os << _shape;
+	}
+
+	XMATRIX_INLINE virtual size_t MemSize() const {
+		return _shape.getSize() * sizeof(DType);
+	}
+
+	XMATRIX_INLINE virtual bool EmitLoad(JitCode &code, const std::string &index, std::string &expr) {
+		if (CTypeName<DType>() == NULL || !IsContiguous())
+			return false;
+		expr = code.Argument(*this, CTypeName<DType>()) + "[" + index + "]";
+		return true;
+	}
+
+	XMATRIX_INLINE virtual const char *TypeName() const {
+		return CTypeName<DType>();
+	}
+
+	XMATRIX_INLINE virtual void *Buffer() const {
+		return _ptr;
 	}
 }; // struct Tensor
 
 template<typename device, typename DType>
-struct Tensor<device, 0, DType> {
+struct Tensor<device, 0, DType> : public AbstractTensor {
 	static_assert(is_base_of<AbstractDevice, device>::value, "Device supports cpu and gpu only!");
-	static_assert(is_integral<DType>::value || is_floating_point<DType>::value, "DType supports integral and float point only!");
+	static_assert(IsElementType<DType>::value, "DType supports integral, float point and dual only!");
 	static const bool _isCPU = device::_isCPU;
 	static const bool _isGPU = device::_isGPU;
 
@@ -220,11 +612,16 @@ struct Tensor<device, 0, DType> {
 	
 	Shape<0> _shape;
 	size_t _stride;
+	size_t _innerStride;
 	DType *_ptr;
-
-	bool _isUpdated;
+	size_t _capacity; // elements owned by _ptr, 0 for views into another tensor
+	bool _isBound; // _ptr lies in a block bound by a Plan, not freed here
+	std::vector<DType> _grad;
 	
-	XMATRIX_INLINE Tensor(bool isLeaf = true) : _isLeaf(isLeaf), _ptr(NULL), _isUpdated(false) {}
+	XMATRIX_INLINE Tensor(bool isLeaf = true) : _isLeaf(isLeaf), _stride(1), _innerStride(1), _ptr(NULL), _capacity(0), 
+		_isBound(false) {
+		_hasShape = true;
+	}
 
 	XMATRIX_INLINE virtual ~Tensor() { FreeMem(); }
 
@@ -236,29 +633,91 @@ struct Tensor<device, 0, DType> {
 		}
 	}
 
+	/**
+	* The buffer is kept across calls and only reallocated when the shape
+	* outgrows it; its contents are left uninitialized
+	*/
 	XMATRIX_INLINE void AllocMem(Shape<0> shape = Shape0()) {
-		Invalid();
-		FreeMem();
 		_shape = shape;
+		_hasShape = true;
 		_stride = shape.SubShape().getSize();
-		if (_isCPU)
-			_ptr = (DType*)calloc(_shape.getSize(), sizeof(DType));
+		_innerStride = 1;
+		if (_isCPU && _shape.getSize() > _capacity) {
+			FreeMem();
+			_ptr = (DType*)malloc(_shape.getSize() * sizeof(DType));
+			_capacity = _shape.getSize();
+		}
 	}
 
-	XMATRIX_INLINE void FreeMem() {
-		if (_ptr != NULL) {
+	XMATRIX_INLINE virtual void FreeMem() {
+		if (_ptr != NULL && _capacity > 0 && !_isBound) {
 			if (_isCPU)
 				free(_ptr);
 		}
 		_ptr = NULL;
+		_capacity = 0;
+		_isBound = false;
+	}
+
+	XMATRIX_INLINE virtual void Bind(void *block) {
+		FreeMem();
+		_ptr = (DType *)block;
+		_capacity = (block != NULL)? _shape.getSize() : 0;
+		_isBound = block != NULL;
 	}
 
 	XMATRIX_INLINE virtual void Update() {
-		_isUpdated = true;
+		if (!_isUpdated)
+			_isUpdated = true;
 	}
 
-	XMATRIX_INLINE virtual void Invalid() {
-		_isUpdated = false;
+	XMATRIX_INLINE virtual bool IsElementwise() const {
+		return false;
+	}
+
+	XMATRIX_INLINE virtual void Prepare() {
+		Update();
+	}
+
+	XMATRIX_INLINE virtual const DType *Fetch(size_t offset, size_t length, DType *buffer) {
+		return _ptr + offset;
+	}
+
+	XMATRIX_INLINE bool IsContiguous() const {
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void ClearGrad() {
+		_grad.assign(1, DType(0));
+	}
+
+	XMATRIX_INLINE virtual void SeedGrad() {
+		_grad.assign(1, DType(1));
+	}
+
+	XMATRIX_INLINE virtual void ShapeKey(std::string &key) const {}
+
+	XMATRIX_INLINE virtual void PrintShape(std::ostream &os) const {
+		os << _shape;
+	}
+
+	XMATRIX_INLINE virtual size_t MemSize() const {
+		return sizeof(DType);
+	}
+
+	XMATRIX_INLINE virtual bool EmitLoad(JitCode &code, const std::string &index, std::string &expr) {
+		if (CTypeName<DType>() == NULL)
+			return false;
+		expr = code.Argument(*this, CTypeName<DType>()) + "[0]";
+		return true;
+	}
+
+	XMATRIX_INLINE virtual const char *TypeName() const {
+		return CTypeName<DType>();
+	}
+
+	XMATRIX_INLINE virtual void *Buffer() const {
+		return _ptr;
 	}
 }; 
 
@@ -268,6 +727,7 @@ XMATRIX_INLINE ostream &operator<<(ostream &os, Tensor<device, dimension, DType>
 		Tensor<device, dimension - 1, DType> &t0 = t[0];
 		t0.Update();
 		os << "[" << t0;
+		delete &t0;
 		for (size_t i = 1; i < t._shape[0]; i++) {
 			Tensor<device, dimension - 1, DType> &ti = t[i];
 			ti.Update();
@@ -276,6 +736,7 @@ XMATRIX_INLINE ostream &operator<<(ostream &os, Tensor<device, dimension, DType>
 				os << endl << " ";
 			}
 			os << ti;
+			delete &ti;
 		}
 		os << "]";
 	}
@@ -296,17 +757,14 @@ struct UnaryDeducedTensor : public Tensor<device_dest, dimension_dest, DType_des
 	Tensor<device_src, dimension_src, DType_src> &_src;
 
 	XMATRIX_INLINE UnaryDeducedTensor(Tensor<device_src, dimension_src, DType_src> &src) 
-		: Tensor<device_dest, dimension_dest, DType_dest>(false), _src(src) {}
+		: Tensor<device_dest, dimension_dest, DType_dest>(false), _src(src) {
+		AddInput(src);
+	}
 
 	XMATRIX_INLINE virtual void Update() {
 		Tensor<device_dest, dimension_dest, DType_dest>::Update();
 		_src.Update();
 	}
-
-	XMATRIX_INLINE virtual void Invalid() {
-		Tensor<device_dest, dimension_dest, DType_dest>::Invalid();
-		_src.Invalid();
-	}
 };
 
 template<typename device_dest, size_t dimension_dest, typename DType_dest,
@@ -319,19 +777,305 @@ struct BinaryDeducedTensor : public Tensor<device_dest, dimension_dest, DType_de
 	XMATRIX_INLINE BinaryDeducedTensor(
 		Tensor<device_lhs, dimension_lhs, DType_lhs> &lhs, 
 		Tensor<device_rhs, dimension_rhs, DType_rhs> &rhs) 
-		: Tensor<device_dest, dimension_dest, DType_dest>(false), _lhs(lhs), _rhs(rhs) {}
+		: Tensor<device_dest, dimension_dest, DType_dest>(false), _lhs(lhs), _rhs(rhs) {
+		AddInput(lhs);
+		AddInput(rhs);
+	}
 
 	XMATRIX_INLINE virtual void Update() {
 		Tensor<device_dest, dimension_dest, DType_dest>::Update();
 		_lhs.Update();
 		_rhs.Update();
 	}
+};
+
+/**
+* Shape of an elementwise result. Scalar operands are broadcast, and so is an
+* operand with fewer dimensions whose extents match the trailing ones of the
+* other: it is repeated along the leading (batch) axes. False if the
+* extents do not match
+*/
+template<size_t dimension>
+XMATRIX_INLINE bool BroadcastShape(Shape<dimension> &dest, const Shape<dimension> &lhs, const Shape<dimension> &rhs) {
+	dest = lhs;
+	return lhs == rhs;
+}
+
+template<size_t dimension>
+XMATRIX_INLINE bool BroadcastShape(Shape<dimension> &dest, const Shape<dimension> &lhs, const Shape<0> &rhs) {
+	dest = lhs;
+	return true;
+}
+
+template<size_t dimension>
+XMATRIX_INLINE bool BroadcastShape(Shape<dimension> &dest, const Shape<0> &lhs, const Shape<dimension> &rhs) {
+	dest = rhs;
+	return true;
+}
+
+XMATRIX_INLINE bool BroadcastShape(Shape<0> &dest, const Shape<0> &lhs, const Shape<0> &rhs) {
+	return true;
+}
+
+template<size_t dimension, size_t dimension_rhs>
+XMATRIX_INLINE bool BroadcastShape(Shape<dimension> &dest, const Shape<dimension> &lhs, const Shape<dimension_rhs> &rhs) {
+	static_assert(dimension_rhs < dimension, "Error: broadcast operand has more dimensions than the result");
+	dest = lhs;
+	for (size_t i = 0; i < dimension_rhs; i++)
+		if (lhs[dimension - dimension_rhs + i] != rhs[i])
+			return false;
+	return true;
+}
+
+template<size_t dimension, size_t dimension_lhs>
+XMATRIX_INLINE bool BroadcastShape(Shape<dimension> &dest, const Shape<dimension_lhs> &lhs, const Shape<dimension> &rhs) {
+	return BroadcastShape(dest, rhs, lhs);
+}
+
+/**
+* Broadcast of more than two operands: dest is taken from the first operand
+* having all its dimensions, then every operand is checked against it with
+* BroadcastShape(dest, dest, operand)
+*/
+template<size_t dimension>
+XMATRIX_INLINE void SeedShape(Shape<dimension> &dest, bool &isSet, const Shape<dimension> &src) {
+	if (!isSet) {
+		dest = src;
+		isSet = true;
+	}
+}
+
+template<size_t dimension, size_t dimension_src>
+XMATRIX_INLINE void SeedShape(Shape<dimension> &dest, bool &isSet, const Shape<dimension_src> &src) {}
+
+/**
+* Elements [offset, offset + length) of an operand repeated along the batch
+* axes of the result, a block may wrap around its end
+*/
+template<typename Operand, typename DType>
+XMATRIX_INLINE const DType *FetchRepeated(Operand &operand, size_t offset, size_t length, DType *buffer) {
+	size_t size = operand._shape.getSize();
+	offset %= size;
+	if (offset + length <= size)
+		return operand.Fetch(offset, length, buffer);
+
+	for (size_t i = 0; i < length; offset = 0) {
+		size_t n = (length - i < size - offset)? length - i : size - offset;
+		const DType *p = operand.Fetch(offset, n, buffer + i);
+		if (p != buffer + i)
+			std::copy(p, p + n, buffer + i);
+		i += n;
+	}
+	return buffer;
+}
+
+/**
+* Elementwise Kernel: one loop writing the expression of every element
+*/
+template<typename device, size_t dimension, typename DType>
+XMATRIX_INLINE bool EmitElementwise(Tensor<device, dimension, DType> &node, JitCode &code, std::string &body) {
+	std::string expr;
+	const char *type = CTypeName<DType>();
+	if (type == NULL || !node.Emit(code, "i", expr))
+		return false;
+	std::ostringstream os;
+	os << "\tfor (size_t i = 0; i < " << node._shape.getSize() << "; i++)\n"
+		<< "\t\t" << code.Argument(node, type) << "[i] = (" << type << ")(" << expr << ");\n";
+	body = os.str();
+	return true;
+}
+
+/**
+* Elementwise Tensor: element i of the result depends on element i of the
+* operands only, so a chain of them is evaluated by the topmost node in one
+* streaming pass of XMATRIX_FUSION_BLOCK sized blocks, and the nodes below
+* it never materialize their buffers
+*/
+template<typename device_dest, size_t dimension_dest, typename DType_dest,
+	typename device_src, size_t dimension_src, typename DType_src>
+struct UnaryElementwiseTensor : public UnaryDeducedTensor<device_dest, dimension_dest, DType_dest, device_src, dimension_src, DType_src> {
+
+	XMATRIX_INLINE UnaryElementwiseTensor(Tensor<device_src, dimension_src, DType_src> &src) 
+		: UnaryDeducedTensor<device_dest, dimension_dest, DType_dest, device_src, dimension_src, DType_src>(src) {}
+
+	XMATRIX_INLINE virtual bool IsElementwise() const {
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Prepare() {
+		if (!_isUpdated) {
+			_src.Prepare();
+			CheckShape();
+		}
+	}
+
+	XMATRIX_INLINE virtual bool InferShape() {
+		_shape = _src._shape;
+		return true;
+	}
+
+	XMATRIX_INLINE virtual const DType_dest *Fetch(size_t offset, size_t length, DType_dest *buffer) {
+		if (_isUpdated)
+			return _ptr + offset;
+		Compute(offset, length, buffer);
+		return buffer;
+	}
+
+	XMATRIX_INLINE virtual void Update() {
+		if (!_isUpdated) {
+			Prepare();
+			AllocMem(_shape);
+			Execute();
+			_isUpdated = true;
+		}
+	}
+
+	XMATRIX_INLINE virtual void Execute() {
+		size_t size = _shape.getSize();
+		ParallelFor(0, (size + XMATRIX_FUSION_BLOCK - 1) / XMATRIX_FUSION_BLOCK, 64, [this, size](size_t first, size_t last) {
+			for (size_t i = first * XMATRIX_FUSION_BLOCK; i < size && i < last * XMATRIX_FUSION_BLOCK; i += XMATRIX_FUSION_BLOCK)
+				Compute(i, (size - i < XMATRIX_FUSION_BLOCK)? size - i : XMATRIX_FUSION_BLOCK, _ptr + i);
+		});
+	}
+
+	XMATRIX_INLINE void Compute(size_t offset, size_t length, DType_dest *dest) {
+		DType_src buffer[XMATRIX_FUSION_BLOCK];
+		Kernel(_src.Fetch(offset, length, buffer), dest, length);
+	}
+
+	XMATRIX_INLINE bool EmitOperand(JitCode &code, const std::string &index, std::string &src) {
+		return code.Operand(_src, index, src);
+	}
 
-	XMATRIX_INLINE virtual void Invalid() {
-		Tensor<device_dest, dimension_dest, DType_dest>::Invalid();
-		_lhs.Invalid();
-		_rhs.Invalid();
+	XMATRIX_INLINE virtual bool EmitKernel(JitCode &code, std::string &body) {
+		return EmitElementwise(*this, code, body);
+	}
+
+	virtual void Kernel(const DType_src *src, DType_dest *dest, size_t length) = 0;
+
+	XMATRIX_INLINE virtual void Backward() {
+		size_t size = _shape.getSize();
+		for (size_t i = 0; i < size; i += XMATRIX_FUSION_BLOCK) {
+			size_t length = (size - i < XMATRIX_FUSION_BLOCK)? size - i : XMATRIX_FUSION_BLOCK;
+			DType_src buffer[XMATRIX_FUSION_BLOCK];
+			Adjoint(_src.Fetch(i, length, buffer), _ptr + i, &_grad[i], &_src._grad[i], length);
+		}
 	}
+
+	/**
+	* Adds grad times d dest / d src to gradSrc, nothing for the piecewise
+	* constant ops
+	*/
+	XMATRIX_INLINE virtual void Adjoint(const DType_src *src, const DType_dest *dest, const DType_dest *grad, 
+		DType_src *gradSrc, size_t length) {}
+};
+
+template<typename device_dest, size_t dimension_dest, typename DType_dest,
+	typename device_lhs, size_t dimension_lhs, typename DType_lhs,
+	typename device_rhs, size_t dimension_rhs, typename DType_rhs>
+struct BinaryElementwiseTensor : public BinaryDeducedTensor<device_dest, dimension_dest, DType_dest, device_lhs, dimension_lhs, DType_lhs, device_rhs, dimension_rhs, DType_rhs> {
+
+	XMATRIX_INLINE BinaryElementwiseTensor(
+		Tensor<device_lhs, dimension_lhs, DType_lhs> &lhs, 
+		Tensor<device_rhs, dimension_rhs, DType_rhs> &rhs) 
+		: BinaryDeducedTensor<device_dest, dimension_dest, DType_dest, device_lhs, dimension_lhs, DType_lhs, device_rhs, dimension_rhs, DType_rhs>(lhs, rhs) {}
+
+	XMATRIX_INLINE virtual bool IsElementwise() const {
+		return true;
+	}
+
+	XMATRIX_INLINE virtual void Prepare() {
+		if (!_isUpdated) {
+			_lhs.Prepare();
+			_rhs.Prepare();
+			CheckShape();
+		}
+	}
+
+	XMATRIX_INLINE virtual bool InferShape() {
+		return BroadcastShape(_shape, _lhs._shape, _rhs._shape);
+	}
+
+	XMATRIX_INLINE virtual const DType_dest *Fetch(size_t offset, size_t length, DType_dest *buffer) {
+		if (_isUpdated)
+			return _ptr + offset;
+		Compute(offset, length, buffer);
+		return buffer;
+	}
+
+	XMATRIX_INLINE virtual void Update() {
+		if (!_isUpdated) {
+			Prepare();
+			AllocMem(_shape);
+			Execute();
+			_isUpdated = true;
+		}
+	}
+
+	XMATRIX_INLINE virtual void Execute() {
+		size_t size = _shape.getSize();
+		ParallelFor(0, (size + XMATRIX_FUSION_BLOCK - 1) / XMATRIX_FUSION_BLOCK, 64, [this, size](size_t first, size_t last) {
+			for (size_t i = first * XMATRIX_FUSION_BLOCK; i < size && i < last * XMATRIX_FUSION_BLOCK; i += XMATRIX_FUSION_BLOCK)
+				Compute(i, (size - i < XMATRIX_FUSION_BLOCK)? size - i : XMATRIX_FUSION_BLOCK, _ptr + i);
+		});
+	}
+
+	XMATRIX_INLINE void Compute(size_t offset, size_t length, DType_dest *dest) {
+		DType_lhs lhs[XMATRIX_FUSION_BLOCK];
+		DType_rhs rhs[XMATRIX_FUSION_BLOCK];
+		// scalar operands are fetched once and broadcast by the kernel
+		Kernel(
+			(dimension_lhs == 0)? _lhs.Fetch(0, 1, lhs) : FetchRepeated(_lhs, offset, length, lhs), 
+			(dimension_rhs == 0)? _rhs.Fetch(0, 1, rhs) : FetchRepeated(_rhs, offset, length, rhs), 
+			dest, length);
+	}
+
+	virtual void Kernel(const DType_lhs *lhs, const DType_rhs *rhs, DType_dest *dest, size_t length) = 0;
+
+	XMATRIX_INLINE bool EmitOperands(JitCode &code, const std::string &index, std::string &lhs, std::string &rhs) {
+		size_t size = _shape.getSize();
+		return code.Operand(_lhs, JitIndex(index, _lhs._shape.getSize(), size), lhs)
+			&& code.Operand(_rhs, JitIndex(index, _rhs._shape.getSize(), size), rhs);
+	}
+
+	XMATRIX_INLINE virtual bool EmitKernel(JitCode &code, std::string &body) {
+		return EmitElementwise(*this, code, body);
+	}
+
+	/**
+	* Broadcast operands are repeated over the block for Adjoint() and their
+	* adjoints summed over the repetitions
+	*/
+	XMATRIX_INLINE virtual void Backward() {
+		size_t size = _shape.getSize();
+		size_t sizeLhs = _lhs._shape.getSize(), sizeRhs = _rhs._shape.getSize();
+		for (size_t i = 0; i < size; i += XMATRIX_FUSION_BLOCK) {
+			size_t length = (size - i < XMATRIX_FUSION_BLOCK)? size - i : XMATRIX_FUSION_BLOCK;
+			DType_lhs lhs[XMATRIX_FUSION_BLOCK], gradLhs[XMATRIX_FUSION_BLOCK];
+			DType_rhs rhs[XMATRIX_FUSION_BLOCK], gradRhs[XMATRIX_FUSION_BLOCK];
+			bool repeatLhs = sizeLhs != size, repeatRhs = sizeRhs != size;
+			if (repeatLhs)
+				std::fill(gradLhs, gradLhs + length, DType_lhs(0));
+			if (repeatRhs)
+				std::fill(gradRhs, gradRhs + length, DType_rhs(0));
+
+			Adjoint(FetchRepeated(_lhs, i, length, lhs), FetchRepeated(_rhs, i, length, rhs), _ptr + i, &_grad[i], 
+				repeatLhs? gradLhs : &_lhs._grad[i], 
+				repeatRhs? gradRhs : &_rhs._grad[i], length);
+
+			for (size_t j = 0; repeatLhs && j < length; j++)
+				_lhs._grad[(i + j) % sizeLhs] += gradLhs[j];
+			for (size_t j = 0; repeatRhs && j < length; j++)
+				_rhs._grad[(i + j) % sizeRhs] += gradRhs[j];
+		}
+	}
+
+	/**
+	* Adds grad times d dest / d lhs and d dest / d rhs to gradLhs and
+	* gradRhs, nothing for the piecewise constant ops
+	*/
+	XMATRIX_INLINE virtual void Adjoint(const DType_lhs *lhs, const DType_rhs *rhs, const DType_dest *dest, 
+		const DType_dest *grad, DType_lhs *gradLhs, DType_rhs *gradRhs, size_t length) {}
 };
 
 /**
@@ -461,6 +1205,37 @@ struct SubscriptTensor
 	}
 };
 
+/**
+* Slice Tensor
+*/
+template<typename device_dest, size_t dimension_dest, typename DType_dest,
+	typename device_src, size_t dimension_src, typename DType_src>
+struct SliceTensor
+	: public UnaryDeducedTensor<device_dest, dimension_dest, DType_dest, device_src, dimension_src, DType_src> {
+
+	XMATRIX_INLINE SliceTensor(Tensor<device_src, dimension_src, DType_src> &src, 
+		Shape<dimension_src> begin, Shape<dimension_src> end, Shape<dimension_src> step) 
+		: UnaryDeducedTensor<device_dest, dimension_dest, DType_dest, device_src, dimension_src, DType_src>(src) {
+			cerr << "Not supported yet!" << endl;
+			assert(false);
+	}
+};
+
+/**
+* Reshape Tensor
+*/
+template<typename device_dest, size_t dimension_dest, typename DType_dest,
+	typename device_src, size_t dimension_src, typename DType_src>
+struct ReshapeTensor
+	: public UnaryDeducedTensor<device_dest, dimension_dest, DType_dest, device_src, dimension_src, DType_src> {
+
+	XMATRIX_INLINE ReshapeTensor(Tensor<device_src, dimension_src, DType_src> &src, Shape<dimension_dest> shape) 
+		: UnaryDeducedTensor<device_dest, dimension_dest, DType_dest, device_src, dimension_src, DType_src>(src) {
+			cerr << "Not supported yet!" << endl;
+			assert(false);
+	}
+};
+
 /**
 * Exponential Tensor
 */
@@ -538,6 +1313,98 @@ struct PowerTensor
 	}
 };
 
+/**
+* Fill Tensor: one value in the shape of src
+*/
+template<typename device_dest, size_t dimension_dest, typename DType_dest,
+	typename device_src, size_t dimension_src, typename DType_src>
+struct FillTensor
+	: public UnaryDeducedTensor<device_dest, dimension_dest, DType_dest, device_src, dimension_src, DType_src> {
+
+	const double _value;
+
+	XMATRIX_INLINE FillTensor(Tensor<device_src, dimension_src, DType_src> &src, double value)
+		: UnaryDeducedTensor<device_dest, dimension_dest, DType_dest, device_src, dimension_src, DType_src>(src), _value(value) {
+			cerr << "Not supported yet!" << endl;
+			assert(false);
+	}
+};
+
+/**
+* Erf Tensor
+*/
+template<typename device_dest, size_t dimension_dest, typename DType_dest,
+	typename device_src, size_t dimension_src, typename DType_src>
+struct ErfTensor
+	: public UnaryDeducedTensor<device_dest, dimension_dest, DType_dest, device_src, dimension_src, DType_src> {
+	
+	XMATRIX_INLINE ErfTensor(Tensor<device_src, dimension_src, DType_src> &src) 
+		: UnaryDeducedTensor<device_dest, dimension_dest, DType_dest, device_src, dimension_src, DType_src>(src) {
+			cerr << "Not supported yet!" << endl;
+			assert(false);
+	}
+};
+
+/**
+* Erfc Tensor
+*/
+template<typename device_dest, size_t dimension_dest, typename DType_dest,
+	typename device_src, size_t dimension_src, typename DType_src>
+struct ErfcTensor
+	: public UnaryDeducedTensor<device_dest, dimension_dest, DType_dest, device_src, dimension_src, DType_src> {
+	
+	XMATRIX_INLINE ErfcTensor(Tensor<device_src, dimension_src, DType_src> &src) 
+		: UnaryDeducedTensor<device_dest, dimension_dest, DType_dest, device_src, dimension_src, DType_src>(src) {
+			cerr << "Not supported yet!" << endl;
+			assert(false);
+	}
+};
+
+/**
+* Normal CDF Tensor
+*/
+template<typename device_dest, size_t dimension_dest, typename DType_dest,
+	typename device_src, size_t dimension_src, typename DType_src>
+struct NormCdfTensor
+	: public UnaryDeducedTensor<device_dest, dimension_dest, DType_dest, device_src, dimension_src, DType_src> {
+	
+	XMATRIX_INLINE NormCdfTensor(Tensor<device_src, dimension_src, DType_src> &src) 
+		: UnaryDeducedTensor<device_dest, dimension_dest, DType_dest, device_src, dimension_src, DType_src>(src) {
+			cerr << "Not supported yet!" << endl;
+			assert(false);
+	}
+};
+
+/**
+* Normal PDF Tensor
+*/
+template<typename device_dest, size_t dimension_dest, typename DType_dest,
+	typename device_src, size_t dimension_src, typename DType_src>
+struct NormPdfTensor
+	: public UnaryDeducedTensor<device_dest, dimension_dest, DType_dest, device_src, dimension_src, DType_src> {
+	
+	XMATRIX_INLINE NormPdfTensor(Tensor<device_src, dimension_src, DType_src> &src) 
+		: UnaryDeducedTensor<device_dest, dimension_dest, DType_dest, device_src, dimension_src, DType_src>(src) {
+			cerr << "Not supported yet!" << endl;
+			assert(false);
+	}
+};
+
+/**
+* Inverse Normal CDF Tensor
+*/
+template<typename device_dest, size_t dimension_dest, typename DType_dest,
+	typename device_src, size_t dimension_src, typename DType_src>
+struct NormInvTensor
+	: public UnaryDeducedTensor<device_dest, dimension_dest, DType_dest, device_src, dimension_src, DType_src> {
+	
+	XMATRIX_INLINE NormInvTensor(Tensor<device_src, dimension_src, DType_src> &src) 
+		: UnaryDeducedTensor<device_dest, dimension_dest, DType_dest, device_src, dimension_src, DType_src>(src) {
+			cerr << "Not supported yet!" << endl;
+			assert(false);
+	}
+};
+
 /**
 * Abs Tensor
 */
@@ -734,6 +1601,79 @@ struct MeanTensor
 	}
 };
 
+/**
+* Black-Scholes Tensor: price and Greeks of European options, stacked along
+* a leading axis of 6 (see BlackScholes)
+*/
+template<typename device_dest, size_t dimension_dest, typename DType_dest,
+	typename device_src, size_t dimension_spot, size_t dimension_strike, size_t dimension_vol, 
+	size_t dimension_rate, size_t dimension_tenor, typename DType_src>
+struct BlackScholesTensor
+	: public Tensor<device_dest, dimension_dest, DType_dest> {
+	
+	XMATRIX_INLINE BlackScholesTensor(Tensor<device_src, dimension_spot, DType_src> &spot, 
+		Tensor<device_src, dimension_strike, DType_src> &strike, Tensor<device_src, dimension_vol, DType_src> &vol, 
+		Tensor<device_src, dimension_rate, DType_src> &rate, Tensor<device_src, dimension_tenor, DType_src> &tenor, int isCall) 
+		: Tensor<device_dest, dimension_dest, DType_dest>(false) {
+			cerr << "Not supported yet!" << endl;
+			assert(false);
+	}
+};
+
+/**
+* Implied Volatility Tensor: the Black-Scholes vols of option prices (see
+* ImpliedVol)
+*/
+template<typename device_dest, size_t dimension_dest, typename DType_dest,
+	typename device_src, size_t dimension_price, size_t dimension_spot, size_t dimension_strike,
+	size_t dimension_rate, size_t dimension_tenor, typename DType_src>
+struct ImpliedVolTensor
+	: public Tensor<device_dest, dimension_dest, DType_dest> {
+
+	XMATRIX_INLINE ImpliedVolTensor(Tensor<device_src, dimension_price, DType_src> &price,
+		Tensor<device_src, dimension_spot, DType_src> &spot, Tensor<device_src, dimension_strike, DType_src> &strike,
+		Tensor<device_src, dimension_rate, DType_src> &rate, Tensor<device_src, dimension_tenor, DType_src> &tenor, int isCall)
+		: Tensor<device_dest, dimension_dest, DType_dest>(false) {
+			cerr << "Not supported yet!" << endl;
+			assert(false);
+	}
+};
+
+/**
+* Surface Coefficients Tensor: the polynomial patches of the cells of a grid
+* over row and column knots (see Bilinear and CubicSpline)
+*/
+template<typename device_dest, size_t dimension_dest, typename DType_dest,
+	typename device_src, typename DType_src>
+struct SurfaceCoefficientsTensor
+	: public Tensor<device_dest, dimension_dest, DType_dest> {
+
+	XMATRIX_INLINE SurfaceCoefficientsTensor(Tensor<device_src, 2, DType_src> &grid,
+		Tensor<device_src, 1, DType_src> &rows, Tensor<device_src, 1, DType_src> &cols, int order)
+		: Tensor<device_dest, dimension_dest, DType_dest>(false) {
+			cerr << "Not supported yet!" << endl;
+			assert(false);
+	}
+};
+
+/**
+* Surface Tensor: a grid interpolated at query points from the patches of
+* its cells (see Bilinear and CubicSpline)
+*/
+template<typename device_dest, size_t dimension_dest, typename DType_dest,
+	typename device_src, size_t dimension_x, size_t dimension_y, typename DType_src>
+struct SurfaceTensor
+	: public Tensor<device_dest, dimension_dest, DType_dest> {
+
+	XMATRIX_INLINE SurfaceTensor(Tensor<device_src, 3, DType_dest> &coefficients,
+		Tensor<device_src, 1, DType_src> &rows, Tensor<device_src, 1, DType_src> &cols,
+		Tensor<device_src, dimension_x, DType_src> &x, Tensor<device_src, dimension_y, DType_src> &y)
+		: Tensor<device_dest, dimension_dest, DType_dest>(false) {
+			cerr << "Not supported yet!" << endl;
+			assert(false);
+	}
+};
+
 /**
 *
 */
@@ -0,0 +1,177 @@
+#ifndef XMATRIX_THREAD_POOL_H_
+#define XMATRIX_THREAD_POOL_H_
+
+#include "common.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <functional>
+
+namespace xmatrix {
+
+/**
+* Thread Pool: work-stealing pool shared by the graph scheduler and the
+* data-parallel kernels. Every worker owns a deque, takes its own tasks from
+* the back and steals from the front of the others. A thread waiting for
+* tasks to finish runs queued tasks meanwhile, so tasks may submit and wait
+* for nested tasks without starving the pool
+*/
+struct ThreadPool {
+	typedef std::function<void()> Task;
+
+	struct Queue {
+		std::mutex _mutex;
+		std::deque<Task> _tasks;
+	};
+
+	size_t _threads;
+	std::vector<std::thread> _workers;
+	std::vector<Queue *> _queues;
+	std::atomic<size_t> _pending;
+	std::atomic<size_t> _next;
+	std::mutex _mutex;
+	std::condition_variable _signal;
+	bool _stop;
+
+	/**
+	* threads counts the calling thread, which takes part in Wait(), so
+	* threads - 1 workers are started
+	*/
+	XMATRIX_INLINE ThreadPool(size_t threads) : _threads(threads? threads : 1), _pending(0), _next(0), _stop(false) {
+		for (size_t i = 0; i < _threads; i++)
+			_queues.push_back(new Queue());
+		for (size_t i = 1; i < _threads; i++)
+			_workers.push_back(std::thread(&ThreadPool::Work, this, i));
+	}
+
+	XMATRIX_INLINE ~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_signal.notify_all();
+		for (size_t i = 0; i < _workers.size(); i++)
+			_workers[i].join();
+		for (size_t i = 0; i < _queues.size(); i++)
+			delete _queues[i];
+	}
+
+	XMATRIX_INLINE static ThreadPool &Instance() {
+		static ThreadPool pool((XMATRIX_NUM_THREADS > 0)? XMATRIX_NUM_THREADS : std::thread::hardware_concurrency());
+		return pool;
+	}
+
+	/**
+	* Index of the queue owned by the current thread, 0 for threads outside
+	* the pool
+	*/
+	XMATRIX_INLINE static size_t &Self() {
+		static thread_local size_t self = 0;
+		return self;
+	}
+
+	XMATRIX_INLINE void Submit(Task task) {
+		size_t index = Self();
+		if (index == 0)
+			index = _next++ % _threads;
+		{
+			// counted under the queue lock, so RunOne() never takes a task
+			// before it is counted and _pending never wraps below zero
+			std::lock_guard<std::mutex> lock(_queues[index]->_mutex);
+			_pending++;
+			_queues[index]->_tasks.push_back(task);
+		}
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+		}
+		_signal.notify_one();
+	}
+
+	/**
+	* Runs one queued task, own queue first, and returns false if none was found
+	*/
+	XMATRIX_INLINE bool RunOne() {
+		size_t self = Self();
+		Task task;
+		for (size_t i = 0; i < _threads && !task; i++) {
+			Queue *queue = _queues[(self + i) % _threads];
+			std::lock_guard<std::mutex> lock(queue->_mutex);
+			if (queue->_tasks.empty())
+				continue;
+			if (i == 0) {
+				task = queue->_tasks.back();
+				queue->_tasks.pop_back();
+			} else {
+				task = queue->_tasks.front();
+				queue->_tasks.pop_front();
+			}
+		}
+		if (!task)
+			return false;
+		_pending--;
+		task();
+		return true;
+	}
+
+	/**
+	* Helps with queued tasks until the counter drops to zero
+	*/
+	XMATRIX_INLINE void Wait(std::atomic<size_t> &counter) {
+		while (counter > 0) {
+			if (!RunOne())
+				std::this_thread::yield();
+		}
+	}
+
+	XMATRIX_INLINE void Work(size_t index) {
+		Self() = index;
+		while (true) {
+			if (RunOne())
+				continue;
+			std::unique_lock<std::mutex> lock(_mutex);
+			_signal.wait(lock, [this] { return _stop || _pending > 0; });
+			if (_stop)
+				return;
+		}
+	}
+};
+
+/**
+* ParallelFor: calls func(begin, end) on chunks of at least grain indices
+* spread over the thread pool, and returns once all chunks are done
+*/
+template<typename Func>
+XMATRIX_INLINE void ParallelFor(size_t begin, size_t end, size_t grain, Func func) {
+	ThreadPool &pool = ThreadPool::Instance();
+	size_t n = end - begin;
+	if (grain == 0)
+		grain = 1;
+	if (pool._threads == 1 || n <= grain) {
+		func(begin, end);
+		return;
+	}
+
+	size_t chunks = (n + grain - 1) / grain;
+	if (chunks > 4 * pool._threads)
+		chunks = 4 * pool._threads;
+	size_t step = (n + chunks - 1) / chunks;
+
+	std::atomic<size_t> remaining(0);
+	for (size_t i = begin; i < end; i += step)
+		remaining++;
+	for (size_t i = begin; i < end; i += step) {
+		size_t j = (end - i < step)? end : i + step;
+		pool.Submit([&func, &remaining, i, j] {
+			func(i, j);
+			remaining--;
+		});
+	}
+	pool.Wait(remaining);
+}
+
+} // namespace xmatrix
+
+#endif // XMATRIX_THREAD_POOL_H_
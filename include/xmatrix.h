@@ -13,6 +13,9 @@
 #ifndef XMATRIX_USE_MKL
 #define XMATRIX_USE_MKL 1
 #endif
+#ifndef XMATRIX_USE_JIT
+#define XMATRIX_USE_JIT 0
+#endif
 
 #include "common.h"
 #include "tensor.h"
@@ -28,6 +31,10 @@
 #include "tensor-cuda.h"
 #endif
 
+#if XMATRIX_USE_JIT == 1
+#include "jit.h"
+#endif
+
 /**
 * Include all xmatrix header files
 */
@@ -0,0 +1,78 @@
+#include "blas-cpu.h"
+#include "test.h"
+
+using namespace xmatrix;
+
+/**
+* Gemm, Gemv and Dot against naive loops, over sizes on both sides of the
+* direct loop threshold and across the MC, KC and NC blocks and the fringe
+* tiles, with transposed and strided operands
+*/
+template<typename DType>
+void CheckGemm(size_t m, size_t n, size_t k, bool transA, bool transB, double tolerance) {
+	std::vector<double> va = Values(m * k, -1, 1, 1), vb = Values(k * n, -1, 1, 2);
+	std::vector<DType> a(va.begin(), va.end()), b(vb.begin(), vb.end());
+	size_t rsa = transA? 1 : k, csa = transA? m : 1;
+	size_t rsb = transB? 1 : n, csb = transB? k : 1;
+	size_t rsc = n + 3; // rows of C padded, the padding must be left alone
+	std::vector<DType> c(m * rsc, (DType)7);
+	Gemm(m, n, k, &a[0], rsa, csa, &b[0], rsb, csb, &c[0], rsc);
+
+	for (size_t i = 0; i < m; i++) {
+		for (size_t j = 0; j < n; j++) {
+			double expected = 0;
+			for (size_t p = 0; p < k; p++)
+				expected += (double)a[i * rsa + p * csa] * (double)b[p * rsb + j * csb];
+			CHECK_NEAR((double)c[i * rsc + j], expected, tolerance * (k + 1));
+		}
+		for (size_t j = n; j < rsc; j++)
+			CHECK(c[i * rsc + j] == (DType)7);
+	}
+}
+
+template<typename DType>
+void CheckGemv(size_t k, size_t n, bool transB, double tolerance) {
+	std::vector<double> vx = Values(2 * k, -1, 1, 3), vb = Values(k * n, -1, 1, 4);
+	std::vector<DType> x(vx.begin(), vx.end()), b(vb.begin(), vb.end());
+	size_t rsb = transB? 1 : n, csb = transB? k : 1;
+	std::vector<DType> y(n);
+	Gemv(k, n, &x[0], 2, &b[0], rsb, csb, &y[0]); // every other element of x
+
+	for (size_t j = 0; j < n; j++) {
+		double expected = 0;
+		for (size_t p = 0; p < k; p++)
+			expected += (double)x[2 * p] * (double)b[p * rsb + j * csb];
+		CHECK_NEAR((double)y[j], expected, tolerance * (k + 1));
+	}
+}
+
+int main() {
+	const size_t sizes[][3] = { { 1, 1, 1 }, { 7, 5, 3 }, { 33, 17, 65 }, { 64, 64, 64 },
+		{ 100, 37, 129 }, { 201, 2100, 300 }, { 13, 1, 500 }, { 1, 300, 40 } };
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		for (int trans = 0; trans < 4; trans++) {
+			CheckGemm<double>(sizes[s][0], sizes[s][1], sizes[s][2], (trans & 1) != 0, (trans & 2) != 0, 1e-14);
+			CheckGemm<float>(sizes[s][0], sizes[s][1], sizes[s][2], (trans & 1) != 0, (trans & 2) != 0, 1e-6);
+		}
+	}
+	CheckGemm<int>(50, 40, 70, false, false, 0);
+
+	const size_t vectors[][2] = { { 1, 1 }, { 3, 7 }, { 130, 9 }, { 257, 1100 }, { 600, 5000 } };
+	for (size_t s = 0; s < sizeof(vectors) / sizeof(vectors[0]); s++) {
+		for (int trans = 0; trans < 2; trans++) {
+			CheckGemv<double>(vectors[s][0], vectors[s][1], trans != 0, 1e-14);
+			CheckGemv<float>(vectors[s][0], vectors[s][1], trans != 0, 1e-6);
+		}
+	}
+
+	std::vector<double> x = Values(1001, -1, 1, 5), y = Values(3003, -1, 1, 6);
+	double expected = 0;
+	for (size_t i = 0; i < 1001; i++)
+		expected += x[i] * y[3 * i];
+	CHECK_NEAR(Dot<double>(1001, &x[0], 1, &y[0], 3), expected, 1e-13);
+	CHECK_NEAR(Dot<double>(0, &x[0], 1, &y[0], 1), 0, 0);
+
+	if (failures == 0)
+		printf("blas: passed\n");
+	return failures;
+}
@@ -0,0 +1,235 @@
+#include "xmatrix.h"
+#include "test.h"
+
+using namespace xmatrix;
+using namespace xmatrix::op;
+
+/**
+* Black-Scholes, implied volatility and surface nodes: values against the
+* closed forms, their adjoints against central differences, and the same
+* results for operands streamed from expressions as for loaded ones
+*/
+double Cdf(double x) {
+	return 0.5 * erfc(-x / sqrt(2.0));
+}
+
+void Reference(double spot, double strike, double vol, double rate, double tenor, bool isCall, double greeks[6]) {
+	double s = isCall? 1 : -1, root = sqrt(tenor), discount = exp(-rate * tenor);
+	double d1 = (log(spot / strike) + (rate + vol * vol / 2) * tenor) / (vol * root), d2 = d1 - vol * root;
+	double pdf = exp(-d1 * d1 / 2) * 0.3989422804014327;
+	greeks[0] = s * (spot * Cdf(s * d1) - strike * discount * Cdf(s * d2));
+	greeks[1] = s * Cdf(s * d1);
+	greeks[2] = pdf / (spot * vol * root);
+	greeks[3] = spot * pdf * root;
+	greeks[4] = -spot * pdf * vol / (2 * root) - s * rate * strike * discount * Cdf(s * d2);
+	greeks[5] = s * tenor * strike * discount * Cdf(s * d2);
+}
+
+void BlackScholesGreeks(bool isCall) {
+	Graph graph;
+	const size_t n = 300;
+	Scalar<cpu, double>::type spot, rate;
+	Vector<cpu, double>::type strike, logVol, tenor;
+	Matrix<cpu, double>::type weights;
+	double dspot = 100, drate = 0.03;
+	std::vector<double> dstrike = Values(n, 60, 150, 1), dlogVol = Values(n, log(0.1), log(0.6), 2);
+	std::vector<double> dtenor = Values(n, 0.05, 3, 3), dweights = Values(6 * n, -1, 1, 4);
+	spot.Load(&dspot, Shape0());
+	rate.Load(&drate, Shape0());
+	strike.Load(&dstrike[0], Shape1(n));
+	logVol.Load(&dlogVol[0], Shape1(n));
+	tenor.Load(&dtenor[0], Shape1(n));
+	weights.Load(&dweights[0], Shape2(6, n));
+
+	// the vols are an elementwise expression streamed into the node
+	Matrix<cpu, double>::type greeks = BlackScholes(spot, strike, Exp(logVol), rate, tenor, isCall);
+	greeks.Update();
+	CHECK(greeks._tensor->_shape[0] == 6 && greeks._tensor->_shape[1] == n);
+	for (size_t i = 0; i < n; i++) {
+		double expected[6];
+		Reference(dspot, dstrike[i], exp(dlogVol[i]), drate, dtenor[i], isCall, expected);
+		for (size_t g = 0; g < 6; g++)
+			CHECK_NEAR(greeks._tensor->_ptr[g * n + i], expected[g], 1e-12);
+	}
+
+	// loaded vols, and the plan and budgeted evaluations, give the same values
+	Vector<cpu, double>::type vol;
+	std::vector<double> dvol(n);
+	for (size_t i = 0; i < n; i++)
+		dvol[i] = exp(dlogVol[i]);
+	vol.Load(&dvol[0], Shape1(n));
+	Matrix<cpu, double>::type loaded = BlackScholes(spot, strike, vol, rate, tenor, isCall);
+	loaded.Update();
+	Matrix<cpu, double>::type planned = BlackScholes(spot, strike * 2.0 * 0.5, Exp(logVol), rate, tenor * 2.0 * 0.5, isCall);
+	Plan plan(planned);
+	plan.Run();
+	for (size_t i = 0; i < 6 * n; i++) {
+		CHECK_NEAR(loaded._tensor->_ptr[i], greeks._tensor->_ptr[i], 1e-13);
+		CHECK_NEAR(planned._tensor->_ptr[i], greeks._tensor->_ptr[i], 1e-13);
+	}
+	Matrix<cpu, double>::type budgeted = BlackScholes(spot, Exp(Log(strike)), Exp(logVol), rate, tenor, isCall);
+	BudgetedEvaluation(budgeted, 0).Run();
+	for (size_t i = 0; i < 6 * n; i++)
+		CHECK_NEAR(budgeted._tensor->_ptr[i], greeks._tensor->_ptr[i], 1e-12);
+
+	// adjoints of all six rows at once
+	Matrix<cpu, double>::type weighted = Dot(greeks, weights);
+	CHECK(GradientError(spot, std::vector<double>(1, dspot), Shape0(), weighted) < 1e-6);
+	CHECK(GradientError(rate, std::vector<double>(1, drate), Shape0(), weighted) < 1e-6);
+	CHECK(GradientError(strike, dstrike, Shape1(n), weighted) < 1e-6);
+	CHECK(GradientError(logVol, dlogVol, Shape1(n), weighted) < 1e-6);
+	CHECK(GradientError(tenor, dtenor, Shape1(n), weighted) < 1e-6);
+
+	// the price row alone: its gradient in the spot is the sum of the deltas
+	Scalar<cpu, double>::type price = Sum(greeks[0]);
+	price.Backward();
+	double delta = 0;
+	for (size_t i = 0; i < n; i++)
+		delta += greeks._tensor->_ptr[n + i];
+	CHECK_NEAR(spot.Grad()[0], delta, 1e-12);
+}
+
+void ImpliedVolatility(bool isCall) {
+	Graph graph;
+	const size_t n = 300;
+	Scalar<cpu, double>::type spot, rate;
+	Vector<cpu, double>::type strike, vol, tenor, weights;
+	double dspot = 100, drate = 0.02;
+	std::vector<double> dstrike = Values(n, 70, 140, 5), dvol = Values(n, 0.1, 0.7, 6);
+	std::vector<double> dtenor = Values(n, 0.25, 4, 7), dweights = Values(n, -1, 1, 8);
+	spot.Load(&dspot, Shape0());
+	rate.Load(&drate, Shape0());
+	strike.Load(&dstrike[0], Shape1(n));
+	vol.Load(&dvol[0], Shape1(n));
+	tenor.Load(&dtenor[0], Shape1(n));
+	weights.Load(&dweights[0], Shape1(n));
+
+	// round trip: the vols of the prices are the vols, and d vol / d vol is 1
+	Matrix<cpu, double>::type greeks = BlackScholes(spot, strike, vol, rate, tenor, isCall);
+	Vector<cpu, double>::type implied = ImpliedVol(greeks[0], spot, strike, rate, tenor, isCall);
+	implied.Update();
+	for (size_t i = 0; i < n; i++)
+		CHECK_NEAR(implied._tensor->_ptr[i], dvol[i], 1e-9);
+	Vector<cpu, double>::type tail = Dot(implied, weights);
+	tail.Backward();
+	for (size_t i = 0; i < n; i++)
+		CHECK_NEAR(vol.Grad()[i], dweights[i], 1e-6);
+
+	// adjoints of the solver in each operand, prices streamed from an expression;
+	// options of vega below 1 are weighted 0, central differences of their
+	// vols are not accurate
+	Vector<cpu, double>::type price, conditioned;
+	std::vector<double> dprice(n), dconditioned(n);
+	for (size_t i = 0; i < n; i++) {
+		double expected[6];
+		Reference(dspot, dstrike[i], dvol[i], drate, dtenor[i], isCall, expected);
+		dprice[i] = expected[0];
+		dconditioned[i] = (expected[3] >= 1)? dweights[i] : 0;
+	}
+	price.Load(&dprice[0], Shape1(n));
+	conditioned.Load(&dconditioned[0], Shape1(n));
+	Vector<cpu, double>::type solved = Dot(ImpliedVol(price * 2.0 * 0.5, spot, strike, rate, tenor, isCall), conditioned);
+	CHECK(GradientError(price, dprice, Shape1(n), solved) < 1e-5);
+	CHECK(GradientError(spot, std::vector<double>(1, dspot), Shape0(), solved) < 1e-5);
+	CHECK(GradientError(rate, std::vector<double>(1, drate), Shape0(), solved) < 1e-5);
+	CHECK(GradientError(strike, dstrike, Shape1(n), solved) < 1e-5);
+	CHECK(GradientError(tenor, dtenor, Shape1(n), solved) < 1e-5);
+
+	// prices outside the no-arbitrage bounds have no vol
+	double bad[] = { -1, 1e6 };
+	Vector<cpu, double>::type outside;
+	outside.Load(bad, Shape1(2));
+	Scalar<cpu, double>::type strike0, tenor0;
+	strike0.Load(&dstrike[0], Shape0());
+	tenor0.Load(&dtenor[0], Shape0());
+	Vector<cpu, double>::type none = ImpliedVol(outside, spot, strike0, rate, tenor0, isCall);
+	none.Update();
+	CHECK(std::isnan(none._tensor->_ptr[0]) && std::isnan(none._tensor->_ptr[1]));
+}
+
+double Smooth(double x, double y) {
+	return sin(x) * cos(0.7 * y) + 0.1 * x * y;
+}
+
+void Interpolation() {
+	Graph graph;
+	const size_t rows = 7, cols = 5, n = 200;
+	double drows[rows] = { 0, 0.3, 0.5, 1.1, 1.6, 2.5, 3 }, dcols[cols] = { -1, -0.2, 0.4, 1.5, 2 };
+	std::vector<double> dgrid(rows * cols);
+	for (size_t i = 0; i < rows; i++)
+		for (size_t j = 0; j < cols; j++)
+			dgrid[i * cols + j] = Smooth(drows[i], dcols[j]);
+	std::vector<double> dx = Values(n, 0, 3, 9), dy = Values(n, -1, 2, 10);
+	Matrix<cpu, double>::type grid;
+	Vector<cpu, double>::type knotRows, knotCols, x, y;
+	grid.Load(&dgrid[0], Shape2(rows, cols));
+	knotRows.Load(drows, Shape1(rows));
+	knotCols.Load(dcols, Shape1(cols));
+	x.Load(&dx[0], Shape1(n));
+	y.Load(&dy[0], Shape1(n));
+
+	// bilinear against the cell formula, both through streamed queries
+	Vector<cpu, double>::type bilinear = Bilinear(grid, knotRows, knotCols, x * 2.0 * 0.5, y * 2.0 * 0.5);
+	bilinear.Update();
+	for (size_t k = 0; k < n; k++) {
+		size_t i = 0, j = 0;
+		while (i + 2 < rows && dx[k] >= drows[i + 1])
+			i++;
+		while (j + 2 < cols && dy[k] >= dcols[j + 1])
+			j++;
+		double u = (dx[k] - drows[i]) / (drows[i + 1] - drows[i]), v = (dy[k] - dcols[j]) / (dcols[j + 1] - dcols[j]);
+		double expected = (1 - u) * (1 - v) * dgrid[i * cols + j] + (1 - u) * v * dgrid[i * cols + j + 1]
+			+ u * (1 - v) * dgrid[(i + 1) * cols + j] + u * v * dgrid[(i + 1) * cols + j + 1];
+		CHECK_NEAR(bilinear._tensor->_ptr[k], expected, 1e-13);
+	}
+
+	// the spline goes through the knots, is close to the smooth function
+	// inside the grid, and takes the border values outside
+	Vector<cpu, double>::type qx, qy;
+	std::vector<double> kx, ky;
+	for (size_t i = 0; i < rows; i++)
+		for (size_t j = 0; j < cols; j++) {
+			kx.push_back(drows[i]);
+			ky.push_back(dcols[j]);
+		}
+	kx.push_back(-1);
+	ky.push_back(0.4);
+	kx.push_back(1.1);
+	ky.push_back(5);
+	qx.Load(&kx[0], Shape1(kx.size()));
+	qy.Load(&ky[0], Shape1(ky.size()));
+	Vector<cpu, double>::type knots = CubicSpline(grid, knotRows, knotCols, qx, qy);
+	knots.Update();
+	for (size_t k = 0; k < rows * cols; k++)
+		CHECK_NEAR(knots._tensor->_ptr[k], dgrid[k], 1e-13);
+	CHECK_NEAR(knots._tensor->_ptr[rows * cols], dgrid[2], 1e-13);
+	CHECK_NEAR(knots._tensor->_ptr[rows * cols + 1], dgrid[3 * cols + cols - 1], 1e-13);
+
+	Vector<cpu, double>::type spline = CubicSpline(grid, knotRows, knotCols, x, y);
+	spline.Update();
+	for (size_t k = 0; k < n; k++)
+		CHECK_NEAR(spline._tensor->_ptr[k], Smooth(dx[k], dy[k]), 0.1);
+
+	// adjoints in the grid, through the patch coefficients, and in the queries
+	Vector<cpu, double>::type weights;
+	std::vector<double> dweights = Values(n, -1, 1, 11);
+	weights.Load(&dweights[0], Shape1(n));
+	Vector<cpu, double>::type weightedBilinear = Dot(bilinear, weights), weightedSpline = Dot(spline, weights);
+	CHECK(GradientError(grid, dgrid, Shape2(rows, cols), weightedBilinear) < 1e-6);
+	CHECK(GradientError(grid, dgrid, Shape2(rows, cols), weightedSpline) < 1e-6);
+	CHECK(GradientError(x, dx, Shape1(n), weightedBilinear) < 1e-6);
+	CHECK(GradientError(y, dy, Shape1(n), weightedBilinear) < 1e-6);
+	CHECK(GradientError(x, dx, Shape1(n), weightedSpline) < 1e-6);
+	CHECK(GradientError(y, dy, Shape1(n), weightedSpline) < 1e-6);
+}
+
+int main() {
+	BlackScholesGreeks(true);
+	BlackScholesGreeks(false);
+	ImpliedVolatility(true);
+	ImpliedVolatility(false);
+	Interpolation();
+	if (failures == 0)
+		printf("finance: passed\n");
+	return failures;
+}
@@ -0,0 +1,174 @@
+#include "xmatrix.h"
+#include "test.h"
+
+using namespace xmatrix;
+using namespace xmatrix::op;
+
+/**
+* Reverse-mode gradients of the operators against central differences, and
+* the values of the matrix products against naive loops
+*/
+void Elementwise() {
+	Graph graph;
+	Vector<cpu, double>::type x, v;
+	std::vector<double> dx = Values(300, 0.2, 2, 1), dv = Values(300, -1, 1, 2);
+	x.Load(&dx[0], Shape1(300));
+	v.Load(&dv[0], Shape1(300));
+
+	// longer than a fusion block, so the fused pass runs several blocks
+	Vector<cpu, double>::type y = Dot(Exp(x), Log(x)) / (x + 2.0) - Sqrt(x) * 3.0 + Pow(x, 1.7)
+		+ NormCdf(Dot(v, x)) + Erf(x - v) + Abs(v) - NormPdf(v) / Exp(v);
+	CHECK(GradientError(x, dx, Shape1(300), y) < 1e-5);
+	CHECK(GradientError(v, dv, Shape1(300), y) < 1e-5);
+
+	// Pow rewrites: products, Sqrt, a division, and Sqrt(Dot(x, x)) to Abs
+	Vector<cpu, double>::type p = Pow(x, 2) + Pow(v, 3) + Pow(x, 4) + Pow(x, 0.5) + Pow(x, -1) + Sqrt(Pow(v, 2));
+	CHECK(GradientError(x, dx, Shape1(300), p) < 1e-5);
+	CHECK(GradientError(v, dv, Shape1(300), p) < 1e-5);
+	p.Update();
+	for (size_t i = 0; i < 300; i++) {
+		double expected = dx[i] * dx[i] + dv[i] * dv[i] * dv[i] + pow(dx[i], 4) + sqrt(dx[i]) + 1 / dx[i] + fabs(dv[i]);
+		CHECK_NEAR(p._tensor->_ptr[i], expected, 1e-13);
+	}
+
+	// a Tape differentiates the same expression again after Load()
+	Tape tape(y);
+	tape.Run();
+	std::vector<double> first(x.Grad(), x.Grad() + 300);
+	std::vector<double> dx2 = Values(300, 0.2, 2, 3);
+	x.Load(&dx2[0], Shape1(300));
+	tape.Run();
+	std::vector<double> second(x.Grad(), x.Grad() + 300);
+	CHECK(first != second);
+	CHECK(GradientError(x, dx2, Shape1(300), y) < 1e-5);
+	x.Load(&dx2[0], Shape1(300));
+	y.Backward();
+	for (size_t i = 0; i < 300; i++)
+		CHECK_NEAR(second[i], x.Grad()[i], 1e-15);
+}
+
+void Products() {
+	Graph graph;
+	Matrix<cpu, double>::type a, b;
+	Vector<cpu, double>::type u, w;
+	const size_t m = 40, k = 50, n = 45;
+	std::vector<double> da = Values(m * k, -1, 1, 4), db = Values(k * n, -1, 1, 5);
+	std::vector<double> du = Values(k, -1, 1, 6), dw = Values(n, -1, 1, 7);
+	a.Load(&da[0], Shape2(m, k));
+	b.Load(&db[0], Shape2(k, n));
+	u.Load(&du[0], Shape1(k));
+	w.Load(&dw[0], Shape1(n));
+
+	Matrix<cpu, double>::type c = a * b;
+	c.Update();
+	for (size_t i = 0; i < m; i++) {
+		for (size_t j = 0; j < n; j++) {
+			double expected = 0;
+			for (size_t p = 0; p < k; p++)
+				expected += da[i * k + p] * db[p * n + j];
+			CHECK_NEAR(c._tensor->_ptr[i * n + j], expected, 1e-13);
+		}
+	}
+	CHECK(GradientError(a, da, Shape2(m, k), c) < 1e-5);
+	CHECK(GradientError(b, db, Shape2(k, n), c) < 1e-5);
+
+	// transposed and sliced operands are read through their strides
+	Matrix<cpu, double>::type t = Transpose(Slice(a, 1, 31, 0, (size_t)-1, 1, 1)) * Slice(a, 0, 30, 2, 47, 1, 3);
+	t.Update();
+	CHECK(t._tensor->_shape[0] == k && t._tensor->_shape[1] == 15);
+	for (size_t i = 0; i < k; i++) {
+		for (size_t j = 0; j < 15; j++) {
+			double expected = 0;
+			for (size_t p = 0; p < 30; p++)
+				expected += da[(p + 1) * k + i] * da[p * k + 2 + 3 * j];
+			CHECK_NEAR(t._tensor->_ptr[i * 15 + j], expected, 1e-13);
+		}
+	}
+	CHECK(GradientError(a, da, Shape2(m, k), t) < 1e-5);
+
+	Vector<cpu, double>::type ub = u * b, bw = b * w;
+	ub.Update();
+	bw.Update();
+	for (size_t j = 0; j < n; j++) {
+		double expected = 0;
+		for (size_t p = 0; p < k; p++)
+			expected += du[p] * db[p * n + j];
+		CHECK_NEAR(ub._tensor->_ptr[j], expected, 1e-13);
+	}
+	for (size_t p = 0; p < k; p++) {
+		double expected = 0;
+		for (size_t j = 0; j < n; j++)
+			expected += db[p * n + j] * dw[j];
+		CHECK_NEAR(bw._tensor->_ptr[p], expected, 1e-13);
+	}
+	CHECK(GradientError(u, du, Shape1(k), ub) < 1e-5);
+	CHECK(GradientError(b, db, Shape2(k, n), ub) < 1e-5);
+	CHECK(GradientError(b, db, Shape2(k, n), bw) < 1e-5);
+	CHECK(GradientError(w, dw, Shape1(n), bw) < 1e-5);
+
+	Scalar<cpu, double>::type inner = Exp(u) * (u * b * Transpose(b)) * 0.5;
+	CHECK(GradientError(u, du, Shape1(k), inner) < 1e-5);
+	CHECK(GradientError(b, db, Shape2(k, n), inner) < 1e-5);
+}
+
+void Views() {
+	Graph graph;
+	Matrix<cpu, double>::type a;
+	Vector<cpu, double>::type u;
+	const size_t m = 12, k = 10;
+	std::vector<double> da = Values(m * k, -1, 1, 8), du = Values(k, -1, 1, 9);
+	a.Load(&da[0], Shape2(m, k));
+	u.Load(&du[0], Shape1(k));
+
+	Matrix<cpu, double>::type slice = Exp(Slice(a, 1, 11, 2, 9, 2, 3)) + Slice(a[5], 0, 9, 3) * 2.0;
+	CHECK(GradientError(a, da, Shape2(m, k), slice) < 1e-5);
+
+	Vector<cpu, double>::type gathered = Exp(Flatten(Slice(a, 0, 12, 1, 10, 3, 2)));
+	CHECK(GradientError(a, da, Shape2(m, k), gathered) < 1e-5);
+
+	Matrix<cpu, double>::type reshaped = Reshape(Exp(a), Shape2(8, 0)) * Reshape(Log(a + 2.0), Shape2(15, 0));
+	CHECK(GradientError(a, da, Shape2(m, k), reshaped) < 1e-5);
+
+	Matrix<cpu, double>::type broadcast = Dot(a + u, Transpose(Transpose(a)) - u * 0.5);
+	CHECK(GradientError(a, da, Shape2(m, k), broadcast) < 1e-5);
+	CHECK(GradientError(u, du, Shape1(k), broadcast) < 1e-5);
+
+	Matrix<cpu, double>::type transposed = Exp(Transpose(a)) * 3.0;
+	Matrix<cpu, double>::type row = Transpose(u) * Transpose(a);
+	CHECK(GradientError(a, da, Shape2(m, k), transposed) < 1e-5);
+	CHECK(GradientError(a, da, Shape2(m, k), row) < 1e-5);
+	CHECK(GradientError(u, du, Shape1(k), row) < 1e-5);
+}
+
+void Reductions() {
+	Graph graph;
+	Matrix<cpu, double>::type a;
+	const size_t m = 12, k = 30;
+	std::vector<double> da = Values(m * k, -1, 1, 10);
+	a.Load(&da[0], Shape2(m, k));
+
+	Scalar<cpu, double>::type sum = Sum(Dot(a, a)) + Mean(Exp(a)) * Sum(Slice(a, 1, 12, 3, 20, 2, 2));
+	CHECK(GradientError(a, da, Shape2(m, k), sum) < 1e-5);
+
+	Vector<cpu, double>::type batch = Dot(BatchSum(Exp(a)), BatchMean(Slice(a, 0, 12, 0, 30, 1, 3)));
+	CHECK(GradientError(a, da, Shape2(m, k), batch) < 1e-5);
+	batch.Update();
+	for (size_t i = 0; i < m; i++) {
+		double sumExp = 0, mean = 0;
+		for (size_t j = 0; j < k; j++)
+			sumExp += exp(da[i * k + j]);
+		for (size_t j = 0; j < k; j += 3)
+			mean += da[i * k + j] / 10;
+		CHECK_NEAR(batch._tensor->_ptr[i], sumExp * mean, 1e-13);
+	}
+}
+
+int main() {
+	Elementwise();
+	Products();
+	Views();
+	Reductions();
+	if (failures == 0)
+		printf("gradient: passed\n");
+	return failures;
+}
@@ -0,0 +1,87 @@
+#ifndef XMATRIX_TEST_H_
+#define XMATRIX_TEST_H_
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+
+/**
+* Minimal checks of the tests: a failed CHECK reports the expression and
+* its line, and the test returns the number of failures
+*/
+static int failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			failures++; \
+		} \
+	} while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) \
+	do { \
+		double actual_ = (actual), expected_ = (expected); \
+		if (!(fabs(actual_ - expected_) <= (tolerance) * std::max(1.0, fabs(expected_)))) { \
+			fprintf(stderr, "%s:%d: %s = %.17g, expected %.17g\n", __FILE__, __LINE__, #actual, actual_, expected_); \
+			failures++; \
+		} \
+	} while (0)
+
+/**
+* Deterministic values in [low, high), so failures reproduce
+*/
+inline std::vector<double> Values(size_t n, double low, double high, unsigned seed = 1) {
+	std::vector<double> values(n);
+	unsigned state = seed * 2654435761u + 12345u;
+	for (size_t i = 0; i < n; i++) {
+		state = state * 1664525u + 1013904223u;
+		values[i] = low + (high - low) * (state >> 8) / 16777216.0;
+	}
+	return values;
+}
+
+/**
+* Sum of the elements of a dense tensor brought up to date
+*/
+template<typename Wrapper>
+double Total(Wrapper &y) {
+	y.Update();
+	double total = 0;
+	for (size_t i = 0; i < y._tensor->_shape.getSize(); i++)
+		total += y._tensor->_ptr[i];
+	return total;
+}
+
+/**
+* Largest error of the gradient of the sum of y with respect to the leaf x
+* against central differences, relative to the larger of 1 and the
+* difference quotient; x is loaded with data again on return
+*/
+template<typename Leaf, typename Extents, typename Wrapper>
+double GradientError(Leaf &x, std::vector<double> data, Extents shape, Wrapper &y) {
+	x.Load(&data[0], shape);
+	y.Backward();
+	std::vector<double> grad(data.size(), 0);
+	if (x.Grad() != NULL)
+		grad.assign(x.Grad(), x.Grad() + data.size());
+
+	double worst = 0;
+	for (size_t i = 0; i < data.size(); i++) {
+		double x0 = data[i], h = 1e-6 * std::max(1.0, fabs(x0));
+		data[i] = x0 + h;
+		x.Load(&data[0], shape);
+		double up = Total(y);
+		data[i] = x0 - h;
+		x.Load(&data[0], shape);
+		double down = Total(y);
+		data[i] = x0;
+		double quotient = (up - down) / (2 * h);
+		worst = std::max(worst, fabs(grad[i] - quotient) / std::max(1.0, fabs(quotient)));
+	}
+	x.Load(&data[0], shape);
+	return worst;
+}
+
+#endif // XMATRIX_TEST_H_